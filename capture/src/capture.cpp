@@ -8,16 +8,19 @@
 #include <atomic>
 #include <chrono>
 #include <inttypes.h>
+#include <memory>
 #include <mutex>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string>
 #include <sys/stat.h>
 
 #include "../../public/common/TracyProtocol.hpp"
 #include "../../public/common/TracyStackFrames.hpp"
+#include "../../server/TracyFileRead.hpp"
 #include "../../server/TracyFileWrite.hpp"
 #include "../../server/TracyMemory.hpp"
 #include "../../server/TracyPrint.hpp"
@@ -43,6 +46,16 @@ void SigInt( int )
     s_disconnect.store(true, std::memory_order_relaxed);
 }
 
+// Set by SIGUSR1 to request a dump of the rolling window.
+static std::atomic<bool> s_dump { false };
+
+#ifndef _WIN32
+void SigUsr1( int )
+{
+    s_dump.store( true, std::memory_order_relaxed );
+}
+#endif
+
 static bool s_isStdoutATerminal = false;
 
 void InitIsStdoutATerminal() {
@@ -90,10 +103,203 @@ void AnsiPrintf( const char* ansiEscape, const char* format, ... ) {
 
 [[noreturn]] void Usage()
 {
-    printf( "Usage: capture -o output.tracy [-a address] [-p port] [-f] [-s seconds]\n" );
+    printf( "Usage: capture -o output.tracy [-a address] [-p port] [-f] [-s seconds] [-r]\n" );
+    printf( "       capture -o output.tracy -w seconds [-t text] [-a address] [-p port] [-f] [-s seconds]\n" );
+    printf( "       capture -i input.raw -o output.tracy [-f]\n\n" );
+    printf( "  -r   Write the raw data stream to the output file as it arrives. Memory usage\n" );
+    printf( "       does not grow with capture length and the data survives a crash.\n" );
+    printf( "  -w   Keep only the last given seconds of the program's activity in memory. The\n" );
+    printf( "       window is saved to a numbered output file on SIGUSR1 and when the capture ends.\n" );
+    printf( "  -t   Also save the window when a message containing the text is received.\n" );
+    printf( "  -i   Convert a raw capture to a trace.\n" );
     exit( 1 );
 }
 
+static void ReportFailure( tracy::Worker& worker )
+{
+    const auto& failure = worker.GetFailureType();
+    if( failure != tracy::Worker::Failure::None )
+    {
+        AnsiPrintf( ANSI_RED ANSI_BOLD, "\nInstrumentation failure: %s", tracy::Worker::GetFailureString( failure ) );
+        auto& fd = worker.GetFailureData();
+        if( !fd.message.empty() )
+        {
+            printf( "\nContext: %s", fd.message.c_str() );
+        }
+        if( fd.callstack != 0 )
+        {
+            AnsiPrintf( ANSI_BOLD, "\n%sFailure callstack:%s\n" );
+            auto& cs = worker.GetCallstack( fd.callstack );
+            int fidx = 0;
+            int bidx = 0;
+            for( auto& entry : cs )
+            {
+                auto frameData = worker.GetCallstackFrame( entry );
+                if( !frameData )
+                {
+                    printf( "%3i. %p\n", fidx++, (void*)worker.GetCanonicalPointer( entry ) );
+                }
+                else
+                {
+                    const auto fsz = frameData->size;
+                    for( uint8_t f=0; f<fsz; f++ )
+                    {
+                        const auto& frame = frameData->data[f];
+                        auto txt = worker.GetString( frame.name );
+
+                        if( fidx == 0 && f != fsz-1 )
+                        {
+                            auto test = tracy::s_tracyStackFrames;
+                            bool match = false;
+                            do
+                            {
+                                if( strcmp( txt, *test ) == 0 )
+                                {
+                                    match = true;
+                                    break;
+                                }
+                            }
+                            while( *++test );
+                            if( match ) continue;
+                        }
+
+                        bidx++;
+
+                        if( f == fsz-1 )
+                        {
+                            printf( "%3i. ", fidx++ );
+                        }
+                        else
+                        {
+                            AnsiPrintf( ANSI_BLACK ANSI_BOLD, "inl. " );
+                        }
+                        AnsiPrintf( ANSI_CYAN, "%s  ", txt );
+                        txt = worker.GetString( frame.file );
+                        if( frame.line == 0 )
+                        {
+                            AnsiPrintf( ANSI_YELLOW, "(%s)", txt );
+                        }
+                        else
+                        {
+                            AnsiPrintf( ANSI_YELLOW, "(%s:%" PRIu32 ")", txt, frame.line );
+                        }
+                        if( frameData->imageName.Active() )
+                        {
+                            AnsiPrintf( ANSI_MAGENTA, " %s\n", worker.GetString( frameData->imageName ) );
+                        }
+                        else
+                        {
+                            printf( "\n" );
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+static int SaveTrace( tracy::Worker& worker, const char* output, int64_t elapsed )
+{
+    ReportFailure( worker );
+
+    printf( "\nFrames: %" PRIu64 "\nTime span: %s\nZones: %s\nElapsed time: %s\nSaving trace...",
+        worker.GetFrameCount( *worker.GetFramesBase() ), tracy::TimeToString( worker.GetLastTime() ), tracy::RealToString( worker.GetZoneCount() ),
+        tracy::TimeToString( elapsed ) );
+    fflush( stdout );
+    auto f = std::unique_ptr<tracy::FileWrite>( tracy::FileWrite::Open( output ) );
+    if( f )
+    {
+        worker.Write( *f, false );
+        if( f->Finish() )
+        {
+            AnsiPrintf( ANSI_GREEN ANSI_BOLD, " done!\n" );
+            const auto stats = f->GetCompressionStatistics();
+            printf( "Trace size %s (%.2f%% ratio)\n", tracy::MemSizeToString( stats.second ), 100.f * stats.second / stats.first );
+        }
+        else
+        {
+            AnsiPrintf( ANSI_RED ANSI_BOLD, " failed!\n");
+        }
+    }
+    else
+    {
+        AnsiPrintf( ANSI_RED ANSI_BOLD, " failed!\n");
+    }
+
+    return 0;
+}
+
+// Dumps are numbered, with the number inserted before the file extension.
+static std::string DumpName( const char* output, int idx )
+{
+    std::string name = output;
+    auto ext = name.rfind( '.' );
+    const auto sep = name.find_last_of( "/\\" );
+    if( ext == std::string::npos || ( sep != std::string::npos && ext < sep ) ) ext = name.size();
+    name.insert( ext, "-" + std::to_string( idx ) );
+    return name;
+}
+
+static void DumpRollingWindow( tracy::Worker& worker, const char* output, int idx, bool overwrite )
+{
+    const auto name = DumpName( output, idx );
+    struct stat st;
+    if( stat( name.c_str(), &st ) == 0 && !overwrite )
+    {
+        printf( "\nOutput file %s already exists! Use -f to force overwrite.\n", name.c_str() );
+        return;
+    }
+    printf( "\nDumping rolling window to %s...", name.c_str() );
+    fflush( stdout );
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    auto dump = worker.DumpRollingCapture();
+    const auto t1 = std::chrono::high_resolution_clock::now();
+    SaveTrace( *dump, name.c_str(), std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count() );
+}
+
+// Rebuilds the trace from a raw capture, see the -r option.
+static int Convert( const char* input, const char* output )
+{
+    FILE* f = fopen( input, "rb" );
+    if( !f )
+    {
+        printf( "Cannot open input file %s!\n", input );
+        return 5;
+    }
+
+    printf( "Replaying raw capture %s...", input );
+    fflush( stdout );
+    std::unique_ptr<tracy::Worker> worker;
+    try
+    {
+        worker = std::make_unique<tracy::Worker>( f );
+    }
+    catch( const tracy::UnsupportedVersion& )
+    {
+        AnsiPrintf( ANSI_RED ANSI_BOLD, "\nThe raw capture was made with an incompatible protocol version.\n" );
+        return 1;
+    }
+    catch( const tracy::NotTracyDump& )
+    {
+        AnsiPrintf( ANSI_RED ANSI_BOLD, "\nThe file is not a raw capture.\n" );
+        return 1;
+    }
+    catch( const tracy::FileReadError& )
+    {
+        AnsiPrintf( ANSI_RED ANSI_BOLD, "\nThe raw capture header could not be read.\n" );
+        return 1;
+    }
+
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    while( worker->IsConnected() )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+    }
+    const auto t1 = std::chrono::high_resolution_clock::now();
+
+    return SaveTrace( *worker, output, std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count() );
+}
+
 int main( int argc, char** argv )
 {
 #ifdef _WIN32
@@ -109,11 +315,15 @@ int main( int argc, char** argv )
     bool overwrite = false;
     const char* address = "127.0.0.1";
     const char* output = nullptr;
+    const char* input = nullptr;
     int port = 8086;
     int seconds = -1;
+    bool raw = false;
+    double window = 0;
+    const char* trigger = nullptr;
 
     int c;
-    while( ( c = getopt( argc, argv, "a:o:p:fs:" ) ) != -1 )
+    while( ( c = getopt( argc, argv, "a:o:p:fs:ri:w:t:" ) ) != -1 )
     {
         switch( c )
         {
@@ -132,36 +342,58 @@ int main( int argc, char** argv )
         case 's':
             seconds = atoi (optarg);
             break;
+        case 'r':
+            raw = true;
+            break;
+        case 'i':
+            input = optarg;
+            break;
+        case 'w':
+            window = atof( optarg );
+            break;
+        case 't':
+            trigger = optarg;
+            break;
         default:
             Usage();
             break;
         }
     }
 
-    if( !address || !output ) Usage();
+    if( !address || !output || ( input && raw ) ) Usage();
+    if( window < 0 || ( window > 0 && ( input || raw ) ) || ( trigger && window == 0 ) ) Usage();
 
+    // A rolling capture is only saved to the numbered dump files.
+    const auto target = window > 0 ? DumpName( output, 1 ) : std::string( output );
     struct stat st;
-    if( stat( output, &st ) == 0 && !overwrite )
+    if( stat( target.c_str(), &st ) == 0 && !overwrite )
     {
-        printf( "Output file %s already exists! Use -f to force overwrite.\n", output );
+        printf( "Output file %s already exists! Use -f to force overwrite.\n", target.c_str() );
         return 4;
     }
 
-    FILE* test = fopen( output, "wb" );
+    FILE* test = fopen( target.c_str(), "wb" );
     if( !test )
     {
-        printf( "Cannot open output file %s for writing!\n", output );
+        printf( "Cannot open output file %s for writing!\n", target.c_str() );
         return 5;
     }
-    fclose( test );
-    unlink( output );
+    if( !raw )
+    {
+        fclose( test );
+        unlink( target.c_str() );
+    }
+
+    if( input ) return Convert( input, output );
 
     printf( "Connecting to %s:%i...", address, port );
     fflush( stdout );
-    tracy::Worker worker( address, port );
-    while( !worker.IsConnected() )
+    auto worker = window > 0 ?
+        std::make_unique<tracy::Worker>( address, port, int64_t( window * 1000 * 1000 * 1000 ), trigger ) :
+        std::make_unique<tracy::Worker>( address, port, raw ? test : nullptr );
+    while( !worker->IsConnected() )
     {
-        const auto handshake = worker.GetHandshakeStatus();
+        const auto handshake = worker->GetHandshakeStatus();
         if( handshake == tracy::HandshakeProtocolMismatch )
         {
             printf( "\nThe client you are trying to connect to uses incompatible protocol version.\nMake sure you are using the same Tracy version on both client and server.\n" );
@@ -178,8 +410,8 @@ int main( int argc, char** argv )
             return 3;
         }
     }
-    while( !worker.HasData() ) std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
-    printf( "\nQueue delay: %s\nTimer resolution: %s\n", tracy::TimeToString( worker.GetDelay() ), tracy::TimeToString( worker.GetResolution() ) );
+    while( !worker->HasData() ) std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+    printf( "\nQueue delay: %s\nTimer resolution: %s\n", tracy::TimeToString( worker->GetDelay() ), tracy::TimeToString( worker->GetResolution() ) );
 
 #ifdef _WIN32
     signal( SIGINT, SigInt );
@@ -188,19 +420,31 @@ int main( int argc, char** argv )
     memset( &sigint, 0, sizeof( sigint ) );
     sigint.sa_handler = SigInt;
     sigaction( SIGINT, &sigint, &oldsigint );
+    if( window > 0 )
+    {
+        struct sigaction sigusr1;
+        memset( &sigusr1, 0, sizeof( sigusr1 ) );
+        sigusr1.sa_handler = SigUsr1;
+        sigaction( SIGUSR1, &sigusr1, nullptr );
+    }
 #endif
 
-    auto& lock = worker.GetMbpsDataLock();
+    auto& lock = worker->GetMbpsDataLock();
+
+    int dumpIdx = 1;
+    uint32_t triggers = 0;
+    std::chrono::time_point<std::chrono::high_resolution_clock> triggerTime;
+    bool triggerPending = false;
 
     const auto t0 = std::chrono::high_resolution_clock::now();
-    while( worker.IsConnected() )
+    while( worker->IsConnected() )
     {
         // Relaxed order is sufficient here because `s_disconnect` is only ever
         // set by this thread or by the SigInt handler, and that handler does
         // nothing else than storing `s_disconnect`.
         if( s_disconnect.load( std::memory_order_relaxed ) )
         {
-            worker.Disconnect();
+            worker->Disconnect();
             // Relaxed order is sufficient because only this thread ever reads
             // this value.
             s_disconnect.store(false, std::memory_order_relaxed );
@@ -208,9 +452,9 @@ int main( int argc, char** argv )
         }
 
         lock.lock();
-        const auto mbps = worker.GetMbpsData().back();
-        const auto compRatio = worker.GetCompRatio();
-        const auto netTotal = worker.GetDataTransferred();
+        const auto mbps = worker->GetMbpsData().back();
+        const auto compRatio = worker->GetCompRatio();
+        const auto netTotal = worker->GetDataTransferred();
         lock.unlock();
 
         // Output progress info only if destination is a TTY to avoid bloating
@@ -235,10 +479,33 @@ int main( int argc, char** argv )
             printf( " | ");
             AnsiPrintf( ANSI_RED ANSI_BOLD, "%s", tracy::MemSizeToString( tracy::memUsage ) );
             printf( " | ");
-            AnsiPrintf( ANSI_RED, "%s", tracy::TimeToString( worker.GetLastTime() ) );
+            AnsiPrintf( ANSI_RED, "%s", tracy::TimeToString( worker->GetLastTime() ) );
             fflush( stdout );
         }
 
+        if( window > 0 )
+        {
+            // Dumping is delayed after a trigger, so that the replies to the queries made for the
+            // triggering events have time to arrive.
+            const auto now = std::chrono::high_resolution_clock::now();
+            const auto cnt = worker->GetRollingTriggerCount();
+            if( cnt != triggers )
+            {
+                triggers = cnt;
+                if( !triggerPending )
+                {
+                    triggerPending = true;
+                    triggerTime = now;
+                }
+            }
+            if( triggerPending && now - triggerTime >= std::chrono::seconds( 1 ) )
+            {
+                triggerPending = false;
+                s_dump.store( true, std::memory_order_relaxed );
+            }
+            if( s_dump.exchange( false, std::memory_order_relaxed ) ) DumpRollingWindow( *worker, output, dumpIdx++, overwrite );
+        }
+
         std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
         if( seconds != -1 )
         {
@@ -253,103 +520,20 @@ int main( int argc, char** argv )
     }
     const auto t1 = std::chrono::high_resolution_clock::now();
 
-    const auto& failure = worker.GetFailureType();
-    if( failure != tracy::Worker::Failure::None )
-    {
-        AnsiPrintf( ANSI_RED ANSI_BOLD, "\nInstrumentation failure: %s", tracy::Worker::GetFailureString( failure ) );
-        auto& fd = worker.GetFailureData();
-        if( !fd.message.empty() )
-        {
-            printf( "\nContext: %s", fd.message.c_str() );
-        }
-        if( fd.callstack != 0 )
-        {
-            AnsiPrintf( ANSI_BOLD, "\n%sFailure callstack:%s\n" );
-            auto& cs = worker.GetCallstack( fd.callstack );
-            int fidx = 0;
-            int bidx = 0;
-            for( auto& entry : cs )
-            {
-                auto frameData = worker.GetCallstackFrame( entry );
-                if( !frameData )
-                {
-                    printf( "%3i. %p\n", fidx++, (void*)worker.GetCanonicalPointer( entry ) );
-                }
-                else
-                {
-                    const auto fsz = frameData->size;
-                    for( uint8_t f=0; f<fsz; f++ )
-                    {
-                        const auto& frame = frameData->data[f];
-                        auto txt = worker.GetString( frame.name );
-
-                        if( fidx == 0 && f != fsz-1 )
-                        {
-                            auto test = tracy::s_tracyStackFrames;
-                            bool match = false;
-                            do
-                            {
-                                if( strcmp( txt, *test ) == 0 )
-                                {
-                                    match = true;
-                                    break;
-                                }
-                            }
-                            while( *++test );
-                            if( match ) continue;
-                        }
-
-                        bidx++;
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count();
 
-                        if( f == fsz-1 )
-                        {
-                            printf( "%3i. ", fidx++ );
-                        }
-                        else
-                        {
-                            AnsiPrintf( ANSI_BLACK ANSI_BOLD, "inl. " );
-                        }
-                        AnsiPrintf( ANSI_CYAN, "%s  ", txt );
-                        txt = worker.GetString( frame.file );
-                        if( frame.line == 0 )
-                        {
-                            AnsiPrintf( ANSI_YELLOW, "(%s)", txt );
-                        }
-                        else
-                        {
-                            AnsiPrintf( ANSI_YELLOW, "(%s:%" PRIu32 ")", txt, frame.line );
-                        }
-                        if( frameData->imageName.Active() )
-                        {
-                            AnsiPrintf( ANSI_MAGENTA, " %s\n", worker.GetString( frameData->imageName ) );
-                        }
-                        else
-                        {
-                            printf( "\n" );
-                        }
-                    }
-                }
-            }
-        }
-    }
-
-    printf( "\nFrames: %" PRIu64 "\nTime span: %s\nZones: %s\nElapsed time: %s\nSaving trace...",
-        worker.GetFrameCount( *worker.GetFramesBase() ), tracy::TimeToString( worker.GetLastTime() ), tracy::RealToString( worker.GetZoneCount() ),
-        tracy::TimeToString( std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count() ) );
-    fflush( stdout );
-    auto f = std::unique_ptr<tracy::FileWrite>( tracy::FileWrite::Open( output ) );
-    if( f )
+    if( raw )
     {
-        worker.Write( *f, false );
-        AnsiPrintf( ANSI_GREEN ANSI_BOLD, " done!\n" );
-        f->Finish();
-        const auto stats = f->GetCompressionStatistics();
-        printf( "Trace size %s (%.2f%% ratio)\n", tracy::MemSizeToString( stats.second ), 100.f * stats.second / stats.first );
+        ReportFailure( *worker );
+        printf( "\nTime span: %s\nElapsed time: %s\nRaw capture size %s, use capture -i %s to convert it\n",
+            tracy::TimeToString( worker->GetLastTime() ), tracy::TimeToString( elapsed ), tracy::MemSizeToString( worker->GetDataTransferred() ), output );
+        return 0;
     }
-    else
+    if( window > 0 )
     {
-        AnsiPrintf( ANSI_RED ANSI_BOLD, " failed!\n");
+        ReportFailure( *worker );
+        DumpRollingWindow( *worker, output, dumpIdx, overwrite );
+        return 0;
     }
-
-    return 0;
+    return SaveTrace( *worker, output, elapsed );
 }
@@ -0,0 +1,11 @@
+CFLAGS +=
+CXXFLAGS := $(CFLAGS) -std=gnu++17
+INCLUDES := $(shell pkg-config --cflags capstone)
+LIBS := $(shell pkg-config --libs capstone) -lpthread
+PROJECT := compare
+IMAGE := $(PROJECT)-$(BUILD)
+
+FILTER :=
+include ../../../common/src-from-vcxproj.mk
+
+include ../../../common/unix.mk
@@ -0,0 +1,282 @@
+#ifdef _WIN32
+#  include <windows.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../server/TracyFileRead.hpp"
+#include "../../server/TracyWorker.hpp"
+#include "../../server/TracyZoneCompare.hpp"
+#include "../../getopt/getopt.h"
+
+void print_usage_exit(int e)
+{
+    fprintf(stderr, "Compare zone statistics of two traces and report regressions\n");
+    fprintf(stderr, "Usage:\n");
+    fprintf(stderr, "  compare [OPTION...] <baseline trace> <trace>\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  -h, --help             Print usage\n");
+    fprintf(stderr, "  -f, --filter arg       Filter zone names (default: "")\n");
+    fprintf(stderr, "  -c, --case             Case sensitive filtering\n");
+    fprintf(stderr, "  -s, --sep arg          CSV separator (default: ,)\n");
+    fprintf(stderr, "  -r, --regressions      Only print regressed zones\n");
+    fprintf(stderr, "  -n, --min-count arg    Ignore zones with fewer calls in either trace (default: 1)\n");
+    fprintf(stderr, "  -t, --min-time arg     Ignore zones with baseline mean time below arg ns (default: 0)\n");
+    fprintf(stderr, "  -m, --mean arg         Max. allowed mean time increase, in percent\n");
+    fprintf(stderr, "  -d, --median arg       Max. allowed median time increase, in percent\n");
+    fprintf(stderr, "  -p, --p99 arg          Max. allowed 99th percentile time increase, in percent\n");
+    fprintf(stderr, "  -C, --count arg        Max. allowed call count increase, in percent\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Exits with 2 if any zone exceeds one of the given limits.\n");
+
+    exit(e);
+}
+
+struct Args {
+    const char* filter;
+    const char* separator;
+    const char* baseline_file;
+    const char* trace_file;
+    bool case_sensitive;
+    bool regressions_only;
+    uint64_t min_count;
+    int64_t min_time;
+    // Negative values disable the check.
+    double max_mean;
+    double max_median;
+    double max_p99;
+    double max_count;
+};
+
+Args parse_args(int argc, char** argv)
+{
+    if (argc == 1)
+    {
+        print_usage_exit(1);
+    }
+
+    Args args = { "", ",", "", "", false, false, 1, 0, -1, -1, -1, -1 };
+
+    struct option long_opts[] = {
+        { "help", no_argument, NULL, 'h' },
+        { "filter", required_argument, NULL, 'f' },
+        { "case", no_argument, NULL, 'c' },
+        { "sep", required_argument, NULL, 's' },
+        { "regressions", no_argument, NULL, 'r' },
+        { "min-count", required_argument, NULL, 'n' },
+        { "min-time", required_argument, NULL, 't' },
+        { "mean", required_argument, NULL, 'm' },
+        { "median", required_argument, NULL, 'd' },
+        { "p99", required_argument, NULL, 'p' },
+        { "count", required_argument, NULL, 'C' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "hf:cs:rn:t:m:d:p:C:", long_opts, NULL)) != -1)
+    {
+        switch (c)
+        {
+        case 'h':
+            print_usage_exit(0);
+            break;
+        case 'f':
+            args.filter = optarg;
+            break;
+        case 'c':
+            args.case_sensitive = true;
+            break;
+        case 's':
+            args.separator = optarg;
+            break;
+        case 'r':
+            args.regressions_only = true;
+            break;
+        case 'n':
+            args.min_count = strtoull(optarg, NULL, 10);
+            break;
+        case 't':
+            args.min_time = strtoll(optarg, NULL, 10);
+            break;
+        case 'm':
+            args.max_mean = atof(optarg);
+            break;
+        case 'd':
+            args.max_median = atof(optarg);
+            break;
+        case 'p':
+            args.max_p99 = atof(optarg);
+            break;
+        case 'C':
+            args.max_count = atof(optarg);
+            break;
+        default:
+            print_usage_exit(1);
+            break;
+        }
+    }
+
+    if (argc != optind + 2)
+    {
+        print_usage_exit(1);
+    }
+
+    args.baseline_file = argv[optind];
+    args.trace_file = argv[optind + 1];
+
+    return args;
+}
+
+bool is_substring(
+    const char* term,
+    const char* s,
+    bool case_sensitive = false
+){
+    auto new_term = std::string(term);
+    auto new_s = std::string(s);
+
+    if (!case_sensitive) {
+        std::transform(
+            new_term.begin(),
+            new_term.end(),
+            new_term.begin(),
+            [](unsigned char c){ return std::tolower(c); }
+        );
+
+        std::transform(
+            new_s.begin(),
+            new_s.end(),
+            new_s.begin(),
+            [](unsigned char c){ return std::tolower(c); }
+        );
+    }
+
+    return new_s.find(new_term) != std::string::npos;
+}
+
+std::unique_ptr<tracy::Worker> load_trace(const char* fn)
+{
+    auto f = std::unique_ptr<tracy::FileRead>(tracy::FileRead::Open(fn));
+    if (!f)
+    {
+        fprintf(stderr, "Could not open file %s\n", fn);
+        exit(1);
+    }
+
+    try
+    {
+        // Only the zones are needed, everything else is skipped during load.
+        return std::make_unique<tracy::Worker>(*f, tracy::EventType::None);
+    }
+    catch (const tracy::UnsupportedVersion&)
+    {
+        fprintf(stderr, "%s: file is from a future version of Tracy\n", fn);
+    }
+    catch (const tracy::NotTracyDump&)
+    {
+        fprintf(stderr, "%s: not a Tracy trace\n", fn);
+    }
+    catch (const tracy::FileReadError&)
+    {
+        fprintf(stderr, "%s: read error\n", fn);
+    }
+    catch (const tracy::LegacyVersion&)
+    {
+        fprintf(stderr, "%s: legacy trace, use the update utility to convert it\n", fn);
+    }
+    exit(1);
+}
+
+// Relative change of the trace value to the baseline value, in percent.
+double get_change(double base, double value)
+{
+    if (base == 0) return value == 0 ? 0 : 100;
+    return (value - base) / base * 100;
+}
+
+int main(int argc, char** argv)
+{
+#ifdef _WIN32
+    if (!AttachConsole(ATTACH_PARENT_PROCESS))
+    {
+        AllocConsole();
+        SetConsoleMode(GetStdHandle(STD_OUTPUT_HANDLE), 0x07);
+    }
+#endif
+
+    Args args = parse_args(argc, argv);
+
+    // The background processing of the first trace overlaps with loading of the second one.
+    auto baseline = load_trace(args.baseline_file);
+    auto trace = load_trace(args.trace_file);
+
+    while (!baseline->AreSourceLocationZonesReady() || !trace->AreSourceLocationZonesReady())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::function<bool(const char*)> filter;
+    if (args.filter[0] != '\0')
+    {
+        filter = [&args](const char* name) { return is_substring(args.filter, name, args.case_sensitive); };
+    }
+
+    // Zone compare lists the source locations of its first worker.
+    tracy::ZoneCompare compare;
+    auto result = compare.Run(*trace, *baseline, filter);
+
+    std::sort(result.begin(), result.end(), [](const auto& lhs, const auto& rhs) {
+        return get_change(lhs.median[1], lhs.median[0]) > get_change(rhs.median[1], rhs.median[0]);
+    });
+
+    const char* sep = args.separator;
+    printf("name%ssrc_file%ssrc_line", sep, sep);
+    const char* stats[] = { "counts", "mean_ns", "median_ns", "p99_ns" };
+    for (auto& v : stats)
+    {
+        printf("%sbase_%s%s%s%schange_perc_%s", sep, v, sep, v, sep, v);
+    }
+    printf("%sregression\n", sep);
+
+    size_t regressions = 0;
+    for (auto& v : result)
+    {
+        if (v.count[0] < args.min_count || v.count[1] < args.min_count) continue;
+        const double mean[2] = { double(v.total[0]) / v.count[0], double(v.total[1]) / v.count[1] };
+        if (mean[1] < args.min_time) continue;
+
+        const double base[4] = { double(v.count[1]), mean[1], double(v.median[1]), double(v.p99[1]) };
+        const double value[4] = { double(v.count[0]), mean[0], double(v.median[0]), double(v.p99[0]) };
+        const double limit[4] = { args.max_count, args.max_mean, args.max_median, args.max_p99 };
+        double change[4];
+        bool regressed = false;
+        for (int i=0; i<4; i++)
+        {
+            change[i] = get_change(base[i], value[i]);
+            if (limit[i] >= 0 && change[i] > limit[i]) regressed = true;
+        }
+        if (regressed) regressions++;
+        else if (args.regressions_only) continue;
+
+        const auto& srcloc = trace->GetSourceLocation(v.srcloc[0]);
+        printf("%s%s%s%s%u", trace->GetZoneName(srcloc), sep, trace->GetString(srcloc.file), sep, srcloc.line);
+        for (int i=0; i<4; i++)
+        {
+            printf("%s%.0f%s%.0f%s%.2f", sep, base[i], sep, value[i], sep, change[i]);
+        }
+        printf("%s%d\n", sep, regressed ? 1 : 0);
+    }
+
+    fprintf(stderr, "%zu zones compared, %zu regressions\n", result.size(), regressions);
+    return regressions != 0 ? 2 : 0;
+}
@@ -196,7 +196,7 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    auto worker = tracy::Worker(*f);
+    auto worker = tracy::Worker(*f, tracy::EventType::None);
 
     while (!worker.AreSourceLocationZonesReady())
     {
@@ -33,11 +33,19 @@
 #  include <cxxabi.h>
 #  include <stdlib.h>
 #  include "TracyFastVector.hpp"
+#  ifdef TRACY_HAS_OFFLINE_SYMBOLS
+#    include <link.h>
+#    include <unistd.h>
+#  endif
 #elif TRACY_HAS_CALLSTACK == 5
 #  include <dlfcn.h>
 #  include <cxxabi.h>
 #endif
 
+#ifdef TRACY_HAS_FRAME_POINTER_CALLSTACK
+#  include <pthread.h>
+#endif
+
 #ifdef TRACY_DBGHELP_LOCK
 #  include "TracyProfiler.hpp"
 
@@ -94,6 +102,34 @@ extern "C" const char* ___tracy_demangle( const char* mangled )
 namespace tracy
 {
 
+#ifdef TRACY_HAS_FRAME_POINTER_CALLSTACK
+TRACY_API void GetThreadStackRange( uintptr_t& lo, uintptr_t& hi )
+{
+    // An empty range makes the frame pointer walk stop right away.
+    static thread_local bool s_init = false;
+    static thread_local uintptr_t s_lo = 0;
+    static thread_local uintptr_t s_hi = 0;
+    if( !s_init )
+    {
+        s_init = true;
+        pthread_attr_t attr;
+        if( pthread_getattr_np( pthread_self(), &attr ) == 0 )
+        {
+            void* addr;
+            size_t size;
+            if( pthread_attr_getstack( &attr, &addr, &size ) == 0 )
+            {
+                s_lo = (uintptr_t)addr;
+                s_hi = s_lo + size;
+            }
+            pthread_attr_destroy( &attr );
+        }
+    }
+    lo = s_lo;
+    hi = s_hi;
+}
+#endif
+
 #if TRACY_HAS_CALLSTACK == 1
 
 enum { MaxCbTrace = 16 };
@@ -600,6 +636,104 @@ struct DebugInfo
 FastVector<DebugInfo> s_di_known( 16 );
 #endif
 
+#ifdef TRACY_HAS_OFFLINE_SYMBOLS
+// Images of the process, sorted by start address. Symbols are not resolved in the process, the
+// client only reports where each image is loaded, and the frames are resolved offline from local
+// copies of the images, which are matched by their build id.
+FastVector<ImageInfo> s_imageCache( 64 );
+
+static char* GetImageBuildId( const struct dl_phdr_info* info )
+{
+    for( ElfW(Half) i=0; i<info->dlpi_phnum; i++ )
+    {
+        const auto& phdr = info->dlpi_phdr[i];
+        if( phdr.p_type != PT_NOTE ) continue;
+        const size_t align = phdr.p_align == 8 ? 8 : 4;
+        auto ptr = (const char*)( info->dlpi_addr + phdr.p_vaddr );
+        const auto end = ptr + phdr.p_memsz;
+        while( ptr + sizeof( ElfW(Nhdr) ) <= end )
+        {
+            const auto note = (const ElfW(Nhdr)*)ptr;
+            const auto name = ptr + sizeof( ElfW(Nhdr) );
+            const auto desc = name + ( ( note->n_namesz + align - 1 ) & ~( align - 1 ) );
+            const auto next = desc + ( ( note->n_descsz + align - 1 ) & ~( align - 1 ) );
+            if( next > end ) break;
+            if( note->n_type == NT_GNU_BUILD_ID && note->n_namesz == 4 && memcmp( name, "GNU", 4 ) == 0 )
+            {
+                auto buildId = (char*)tracy_malloc( note->n_descsz * 2 + 1 );
+                for( ElfW(Word) j=0; j<note->n_descsz; j++ )
+                {
+                    sprintf( buildId + j * 2, "%02x", (uint8_t)desc[j] );
+                }
+                buildId[note->n_descsz * 2] = '\0';
+                return buildId;
+            }
+            ptr = next;
+        }
+    }
+    return CopyString( "" );
+}
+
+static int ImageCacheCallback( struct dl_phdr_info* info, size_t /*size*/, void* /*data*/ )
+{
+    uint64_t start = std::numeric_limits<uint64_t>::max();
+    uint64_t end = 0;
+    for( ElfW(Half) i=0; i<info->dlpi_phnum; i++ )
+    {
+        const auto& phdr = info->dlpi_phdr[i];
+        if( phdr.p_type != PT_LOAD ) continue;
+        start = std::min<uint64_t>( start, info->dlpi_addr + phdr.p_vaddr );
+        end = std::max<uint64_t>( end, info->dlpi_addr + phdr.p_vaddr + phdr.p_memsz );
+    }
+    if( start >= end ) return 0;
+    for( auto& v : s_imageCache )
+    {
+        if( v.start == start ) return 0;
+    }
+
+    char* path;
+    if( info->dlpi_name && *info->dlpi_name )
+    {
+        path = CopyString( info->dlpi_name );
+    }
+    else
+    {
+        // The main executable has no name here.
+        char buf[4096];
+        const auto sz = readlink( "/proc/self/exe", buf, sizeof( buf ) );
+        path = sz > 0 ? CopyString( buf, sz ) : CopyString( "[unknown]" );
+    }
+
+    auto image = s_imageCache.push_next();
+    image->start = start;
+    image->end = end;
+    image->base = info->dlpi_addr;
+    image->path = path;
+    image->buildId = GetImageBuildId( info );
+    image->connectionId = std::numeric_limits<uint64_t>::max();
+    return 0;
+}
+
+static ImageInfo* FindCachedImage( uint64_t ptr )
+{
+    auto it = std::upper_bound( s_imageCache.begin(), s_imageCache.end(), ptr, []( const uint64_t& lhs, const ImageInfo& rhs ) { return lhs < rhs.start; } );
+    if( it == s_imageCache.begin() ) return nullptr;
+    --it;
+    return ptr < it->end ? it : nullptr;
+}
+
+ImageInfo* FindImageInfo( uint64_t ptr )
+{
+    auto image = FindCachedImage( ptr );
+    if( image ) return image;
+
+    // The image may have been loaded after the cache was last updated.
+    dl_iterate_phdr( ImageCacheCallback, nullptr );
+    std::sort( s_imageCache.begin(), s_imageCache.end(), []( const ImageInfo& lhs, const ImageInfo& rhs ) { return lhs.start < rhs.start; } );
+    return FindCachedImage( ptr );
+}
+#endif
+
 #ifdef __linux
 struct KernelSymbol
 {
@@ -697,7 +831,9 @@ static void InitKernelSymbols()
 
 void InitCallstack()
 {
+#ifndef TRACY_HAS_OFFLINE_SYMBOLS
     cb_bts = backtrace_create_state( nullptr, 0, nullptr, nullptr );
+#endif
     ___tracy_init_demangle_buffer();
 
 #ifdef __linux
@@ -777,8 +913,44 @@ void EndCallstack()
     ClearDebugInfoVector( s_di_known );
     debuginfod_end( s_debuginfod );
 #endif
+#ifdef TRACY_HAS_OFFLINE_SYMBOLS
+    for( auto& v : s_imageCache )
+    {
+        tracy_free( (void*)v.path );
+        tracy_free( (void*)v.buildId );
+    }
+    s_imageCache.clear();
+#endif
+}
+
+#ifdef TRACY_HAS_OFFLINE_SYMBOLS
+const char* DecodeCallstackPtrFast( uint64_t ptr )
+{
+    static char ret[1024];
+    Dl_info dlinfo;
+    if( dladdr( (void*)ptr, &dlinfo ) && dlinfo.dli_sname )
+    {
+        const auto len = std::min<size_t>( strlen( dlinfo.dli_sname ), sizeof( ret ) - 1 );
+        memcpy( ret, dlinfo.dli_sname, len );
+        ret[len] = '\0';
+    }
+    else
+    {
+        *ret = '\0';
+    }
+    return ret;
+}
+
+CallstackSymbolData DecodeSymbolAddress( uint64_t /*ptr*/ )
+{
+    return CallstackSymbolData { "[unknown]", 0, false, 0 };
 }
 
+CallstackSymbolData DecodeCodeAddress( uint64_t /*ptr*/ )
+{
+    return CallstackSymbolData { "[unknown]", 0, false, 0 };
+}
+#else
 static int FastCallstackDataCb( void* data, uintptr_t pc, uintptr_t lowaddr, const char* fn, int lineno, const char* function )
 {
     if( function )
@@ -984,12 +1156,32 @@ void SymInfoError( void* /*data*/, const char* /*msg*/, int /*errnum*/ )
     cb_data[cb_num-1].symLen = 0;
     cb_data[cb_num-1].symAddr = 0;
 }
+#endif
 
 CallstackEntryData DecodeCallstackPtr( uint64_t ptr )
 {
     InitRpmalloc();
     if( ptr >> 63 == 0 )
     {
+#ifdef TRACY_HAS_OFFLINE_SYMBOLS
+        // The "[unresolved]" prefix marks the frame for the symbol resolution in the update utility.
+        auto image = FindImageInfo( ptr );
+        if( image )
+        {
+            char buf[64];
+            sprintf( buf, "[unresolved] +0x%llx", (unsigned long long)( ptr - image->base ) );
+            cb_data[0].name = CopyStringFast( buf );
+        }
+        else
+        {
+            cb_data[0].name = CopyStringFast( "[unknown]" );
+        }
+        cb_data[0].file = CopyStringFast( "[unknown]" );
+        cb_data[0].line = 0;
+        cb_data[0].symLen = 0;
+        cb_data[0].symAddr = 0;
+        return { cb_data, 1, image ? image->path : "[unknown]" };
+#else
         cb_num = 0;
         backtrace_pcinfo( cb_bts, ptr, CallstackDataCb, CallstackErrorCb, nullptr );
         assert( cb_num > 0 );
@@ -1001,6 +1193,7 @@ CallstackEntryData DecodeCallstackPtr( uint64_t ptr )
         if( dladdr( (void*)ptr, &dlinfo ) ) symloc = dlinfo.dli_fname;
 
         return { cb_data, uint8_t( cb_num ), symloc ? symloc : "[unknown]" };
+#endif
     }
 #ifdef __linux
     else if( s_kernelSym )
@@ -30,6 +30,14 @@
 #    define TRACY_HAS_CALLSTACK 6
 #  endif
 
+#  if defined TRACY_HAS_CALLSTACK && defined __linux && ( defined __x86_64__ || defined __aarch64__ )
+#    define TRACY_HAS_FRAME_POINTER_CALLSTACK
+#  endif
+
+#  if defined TRACY_SYMBOL_OFFLINE_RESOLVE && defined TRACY_HAS_CALLSTACK && ( TRACY_HAS_CALLSTACK == 2 || TRACY_HAS_CALLSTACK == 3 )
+#    define TRACY_HAS_OFFLINE_SYMBOLS
+#  endif
+
 #endif
 
 #endif
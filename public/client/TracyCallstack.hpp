@@ -63,7 +63,72 @@ const uint8_t* GetBuildIdForImage( const char* image, size_t& size );
 debuginfod_client* GetDebuginfodClient();
 #endif
 
-#if TRACY_HAS_CALLSTACK == 1
+#ifdef TRACY_HAS_OFFLINE_SYMBOLS
+struct ImageInfo
+{
+    uint64_t start;
+    uint64_t end;
+    uint64_t base;
+    const char* path;
+    const char* buildId;
+    uint64_t connectionId;      // connection on which the image was last announced, maintained by the caller
+};
+
+// The returned pointer is valid until the next call.
+ImageInfo* FindImageInfo( uint64_t ptr );
+#endif
+
+#ifdef TRACY_HAS_FRAME_POINTER_CALLSTACK
+
+TRACY_API void GetThreadStackRange( uintptr_t& lo, uintptr_t& hi );
+
+// Follows the chain of frame records, which is only complete if the code is compiled with
+// -fno-omit-frame-pointer. The walk stops at the first frame pointer which is outside of the
+// thread's stack, misaligned, or not above the previous one (e.g. on a fiber or signal stack).
+static tracy_force_inline void* FramePointerCallstack( int depth )
+{
+    assert( depth >= 1 && depth < 63 );
+
+    auto trace = (uintptr_t*)tracy_malloc( ( 1 + depth ) * sizeof( uintptr_t ) );
+
+    uintptr_t pc;
+#  if defined __x86_64__
+    asm volatile( "lea 0(%%rip), %0" : "=r" ( pc ) );
+#  else
+    asm volatile( "adr %0, ." : "=r" ( pc ) );
+#  endif
+    trace[1] = pc;
+    int num = 1;
+
+    uintptr_t lo, hi;
+    GetThreadStackRange( lo, hi );
+    auto fp = (uintptr_t)__builtin_frame_address( 0 );
+    while( num < depth )
+    {
+        if( fp < lo || fp + 2 * sizeof( uintptr_t ) > hi || ( fp & ( sizeof( uintptr_t ) - 1 ) ) != 0 ) break;
+        const auto frame = (const uintptr_t*)fp;
+        const auto ret = frame[1];
+        if( ret == 0 ) break;
+        trace[++num] = ret;
+        const auto next = frame[0];
+        if( next <= fp ) break;
+        fp = next;
+    }
+
+    *trace = num;
+    return trace;
+}
+
+#endif
+
+#if defined TRACY_FRAME_POINTER_UNWIND && defined TRACY_HAS_FRAME_POINTER_CALLSTACK
+
+static tracy_force_inline void* Callstack( int depth )
+{
+    return FramePointerCallstack( depth );
+}
+
+#elif TRACY_HAS_CALLSTACK == 1
 
 extern "C"
 {
@@ -49,6 +49,7 @@
 #include <assert.h>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <limits>
 #include <new>
 #include <stdlib.h>
@@ -61,6 +62,12 @@
 #include "../common/TracySystem.hpp"
 #include "../common/TracyYield.hpp"
 #include "../common/tracy_lz4.hpp"
+#ifdef TRACY_ZSTD_COMPRESSION
+#  ifdef TRACY_PARALLEL_COMPRESSION
+#    error "TRACY_ZSTD_COMPRESSION can't be used together with TRACY_PARALLEL_COMPRESSION"
+#  endif
+#  include <zstd.h>
+#endif
 #include "tracy_rpmalloc.hpp"
 #include "TracyCallstack.hpp"
 #include "TracyDxt1.hpp"
@@ -263,6 +270,7 @@ struct InitTimeWrapper
 
 struct ProducerWrapper
 {
+    ~ProducerWrapper();
     tracy::moodycamel::ConcurrentQueue<QueueItem>::ExplicitProducer* ptr;
 };
 
@@ -1089,6 +1097,9 @@ static Thread* s_compressThread;
 static Thread* s_symbolThread;
 std::atomic<bool> s_symbolThreadGone { false };
 #endif
+#ifdef TRACY_PARALLEL_COMPRESSION
+static Thread* s_dataCompressThreads;
+#endif
 #ifdef TRACY_HAS_SYSTEM_TRACING
 static Thread* s_sysTraceThread = nullptr;
 #endif
@@ -1125,14 +1136,20 @@ struct ProducerWrapper
     tracy::moodycamel::ConcurrentQueue<QueueItem>::ExplicitProducer* ptr;
 };
 
+thread_local bool ProducerShutdown = false;
+
 struct ProfilerThreadData
 {
     ProfilerThreadData( ProfilerData& data ) : token( data ), gpuCtx( { nullptr } ) {}
+    ~ProfilerThreadData() { ProducerShutdown = true; }
     ProducerWrapper token;
     GpuCtxWrapper gpuCtx;
 #  ifdef TRACY_ON_DEMAND
     LuaZoneState luaZoneState;
 #  endif
+#  ifdef TRACY_QUEUE_BUDGET
+    DeferredZone* deferredZone = nullptr;
+#  endif
 };
 
 std::atomic<int> RpInitDone { 0 };
@@ -1256,6 +1273,9 @@ std::atomic<ThreadNameData*>& GetThreadNameData() { return GetProfilerData().thr
 #  ifdef TRACY_ON_DEMAND
 TRACY_API LuaZoneState& GetLuaZoneState() { return GetProfilerThreadData().luaZoneState; }
 #  endif
+#  ifdef TRACY_QUEUE_BUDGET
+TRACY_API DeferredZone*& GetDeferredZone() { return GetProfilerThreadData().deferredZone; }
+#  endif
 
 #  ifndef TRACY_MANUAL_LIFETIME
 namespace
@@ -1274,6 +1294,8 @@ extern moodycamel::ConcurrentQueue<QueueItem> s_queue;
 // 2. If these variables would be in the .CRT$XCB section, they would be initialized only in main thread.
 thread_local moodycamel::ProducerToken init_order(107) s_token_detail( s_queue );
 thread_local ProducerWrapper init_order(108) s_token { s_queue.get_explicit_producer( s_token_detail ) };
+thread_local bool ProducerShutdown = false;
+ProducerWrapper::~ProducerWrapper() { ProducerShutdown = true; }
 thread_local ThreadHandleWrapper init_order(104) s_threadHandle { detail::GetThreadHandleImpl() };
 
 #  ifdef _MSC_VER
@@ -1300,6 +1322,9 @@ std::atomic<ThreadNameData*>& s_threadNameData = s_threadNameDataInstance;
 #  ifdef TRACY_ON_DEMAND
 thread_local LuaZoneState init_order(104) s_luaZoneState { 0, false };
 #  endif
+#  ifdef TRACY_QUEUE_BUDGET
+thread_local DeferredZone* s_deferredZone = nullptr;
+#  endif
 
 static Profiler init_order(105) s_profiler;
 
@@ -1317,10 +1342,14 @@ std::atomic<ThreadNameData*>& GetThreadNameData() { return s_threadNameData; }
 #  ifdef TRACY_ON_DEMAND
 TRACY_API LuaZoneState& GetLuaZoneState() { return s_luaZoneState; }
 #  endif
+#  ifdef TRACY_QUEUE_BUDGET
+TRACY_API DeferredZone*& GetDeferredZone() { return s_deferredZone; }
+#  endif
 #endif
 
 TRACY_API bool ProfilerAvailable() { return s_instance != nullptr; }
 TRACY_API bool ProfilerAllocatorAvailable() { return !RpThreadShutdown; }
+TRACY_API bool ProfilerThreadQueueAvailable() { return !ProducerShutdown; }
 
 Profiler::Profiler()
     : m_timeBegin( 0 )
@@ -1340,8 +1369,29 @@ Profiler::Profiler()
     , m_bufferOffset( 0 )
     , m_bufferStart( 0 )
     , m_lz4Buf( (char*)tracy_malloc( LZ4Size + sizeof( lz4sz_t ) ) )
+#ifdef TRACY_ZSTD_COMPRESSION
+    , m_streamZstd( ZSTD_createCCtx() )
+    , m_zstdLevel( 3 )
+#endif
+#ifdef TRACY_PARALLEL_COMPRESSION
+    , m_dataFrames( nullptr )
+    , m_dataFramesNum( 0 )
+    , m_dataFramesWrite( 0 )
+    , m_dataFramesSend( 0 )
+    , m_dataCompressThreads( 4 )
+    , m_dataCompressId( 0 )
+#endif
     , m_serialQueue( 1024*1024 )
     , m_serialDequeue( 1024*1024 )
+    , m_memSeq( 0 )
+    , m_memSeqNext( 0 )
+    , m_memSeqEnd( 0 )
+    , m_memGapTime( 0 )
+    , m_memSlots( nullptr )
+    , m_memSlotsSize( 0 )
+    , m_memSkipped( 16 )
+    , m_memTimeLast( 0 )
+    , m_callstackCache( (CallstackCacheEntry*)tracy_malloc( sizeof( CallstackCacheEntry ) * CallstackCacheSize ) )
 #ifndef TRACY_NO_FRAME_IMAGE
     , m_fiQueue( 16 )
     , m_fiDequeue( 16 )
@@ -1352,6 +1402,12 @@ Profiler::Profiler()
 #ifdef TRACY_ON_DEMAND
     , m_connectionId( 0 )
     , m_deferredQueue( 64*1024 )
+#endif
+#ifdef TRACY_QUEUE_BUDGET
+    , m_throttle( false )
+    , m_droppedZones( 0 )
+    , m_droppedReportTime( 0 )
+    , m_queueBudget( 256 * 1024 * 1024 / sizeof( QueueItem ) )
 #endif
     , m_paramCallback( nullptr )
     , m_queryImage( nullptr )
@@ -1361,11 +1417,13 @@ Profiler::Profiler()
     assert( !s_instance );
     s_instance = this;
 
+    memset( m_callstackCache, 0, sizeof( CallstackCacheEntry ) * CallstackCacheSize );
+
 #ifndef TRACY_DELAYED_INIT
 #  ifdef _MSC_VER
     // 3. But these variables need to be initialized in main thread within the .CRT$XCB section. Do it here.
     s_token_detail = moodycamel::ProducerToken( s_queue );
-    s_token = ProducerWrapper { s_queue.get_explicit_producer( s_token_detail ) };
+    s_token.ptr = s_queue.get_explicit_producer( s_token_detail );
     s_threadHandle = ThreadHandleWrapper { m_mainThread };
 #  endif
 #endif
@@ -1388,6 +1446,50 @@ Profiler::Profiler()
         m_userPort = atoi( userPort );
     }
 
+#ifdef TRACY_QUEUE_BUDGET
+    const char* queueBudget = GetEnvVar( "TRACY_QUEUE_BUDGET" );
+    if( queueBudget )
+    {
+        m_queueBudget = std::max( atoi( queueBudget ), 1 ) * size_t( 1024 * 1024 ) / sizeof( QueueItem );
+    }
+    int64_t dropThreshold = 10000;    // 10 us
+    const char* dropThresholdEnv = GetEnvVar( "TRACY_DROP_THRESHOLD" );
+    if( dropThresholdEnv )
+    {
+        dropThreshold = std::max( atoi( dropThresholdEnv ), 0 );
+    }
+    m_dropThreshold = int64_t( dropThreshold / m_timerMul );
+#endif
+
+#ifdef TRACY_ZSTD_COMPRESSION
+    const char* zstdLevel = GetEnvVar( "TRACY_ZSTD_LEVEL" );
+    if( zstdLevel )
+    {
+        m_zstdLevel = std::min( std::max( atoi( zstdLevel ), 1 ), ZSTD_maxCLevel() );
+    }
+#endif
+
+#ifdef TRACY_PARALLEL_COMPRESSION
+    const char* compressThreads = GetEnvVar( "TRACY_COMPRESSION_THREADS" );
+    if( compressThreads )
+    {
+        m_dataCompressThreads = std::min( std::max( atoi( compressThreads ), 1 ), 16 );
+    }
+
+    // Each compression thread owns every N-th frame slot, two slots per thread keep it busy while the
+    // previous frame is being sent.
+    m_dataFramesNum = m_dataCompressThreads * 2;
+    m_dataFrames = (DataFrame*)tracy_malloc( sizeof( DataFrame ) * m_dataFramesNum );
+    for( uint32_t i=0; i<m_dataFramesNum; i++ )
+    {
+        auto& frame = m_dataFrames[i];
+        frame.data = (char*)tracy_malloc( TargetFrameSize );
+        frame.lz4 = (char*)tracy_malloc( LZ4Size + sizeof( lz4sz_t ) );
+        frame.size = 0;
+        new(&frame.state) std::atomic<DataFrameState>( DataFrameState::Free );
+    }
+#endif
+
 #if !defined(TRACY_DELAYED_INIT) || !defined(TRACY_MANUAL_LIFETIME)
     SpawnWorkerThreads();
 #endif
@@ -1412,6 +1514,14 @@ void Profiler::SpawnWorkerThreads()
     new(s_compressThread) Thread( LaunchCompressWorker, this );
 #endif
 
+#ifdef TRACY_PARALLEL_COMPRESSION
+    s_dataCompressThreads = (Thread*)tracy_malloc( sizeof( Thread ) * m_dataCompressThreads );
+    for( uint32_t i=0; i<m_dataCompressThreads; i++ )
+    {
+        new(s_dataCompressThreads+i) Thread( LaunchDataCompressWorker, this );
+    }
+#endif
+
 #ifdef TRACY_HAS_CALLSTACK
     s_symbolThread = (Thread*)tracy_malloc( sizeof( Thread ) );
     new(s_symbolThread) Thread( LaunchSymbolWorker, this );
@@ -1493,13 +1603,32 @@ Profiler::~Profiler()
     s_thread->~Thread();
     tracy_free( s_thread );
 
+#ifdef TRACY_PARALLEL_COMPRESSION
+    { std::lock_guard<std::mutex> lock( m_dataFrameLock ); }
+    m_dataFrameWorkCv.notify_all();
+    for( uint32_t i=0; i<m_dataCompressThreads; i++ ) s_dataCompressThreads[i].~Thread();
+    tracy_free( s_dataCompressThreads );
+    for( uint32_t i=0; i<m_dataFramesNum; i++ )
+    {
+        tracy_free( m_dataFrames[i].data );
+        tracy_free( m_dataFrames[i].lz4 );
+    }
+    tracy_free( m_dataFrames );
+#endif
+
 #ifdef TRACY_HAS_CALLSTACK
     EndCallstack();
 #endif
 
+    if( m_memSlots ) tracy_free( m_memSlots );
+    ClearCallstackCache();
+    tracy_free( m_callstackCache );
     tracy_free( m_lz4Buf );
     tracy_free( m_buffer );
     LZ4_freeStream( (LZ4_stream_t*)m_stream );
+#ifdef TRACY_ZSTD_COMPRESSION
+    ZSTD_freeCCtx( (ZSTD_CCtx*)m_streamZstd );
+#endif
 
     if( m_sock )
     {
@@ -1579,6 +1708,12 @@ void Profiler::Worker()
 #ifndef TRACY_NO_CODE_TRANSFER
     flags |= WelcomeFlag::CodeTransfer;
 #endif
+#ifdef TRACY_PARALLEL_COMPRESSION
+    flags |= WelcomeFlag::IndependentFrames;
+#endif
+#ifdef TRACY_ZSTD_COMPRESSION
+    flags |= WelcomeFlag::ZstdFrames;
+#endif
 #ifdef _WIN32
     flags |= WelcomeFlag::CombineSamples;
 #  ifndef TRACY_NO_CONTEXT_SWITCH
@@ -1711,6 +1846,9 @@ void Profiler::Worker()
             if( m_sock ) break;
 #ifndef TRACY_ON_DEMAND
             ProcessSysTime();
+#  ifdef TRACY_QUEUE_BUDGET
+            UpdateQueueBudget();
+#  endif
 #endif
 
             if( m_broadcast )
@@ -1770,7 +1908,12 @@ void Profiler::Worker()
 #ifdef TRACY_ON_DEMAND
         const auto currentTime = GetTime();
         ClearQueues( token );
+        m_memSeqNext = m_memSeqEnd = m_memSeq.load( std::memory_order_relaxed );
         m_connectionId.fetch_add( 1, std::memory_order_release );
+#  ifdef TRACY_QUEUE_BUDGET
+        // Zones dropped during a lost connection can't be reported to the new one.
+        m_droppedZones.store( 0, std::memory_order_relaxed );
+#  endif
 #endif
         m_isConnected.store( true, std::memory_order_release );
 
@@ -1778,12 +1921,22 @@ void Profiler::Worker()
         m_sock->Send( &handshake, sizeof( handshake ) );
 
         LZ4_resetStream( (LZ4_stream_t*)m_stream );
+#ifdef TRACY_ZSTD_COMPRESSION
+        ZSTD_CCtx_reset( (ZSTD_CCtx*)m_streamZstd, ZSTD_reset_session_and_parameters );
+        ZSTD_CCtx_setParameter( (ZSTD_CCtx*)m_streamZstd, ZSTD_c_compressionLevel, m_zstdLevel );
+#endif
+#ifdef TRACY_PARALLEL_COMPRESSION
+        ResetDataFrames();
+#endif
         m_sock->Send( &welcome, sizeof( welcome ) );
 
         m_threadCtx = 0;
         m_refTimeSerial = 0;
         m_refTimeCtx = 0;
         m_refTimeGpu = 0;
+        m_refSrcLoc = 0;
+        m_memTimeLast = 0;
+        ClearCallstackCache();
 
 #ifdef TRACY_ON_DEMAND
         OnDemandPayloadMessage onDemand;
@@ -1828,6 +1981,9 @@ void Profiler::Worker()
         for(;;)
         {
             ProcessSysTime();
+#ifdef TRACY_QUEUE_BUDGET
+            UpdateQueueBudget();
+#endif
             const auto status = Dequeue( token );
             const auto serialStatus = DequeueSerial();
             if( status == DequeueStatus::ConnectionLost || serialStatus == DequeueStatus::ConnectionLost )
@@ -1837,6 +1993,7 @@ void Profiler::Worker()
             else if( status == DequeueStatus::QueueEmpty && serialStatus == DequeueStatus::QueueEmpty )
             {
                 if( ShouldExit() ) break;
+                if( !SendMemEvents( m_memSeqNext ) ) break;
                 if( m_bufferOffset != m_bufferStart )
                 {
                     if( !CommitData() ) break;
@@ -1943,6 +2100,8 @@ void Profiler::Worker()
         }
         else if( status == DequeueStatus::QueueEmpty && serialStatus == DequeueStatus::QueueEmpty )
         {
+            // Events still waiting for a lost sequence number will not get it anymore.
+            SendMemEvents( m_memSeqEnd );
             if( m_bufferOffset != m_bufferStart ) CommitData();
             break;
         }
@@ -1967,6 +2126,14 @@ void Profiler::Worker()
 #endif
     }
 
+#ifdef TRACY_QUEUE_BUDGET
+    if( !SendDroppedZones() )
+    {
+        m_shutdownFinished.store( true, std::memory_order_relaxed );
+        return;
+    }
+#endif
+
     // Send client termination notice to the server
     QueueItem terminate;
     MemWrite( &terminate.hdr.type, QueueType::Terminate );
@@ -2217,6 +2384,7 @@ void Profiler::ClearQueues( moodycamel::ConsumerToken& token )
     }
 
     ClearSerial();
+    ClearMemEvents();
 }
 
 void Profiler::ClearSerial()
@@ -2241,6 +2409,21 @@ void Profiler::ClearSerial()
     m_serialDequeue.clear();
 }
 
+static tracy_force_inline size_t WriteTimeCompact( QueueItem* item, int64_t dt )
+{
+    auto ptr = (char*)item;
+    return WriteVarInt( ptr + sizeof( QueueHeader ), ZigZagEncode( dt ) ) - ptr;
+}
+
+static tracy_force_inline size_t WriteZoneBeginCompact( QueueItem* item, int64_t dt, uint64_t srcloc, uint64_t& refSrcLoc )
+{
+    auto ptr = (char*)item;
+    auto end = WriteVarInt( ptr + sizeof( QueueHeader ), ZigZagEncode( dt ) );
+    end = WriteVarInt( end, ZigZagEncode( int64_t( srcloc - refSrcLoc ) ) );
+    refSrcLoc = srcloc;
+    return end - ptr;
+}
+
 Profiler::DequeueStatus Profiler::Dequeue( moodycamel::ConsumerToken& token )
 {
     bool connectionLost = false;
@@ -2262,6 +2445,7 @@ Profiler::DequeueStatus Profiler::Dequeue( moodycamel::ConsumerToken& token )
                 uint64_t ptr;
                 uint16_t size;
                 auto idx = MemRead<uint8_t>( &item->hdr.idx );
+                size_t len = QueueDataSize[idx];
                 if( idx < (int)QueueType::Terminate )
                 {
                     switch( (QueueType)idx )
@@ -2273,6 +2457,24 @@ Profiler::DequeueStatus Profiler::Dequeue( moodycamel::ConsumerToken& token )
                         SendSingleString( (const char*)ptr, size );
                         tracy_free_fast( (void*)ptr );
                         break;
+                    case QueueType::CallstackSerial:
+                    case QueueType::MemAlloc:
+                    case QueueType::MemAllocNamed:
+                    case QueueType::MemAllocCallstack:
+                    case QueueType::MemAllocCallstackNamed:
+                    case QueueType::MemFree:
+                    case QueueType::MemFreeNamed:
+                    case QueueType::MemFreeCallstack:
+                    case QueueType::MemFreeCallstackNamed:
+                        if( !StashMemEvent( *item++ ) )
+                        {
+                            connectionLost = true;
+                            m_refTimeThread = refThread;
+                            m_refTimeCtx = refCtx;
+                            m_refTimeGpu = refGpu;
+                            return;
+                        }
+                        continue;
                     case QueueType::Message:
                     case QueueType::MessageCallstack:
                         ptr = MemRead<uint64_t>( &item->messageFat.text );
@@ -2301,16 +2503,15 @@ Profiler::DequeueStatus Profiler::Dequeue( moodycamel::ConsumerToken& token )
                         int64_t t = MemRead<int64_t>( &item->zoneBegin.time );
                         int64_t dt = t - refThread;
                         refThread = t;
-                        MemWrite( &item->zoneBegin.time, dt );
                         ptr = MemRead<uint64_t>( &item->zoneBegin.srcloc );
                         SendSourceLocationPayload( ptr );
                         tracy_free_fast( (void*)ptr );
+                        len = WriteTimeCompact( item, dt );
                         break;
                     }
                     case QueueType::Callstack:
                         ptr = MemRead<uint64_t>( &item->callstackFat.ptr );
                         SendCallstackPayload( ptr );
-                        tracy_free_fast( (void*)ptr );
                         break;
                     case QueueType::CallstackAlloc:
                         ptr = MemRead<uint64_t>( &item->callstackAllocFat.nativePtr );
@@ -2318,7 +2519,6 @@ Profiler::DequeueStatus Profiler::Dequeue( moodycamel::ConsumerToken& token )
                         {
                             CutCallstack( (void*)ptr, "lua_pcall" );
                             SendCallstackPayload( ptr );
-                            tracy_free_fast( (void*)ptr );
                         }
                         ptr = MemRead<uint64_t>( &item->callstackAllocFat.ptr );
                         SendCallstackAlloc( ptr );
@@ -2329,7 +2529,6 @@ Profiler::DequeueStatus Profiler::Dequeue( moodycamel::ConsumerToken& token )
                     {
                         ptr = MemRead<uint64_t>( &item->callstackSampleFat.ptr );
                         SendCallstackPayload64( ptr );
-                        tracy_free_fast( (void*)ptr );
                         int64_t t = MemRead<int64_t>( &item->callstackSampleFat.time );
                         int64_t dt = t - refCtx;
                         refCtx = t;
@@ -2352,7 +2551,7 @@ Profiler::DequeueStatus Profiler::Dequeue( moodycamel::ConsumerToken& token )
                         int64_t t = MemRead<int64_t>( &item->zoneBegin.time );
                         int64_t dt = t - refThread;
                         refThread = t;
-                        MemWrite( &item->zoneBegin.time, dt );
+                        len = WriteZoneBeginCompact( item, dt, MemRead<uint64_t>( &item->zoneBegin.srcloc ), m_refSrcLoc );
                         break;
                     }
                     case QueueType::ZoneEnd:
@@ -2360,7 +2559,7 @@ Profiler::DequeueStatus Profiler::Dequeue( moodycamel::ConsumerToken& token )
                         int64_t t = MemRead<int64_t>( &item->zoneEnd.time );
                         int64_t dt = t - refThread;
                         refThread = t;
-                        MemWrite( &item->zoneEnd.time, dt );
+                        len = WriteTimeCompact( item, dt );
                         break;
                     }
                     case QueueType::GpuZoneBegin:
@@ -2480,6 +2679,15 @@ Profiler::DequeueStatus Profiler::Dequeue( moodycamel::ConsumerToken& token )
                         if( needFree ) tracy_free_fast( (void*)fileString );
                         break;
                     }
+                    case QueueType::ImageInfo:
+                    {
+                        // The strings are owned by the image cache.
+                        auto path = (const char*)MemRead<uint64_t>( &item->imageInfoFat.path );
+                        auto buildId = (const char*)MemRead<uint64_t>( &item->imageInfoFat.buildId );
+                        SendSingleString( path );
+                        SendSecondString( buildId );
+                        break;
+                    }
                     case QueueType::SymbolCodeMetadata:
                     {
                         auto symbol = MemRead<uint64_t>( &item->symbolCodeMetadata.symbol );
@@ -2510,7 +2718,19 @@ Profiler::DequeueStatus Profiler::Dequeue( moodycamel::ConsumerToken& token )
                         break;
                     }
                 }
-                if( !AppendData( item++, QueueDataSize[idx] ) )
+                else if( idx == (int)QueueType::MemNamePayload )
+                {
+                    if( !StashMemEvent( *item++ ) )
+                    {
+                        connectionLost = true;
+                        m_refTimeThread = refThread;
+                        m_refTimeCtx = refCtx;
+                        m_refTimeGpu = refGpu;
+                        return;
+                    }
+                    continue;
+                }
+                if( !AppendData( item++, len ) )
                 {
                     connectionLost = true;
                     m_refTimeThread = refThread;
@@ -2522,6 +2742,7 @@ Profiler::DequeueStatus Profiler::Dequeue( moodycamel::ConsumerToken& token )
             m_refTimeThread = refThread;
             m_refTimeCtx = refCtx;
             m_refTimeGpu = refGpu;
+            if( !SendMemEvents( m_memSeqNext ) ) connectionLost = true;
         }
     );
     if( connectionLost ) return DequeueStatus::ConnectionLost;
@@ -2588,6 +2809,211 @@ Profiler::DequeueStatus Profiler::DequeueContextSwitches( tracy::moodycamel::Con
     return ( timeStop == -1 || sz > 0 ) ? DequeueStatus::DataDequeued : DequeueStatus::QueueEmpty;
 }
 
+// Memory events wait in the reorder stash until all events with lower sequence
+// numbers were received. The stash grows to cover every event received so far.
+// A sequence number is lost if the thread which took it was stopped before
+// posting the event. Waiting for it ends after a timeout, but only when all
+// queues are drained, as the event may still wait in one of them. An event which
+// arrives after its sequence number was given up on is sent out of order.
+enum { MemSlotsInitialSize = 1024 };
+enum { MemGapTimeout = 500 * 1000 * 1000 };     // 500 ms
+
+bool Profiler::StashMemEvent( const QueueItem& item )
+{
+    uint32_t seq;
+    switch( item.hdr.type )
+    {
+    case QueueType::CallstackSerial:
+        seq = MemRead<uint32_t>( &item.callstackFatSeq.seq );
+        break;
+    case QueueType::MemNamePayload:
+        seq = MemRead<uint32_t>( &item.memNameSeq.seq );
+        break;
+    case QueueType::MemAlloc:
+    case QueueType::MemAllocNamed:
+    case QueueType::MemAllocCallstack:
+    case QueueType::MemAllocCallstackNamed:
+        seq = MemRead<uint32_t>( &item.memAllocSeq.seq );
+        break;
+    default:
+        seq = MemRead<uint32_t>( &item.memFreeSeq.seq );
+        break;
+    }
+
+    const auto dist = seq - m_memSeqNext;
+    if( int32_t( dist ) < 0 ) return StashSkippedMemEvent( item, seq );
+    if( dist >= m_memSlotsSize )
+    {
+        auto size = m_memSlotsSize == 0 ? uint32_t( MemSlotsInitialSize ) : m_memSlotsSize;
+        while( dist >= size ) size *= 2;
+        auto slots = (MemEventSlot*)tracy_malloc( sizeof( MemEventSlot ) * size );
+        memset( slots, 0, sizeof( MemEventSlot ) * size );
+        for( uint32_t i=0; i<m_memSlotsSize; i++ )
+        {
+            const auto s = m_memSeqNext + i;
+            memcpy( slots + ( s & ( size - 1 ) ), m_memSlots + ( s & ( m_memSlotsSize - 1 ) ), sizeof( MemEventSlot ) );
+        }
+        if( m_memSlots ) tracy_free( m_memSlots );
+        m_memSlots = slots;
+        m_memSlotsSize = size;
+    }
+    if( int32_t( seq + 1 - m_memSeqEnd ) > 0 ) m_memSeqEnd = seq + 1;
+
+    auto& slot = m_memSlots[seq & ( m_memSlotsSize - 1 )];
+    switch( item.hdr.type )
+    {
+    case QueueType::CallstackSerial:
+        slot.callstack = MemRead<uint64_t>( &item.callstackFatSeq.ptr );
+        break;
+    case QueueType::MemNamePayload:
+        slot.name = MemRead<uint64_t>( &item.memNameSeq.name );
+        break;
+    default:
+        // Memory event is always posted after its callstack and name.
+        memcpy( &slot.event, &item, sizeof( QueueItem ) );
+        slot.ready = true;
+        break;
+    }
+    return true;
+}
+
+bool Profiler::StashSkippedMemEvent( const QueueItem& item, uint32_t seq )
+{
+    auto it = m_memSkipped.begin();
+    while( it != m_memSkipped.end() && it->seq != seq ) it++;
+    if( it == m_memSkipped.end() )
+    {
+        // Event was issued before the current connection was established.
+        FreeAssociatedMemory( item );
+        return true;
+    }
+
+    switch( item.hdr.type )
+    {
+    case QueueType::CallstackSerial:
+        it->callstack = MemRead<uint64_t>( &item.callstackFatSeq.ptr );
+        return true;
+    case QueueType::MemNamePayload:
+        it->name = MemRead<uint64_t>( &item.memNameSeq.name );
+        return true;
+    default:
+        break;
+    }
+
+    MemEventSlot slot;
+    memcpy( &slot.event, &item, sizeof( QueueItem ) );
+    slot.callstack = it->callstack;
+    slot.name = it->name;
+    *it = m_memSkipped.back();
+    m_memSkipped.pop_back();
+
+    int64_t refSerial = m_refTimeSerial;
+    const auto ok = SendMemEvent( slot, refSerial );
+    m_refTimeSerial = refSerial;
+    return ok;
+}
+
+bool Profiler::MemQueuesEmpty()
+{
+    if( GetQueue().size_approx() != 0 || !m_serialDequeue.empty() ) return false;
+    m_serialLock.lock();
+    const auto empty = m_serialQueue.empty();
+    m_serialLock.unlock();
+    return empty;
+}
+
+// Events with sequence numbers below skipUntil are sent without waiting for the missing ones.
+bool Profiler::SendMemEvents( uint32_t skipUntil )
+{
+    int64_t refSerial = m_refTimeSerial;
+    while( m_memSeqNext != m_memSeqEnd )
+    {
+        auto& slot = m_memSlots[m_memSeqNext & ( m_memSlotsSize - 1 )];
+        if( !slot.ready )
+        {
+            if( int32_t( skipUntil - m_memSeqNext ) <= 0 )
+            {
+                const auto t = GetTime();
+                if( m_memGapTime == 0 ) m_memGapTime = t;
+                if( t - m_memGapTime < int64_t( MemGapTimeout / m_timerMul ) ) break;
+                if( !MemQueuesEmpty() ) break;
+            }
+            auto skipped = m_memSkipped.push_next();
+            skipped->seq = m_memSeqNext;
+            skipped->callstack = slot.callstack;
+            skipped->name = slot.name;
+            slot.callstack = 0;
+            slot.name = 0;
+            m_memSeqNext++;
+            m_memGapTime = 0;
+            continue;
+        }
+        m_memGapTime = 0;
+
+        slot.ready = false;
+        m_memSeqNext++;
+        if( !SendMemEvent( slot, refSerial ) )
+        {
+            m_refTimeSerial = refSerial;
+            return false;
+        }
+    }
+    m_refTimeSerial = refSerial;
+    return true;
+}
+
+bool Profiler::SendMemEvent( MemEventSlot& slot, int64_t& refSerial )
+{
+    if( slot.callstack != 0 )
+    {
+        SendCallstackPayload( slot.callstack );
+        QueueItem item;
+        MemWrite( &item.hdr.type, QueueType::CallstackSerial );
+        AppendData( &item, QueueDataSize[(int)QueueType::CallstackSerial] );
+    }
+    if( slot.name != 0 )
+    {
+        QueueItem item;
+        MemWrite( &item.hdr.type, QueueType::MemNamePayload );
+        MemWrite( &item.memName.name, slot.name );
+        AppendData( &item, QueueDataSize[(int)QueueType::MemNamePayload] );
+    }
+
+    // Order of sequence numbers and timestamps may differ slightly, as they
+    // are not retrieved atomically. Server requires monotonic time.
+    auto item = &slot.event;
+    const auto idx = MemRead<uint8_t>( &item->hdr.idx );
+    static_assert( offsetof( QueueMemAlloc, time ) == offsetof( QueueMemFree, time ), "Memory event time offset mismatch" );
+    int64_t t = MemRead<int64_t>( &item->memAlloc.time );
+    if( t < m_memTimeLast ) t = m_memTimeLast;
+    m_memTimeLast = t;
+    int64_t dt = t - refSerial;
+    refSerial = t;
+    MemWrite( &item->memAlloc.time, dt );
+
+    slot.callstack = 0;
+    slot.name = 0;
+
+    return AppendData( item, QueueDataSize[idx] );
+}
+
+void Profiler::ClearMemEvents()
+{
+    for( uint32_t i=0; i<m_memSlotsSize; i++ )
+    {
+        auto& slot = m_memSlots[i];
+        if( slot.callstack != 0 ) tracy_free_fast( (void*)slot.callstack );
+    }
+    if( m_memSlots ) memset( m_memSlots, 0, sizeof( MemEventSlot ) * m_memSlotsSize );
+    for( auto& v : m_memSkipped )
+    {
+        if( v.callstack != 0 ) tracy_free_fast( (void*)v.callstack );
+    }
+    m_memSkipped.clear();
+    m_memSeqEnd = m_memSeqNext;
+    m_memGapTime = 0;
+}
+
 #define ThreadCtxCheckSerial( _name ) \
     uint32_t thread = MemRead<uint32_t>( &item->_name.thread ); \
     switch( ThreadCtxCheck( thread ) ) \
@@ -2632,6 +3058,12 @@ Profiler::DequeueStatus Profiler::DequeueSerial()
         {
             uint64_t ptr;
             auto idx = MemRead<uint8_t>( &item->hdr.idx );
+            size_t len = QueueDataSize[idx];
+            if( idx == (int)QueueType::MemNamePayload )
+            {
+                if( !StashMemEvent( *item++ ) ) return DequeueStatus::ConnectionLost;
+                continue;
+            }
             if( idx < (int)QueueType::Terminate )
             {
                 switch( (QueueType)idx )
@@ -2639,7 +3071,6 @@ Profiler::DequeueStatus Profiler::DequeueSerial()
                 case QueueType::CallstackSerial:
                     ptr = MemRead<uint64_t>( &item->callstackFat.ptr );
                     SendCallstackPayload( ptr );
-                    tracy_free_fast( (void*)ptr );
                     break;
                 case QueueType::LockWait:
                 case QueueType::LockSharedWait:
@@ -2680,25 +3111,15 @@ Profiler::DequeueStatus Profiler::DequeueSerial()
                 }
                 case QueueType::MemAlloc:
                 case QueueType::MemAllocNamed:
-                case QueueType::MemAllocCallstack:
-                case QueueType::MemAllocCallstackNamed:
-                {
-                    int64_t t = MemRead<int64_t>( &item->memAlloc.time );
-                    int64_t dt = t - refSerial;
-                    refSerial = t;
-                    MemWrite( &item->memAlloc.time, dt );
-                    break;
-                }
                 case QueueType::MemFree:
                 case QueueType::MemFreeNamed:
-                case QueueType::MemFreeCallstack:
-                case QueueType::MemFreeCallstackNamed:
                 {
-                    int64_t t = MemRead<int64_t>( &item->memFree.time );
-                    int64_t dt = t - refSerial;
-                    refSerial = t;
-                    MemWrite( &item->memFree.time, dt );
-                    break;
+                    // Posted by threads which no longer have a queue token.
+                    m_refTimeSerial = refSerial;
+                    const auto ok = StashMemEvent( *item++ );
+                    refSerial = m_refTimeSerial;
+                    if( !ok ) return DequeueStatus::ConnectionLost;
+                    continue;
                 }
                 case QueueType::GpuZoneBeginSerial:
                 case QueueType::GpuZoneBeginCallstackSerial:
@@ -2755,7 +3176,7 @@ Profiler::DequeueStatus Profiler::DequeueSerial()
                     int64_t t = MemRead<int64_t>( &item->zoneBegin.time );
                     int64_t dt = t - refThread;
                     refThread = t;
-                    MemWrite( &item->zoneBegin.time, dt );
+                    len = WriteZoneBeginCompact( item, dt, MemRead<uint64_t>( &item->zoneBegin.srcloc ), m_refSrcLoc );
                     break;
                 }
                 case QueueType::ZoneBeginAllocSrcLoc:
@@ -2765,10 +3186,10 @@ Profiler::DequeueStatus Profiler::DequeueSerial()
                     int64_t t = MemRead<int64_t>( &item->zoneBegin.time );
                     int64_t dt = t - refThread;
                     refThread = t;
-                    MemWrite( &item->zoneBegin.time, dt );
                     ptr = MemRead<uint64_t>( &item->zoneBegin.srcloc );
                     SendSourceLocationPayload( ptr );
                     tracy_free_fast( (void*)ptr );
+                    len = WriteTimeCompact( item, dt );
                     break;
                 }
                 case QueueType::ZoneEnd:
@@ -2777,7 +3198,7 @@ Profiler::DequeueStatus Profiler::DequeueSerial()
                     int64_t t = MemRead<int64_t>( &item->zoneEnd.time );
                     int64_t dt = t - refThread;
                     refThread = t;
-                    MemWrite( &item->zoneEnd.time, dt );
+                    len = WriteTimeCompact( item, dt );
                     break;
                 }
                 case QueueType::ZoneText:
@@ -2815,7 +3236,6 @@ Profiler::DequeueStatus Profiler::DequeueSerial()
                     ThreadCtxCheckSerial( callstackFatThread );
                     ptr = MemRead<uint64_t>( &item->callstackFat.ptr );
                     SendCallstackPayload( ptr );
-                    tracy_free_fast( (void*)ptr );
                     break;
                 }
                 case QueueType::CallstackAlloc:
@@ -2826,7 +3246,6 @@ Profiler::DequeueStatus Profiler::DequeueSerial()
                     {
                         CutCallstack( (void*)ptr, "lua_pcall" );
                         SendCallstackPayload( ptr );
-                        tracy_free_fast( (void*)ptr );
                     }
                     ptr = MemRead<uint64_t>( &item->callstackAllocFat.ptr );
                     SendCallstackAlloc( ptr );
@@ -2899,7 +3318,7 @@ Profiler::DequeueStatus Profiler::DequeueSerial()
                 }
             }
 #endif
-            if( !AppendData( item, QueueDataSize[idx] ) ) return DequeueStatus::ConnectionLost;
+            if( !AppendData( item, len ) ) return DequeueStatus::ConnectionLost;
             item++;
         }
         m_refTimeSerial = refSerial;
@@ -2908,6 +3327,7 @@ Profiler::DequeueStatus Profiler::DequeueSerial()
         m_refTimeThread = refThread;
 #endif
         m_serialDequeue.clear();
+        if( !SendMemEvents( m_memSeqNext ) ) return DequeueStatus::ConnectionLost;
     }
     else
     {
@@ -2919,10 +3339,10 @@ Profiler::DequeueStatus Profiler::DequeueSerial()
 Profiler::ThreadCtxStatus Profiler::ThreadCtxCheck( uint32_t threadId )
 {
     if( m_threadCtx == threadId ) return ThreadCtxStatus::Same;
-    QueueItem item;
-    MemWrite( &item.hdr.type, QueueType::ThreadContext );
-    MemWrite( &item.threadCtx.thread, threadId );
-    if( !AppendData( &item, QueueDataSize[(int)QueueType::ThreadContext] ) ) return ThreadCtxStatus::ConnectionLost;
+    char item[QueueCompactMaxSize];
+    MemWrite( item, QueueType::ThreadContext );
+    const auto end = WriteVarInt( item + sizeof( QueueHeader ), threadId );
+    if( !AppendData( item, end - item ) ) return ThreadCtxStatus::ConnectionLost;
     m_threadCtx = threadId;
     m_refTimeThread = 0;
     return ThreadCtxStatus::Changed;
@@ -2938,11 +3358,149 @@ bool Profiler::CommitData()
 
 bool Profiler::SendData( const char* data, size_t len )
 {
+#if defined TRACY_ZSTD_COMPRESSION
+    // A single zstd stream is kept for the whole connection, each frame is flushed, so that the server
+    // can decompress it right away. Data from previous frames is used as history.
+    static_assert( ZSTD_COMPRESSBOUND( TargetFrameSize ) <= LZ4Size, "Zstd frame doesn't fit in LZ4Size" );
+    ZSTD_inBuffer in = { data, len, 0 };
+    ZSTD_outBuffer out = { m_lz4Buf + sizeof( lz4sz_t ), LZ4Size, 0 };
+    const auto ret = ZSTD_compressStream2( (ZSTD_CCtx*)m_streamZstd, &out, &in, ZSTD_e_flush );
+    if( ZSTD_isError( ret ) || ret != 0 ) return false;
+    const lz4sz_t lz4sz = (lz4sz_t)out.pos;
+#elif defined TRACY_PARALLEL_COMPRESSION
+    if( !SendDataFrames( true ) ) return false;
+    const lz4sz_t lz4sz = LZ4_compress_fast_extState( m_stream, data, m_lz4Buf + sizeof( lz4sz_t ), (int)len, LZ4Size, 1 );
+#else
     const lz4sz_t lz4sz = LZ4_compress_fast_continue( (LZ4_stream_t*)m_stream, data, m_lz4Buf + sizeof( lz4sz_t ), (int)len, LZ4Size, 1 );
+#endif
     memcpy( m_lz4Buf, &lz4sz, sizeof( lz4sz ) );
     return m_sock->Send( m_lz4Buf, lz4sz + sizeof( lz4sz_t ) ) != -1;
 }
 
+#ifdef TRACY_PARALLEL_COMPRESSION
+bool Profiler::QueueDataFrame()
+{
+    auto& frame = m_dataFrames[m_dataFramesWrite % m_dataFramesNum];
+    if( m_dataFramesWrite - m_dataFramesSend == m_dataFramesNum )
+    {
+        assert( &frame == &m_dataFrames[m_dataFramesSend % m_dataFramesNum] );
+        if( !WaitDataFrame( frame ) ) return false;
+    }
+    assert( frame.state.load( std::memory_order_relaxed ) == DataFrameState::Free );
+
+    const auto len = m_bufferOffset - m_bufferStart;
+    memcpy( frame.data, m_buffer + m_bufferStart, len );
+    frame.size = len;
+    frame.state.store( DataFrameState::Pending, std::memory_order_release );
+    m_dataFramesWrite++;
+    { std::lock_guard<std::mutex> lock( m_dataFrameLock ); }
+    m_dataFrameWorkCv.notify_all();
+
+    if( m_bufferOffset > TargetFrameSize * 2 ) m_bufferOffset = 0;
+    m_bufferStart = m_bufferOffset;
+
+    return SendDataFrames( false );
+}
+
+void Profiler::CompressDataFrame( DataFrame& frame, void* state )
+{
+    const lz4sz_t lz4sz = LZ4_compress_fast_extState( state, frame.data, frame.lz4 + sizeof( lz4sz_t ), frame.size, LZ4Size, 1 );
+    memcpy( frame.lz4, &lz4sz, sizeof( lz4sz ) );
+    frame.state.store( DataFrameState::Done, std::memory_order_release );
+    { std::lock_guard<std::mutex> lock( m_dataFrameLock ); }
+    m_dataFrameDoneCv.notify_all();
+}
+
+bool Profiler::ClaimDataFrame( DataFrame& frame )
+{
+    // Returns true if the frame was still pending and is now owned by the caller. Otherwise blocks
+    // until a compression thread has finished it.
+    auto state = frame.state.load( std::memory_order_acquire );
+    if( state == DataFrameState::Pending && frame.state.compare_exchange_strong( state, DataFrameState::Busy, std::memory_order_acquire ) ) return true;
+    if( state != DataFrameState::Done )
+    {
+        std::unique_lock<std::mutex> lock( m_dataFrameLock );
+        m_dataFrameDoneCv.wait( lock, [&] { return frame.state.load( std::memory_order_acquire ) == DataFrameState::Done; } );
+    }
+    return false;
+}
+
+bool Profiler::WaitDataFrame( DataFrame& frame )
+{
+    // Compress the frame here if no compression thread has picked it up yet.
+    if( ClaimDataFrame( frame ) ) CompressDataFrame( frame, m_stream );
+
+    lz4sz_t lz4sz;
+    memcpy( &lz4sz, frame.lz4, sizeof( lz4sz ) );
+    const auto ret = m_sock->Send( frame.lz4, lz4sz + sizeof( lz4sz_t ) ) != -1;
+    frame.state.store( DataFrameState::Free, std::memory_order_relaxed );
+    m_dataFramesSend++;
+    return ret;
+}
+
+bool Profiler::SendDataFrames( bool wait )
+{
+    while( m_dataFramesSend != m_dataFramesWrite )
+    {
+        auto& frame = m_dataFrames[m_dataFramesSend % m_dataFramesNum];
+        if( !wait && frame.state.load( std::memory_order_acquire ) != DataFrameState::Done ) break;
+        if( !WaitDataFrame( frame ) ) return false;
+    }
+    return true;
+}
+
+void Profiler::ResetDataFrames()
+{
+    // Frames left over from a lost connection are compressed and discarded, so that the compression
+    // threads stay in step with the slot ring.
+    while( m_dataFramesSend != m_dataFramesWrite )
+    {
+        auto& frame = m_dataFrames[m_dataFramesSend % m_dataFramesNum];
+        ClaimDataFrame( frame );
+        frame.state.store( DataFrameState::Free, std::memory_order_relaxed );
+        m_dataFramesSend++;
+    }
+}
+
+void Profiler::DataCompressWorker()
+{
+    ThreadExitHandler threadExitHandler;
+    SetThreadName( "Tracy LZ4" );
+    while( m_timeBegin.load( std::memory_order_relaxed ) == 0 ) std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    rpmalloc_thread_initialize();
+
+    auto state = LZ4_createStream();
+    const auto id = m_dataCompressId.fetch_add( 1, std::memory_order_relaxed );
+    const auto hasPending = [this, id] {
+        for( uint32_t idx=id; idx<m_dataFramesNum; idx+=m_dataCompressThreads )
+        {
+            if( m_dataFrames[idx].state.load( std::memory_order_acquire ) == DataFrameState::Pending ) return true;
+        }
+        return false;
+    };
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock( m_dataFrameLock );
+            m_dataFrameWorkCv.wait( lock, [&] { return hasPending() || m_shutdownFinished.load( std::memory_order_relaxed ); } );
+        }
+        bool found = false;
+        for( uint32_t idx=id; idx<m_dataFramesNum; idx+=m_dataCompressThreads )
+        {
+            auto& frame = m_dataFrames[idx];
+            auto expected = DataFrameState::Pending;
+            if( frame.state.compare_exchange_strong( expected, DataFrameState::Busy, std::memory_order_acquire ) )
+            {
+                CompressDataFrame( frame, state );
+                found = true;
+            }
+        }
+        if( !found && m_shutdownFinished.load( std::memory_order_relaxed ) ) break;
+    }
+    LZ4_freeStream( state );
+}
+#endif
+
 void Profiler::SendString( uint64_t str, const char* ptr, size_t len, QueueType type )
 {
     assert( type == QueueType::StringData ||
@@ -3054,15 +3612,68 @@ void Profiler::SendSourceLocationPayload( uint64_t _ptr )
     AppendDataUnsafe( ptr, len );
 }
 
+static tracy_force_inline uint64_t CallstackHash( uint64_t hash, uint64_t val )
+{
+    return ( hash ^ val ) * 0x9E3779B97F4A7C15;
+}
+
+// The callstack payload senders take ownership of the callstack. It is kept in the cache, or freed if
+// the cache already holds the same callstack, in which case only its cache slot is sent.
+bool Profiler::SendCallstackCached( uint64_t ptr, uint64_t hash, bool wide, uint32_t& id )
+{
+    hash ^= hash >> 32;
+    id = uint32_t( hash & ( CallstackCacheSize - 1 ) );
+    auto& entry = m_callstackCache[id];
+    if( entry.ptr != 0 && entry.hash == hash && entry.wide == wide )
+    {
+        const auto esz = wide ? sizeof( uint64_t ) : sizeof( uintptr_t );
+        const auto sz = wide ? *(uint64_t*)ptr : *(uintptr_t*)ptr;
+        const auto entrySz = wide ? *(uint64_t*)entry.ptr : *(uintptr_t*)entry.ptr;
+        if( sz == entrySz && memcmp( (const char*)ptr + esz, (const char*)entry.ptr + esz, sz * esz ) == 0 )
+        {
+            tracy_free_fast( (void*)ptr );
+
+            QueueItem item;
+            MemWrite( &item.hdr.type, QueueType::CallstackCached );
+            MemWrite( &item.callstackCached.id, id );
+            AppendData( &item, QueueDataSize[(int)QueueType::CallstackCached] );
+            return true;
+        }
+    }
+    if( entry.ptr != 0 ) tracy_free_fast( (void*)entry.ptr );
+    entry.hash = hash;
+    entry.ptr = ptr;
+    entry.wide = wide;
+    return false;
+}
+
+void Profiler::ClearCallstackCache()
+{
+    for( uint32_t i=0; i<CallstackCacheSize; i++ )
+    {
+        auto& entry = m_callstackCache[i];
+        if( entry.ptr != 0 )
+        {
+            tracy_free( (void*)entry.ptr );
+            entry.ptr = 0;
+        }
+    }
+}
+
 void Profiler::SendCallstackPayload( uint64_t _ptr )
 {
     auto ptr = (uintptr_t*)_ptr;
 
+    const auto sz = *ptr++;
+    uint64_t hash = sz;
+    for( uintptr_t i=0; i<sz; i++ ) hash = CallstackHash( hash, uint64_t( ptr[i] ) );
+    uint32_t id;
+    if( SendCallstackCached( _ptr, hash, false, id ) ) return;
+
     QueueItem item;
     MemWrite( &item.hdr.type, QueueType::CallstackPayload );
-    MemWrite( &item.stringTransfer.ptr, _ptr );
+    MemWrite( &item.stringTransfer.ptr, uint64_t( id ) );
 
-    const auto sz = *ptr++;
     const auto len = sz * sizeof( uint64_t );
     const auto l16 = uint16_t( len );
 
@@ -3089,11 +3700,16 @@ void Profiler::SendCallstackPayload64( uint64_t _ptr )
 {
     auto ptr = (uint64_t*)_ptr;
 
+    const auto sz = *ptr++;
+    uint64_t hash = sz;
+    for( uint64_t i=0; i<sz; i++ ) hash = CallstackHash( hash, ptr[i] );
+    uint32_t id;
+    if( SendCallstackCached( _ptr, hash, true, id ) ) return;
+
     QueueItem item;
     MemWrite( &item.hdr.type, QueueType::CallstackPayload );
-    MemWrite( &item.stringTransfer.ptr, _ptr );
+    MemWrite( &item.stringTransfer.ptr, uint64_t( id ) );
 
-    const auto sz = *ptr++;
     const auto len = sz * sizeof( uint64_t );
     const auto l16 = uint16_t( len );
 
@@ -3187,6 +3803,24 @@ void Profiler::HandleSymbolQueueItem( const SymbolQueueItem& si )
     {
     case SymbolQueueItemType::CallstackFrame:
     {
+#ifdef TRACY_HAS_OFFLINE_SYMBOLS
+        // The server needs to know where the image is loaded to resolve the frame later.
+        auto image = si.ptr >> 63 == 0 ? FindImageInfo( si.ptr ) : nullptr;
+#ifdef TRACY_ON_DEMAND
+        const auto connectionId = ConnectionId();
+#else
+        const uint64_t connectionId = 0;
+#endif
+        if( image && image->connectionId != connectionId )
+        {
+            image->connectionId = connectionId;
+            TracyLfqPrepare( QueueType::ImageInfo );
+            MemWrite( &item->imageInfoFat.base, image->base );
+            MemWrite( &item->imageInfoFat.path, (uint64_t)image->path );
+            MemWrite( &item->imageInfoFat.buildId, (uint64_t)image->buildId );
+            TracyLfqCommit;
+        }
+#endif
         const auto frameData = DecodeCallstackPtr( si.ptr );
         auto data = tracy_malloc_fast( sizeof( CallstackEntry ) * frameData.size );
         memcpy( data, frameData.data, sizeof( CallstackEntry ) * frameData.size );
@@ -3418,6 +4052,10 @@ void Profiler::HandleDisconnect()
 {
     moodycamel::ConsumerToken token( GetQueue() );
 
+#ifdef TRACY_QUEUE_BUDGET
+    if( !SendDroppedZones() ) return;
+#endif
+
 #ifdef TRACY_HAS_SYSTEM_TRACING
     if( s_sysTraceThread )
     {
@@ -3759,6 +4397,62 @@ void Profiler::CutCallstack( void* callstack, const char* skipBefore )
 #endif
 }
 
+#ifdef TRACY_QUEUE_BUDGET
+void Profiler::UpdateQueueBudget()
+{
+    // Hysteresis prevents flapping when the queue size hovers around the budget.
+    const auto size = GetQueue().size_approx();
+    if( !m_throttle.load( std::memory_order_relaxed ) )
+    {
+        if( size > m_queueBudget )
+        {
+            m_throttle.store( true, std::memory_order_relaxed );
+            m_droppedReportTime = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+            Message( "Queue budget exceeded, dropping short zones", 0 );
+        }
+    }
+    else if( size < m_queueBudget / 2 )
+    {
+        m_throttle.store( false, std::memory_order_relaxed );
+        const auto dropped = m_droppedZones.exchange( 0, std::memory_order_relaxed );
+        char buf[64];
+        const auto len = snprintf( buf, sizeof( buf ), "Queue budget restored, dropped %llu zones", (unsigned long long)dropped );
+        Message( buf, len, 0 );
+    }
+    else
+    {
+        // Report progress while throttling, so that the count isn't lost if the budget is never restored.
+        const auto t = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+        if( t - m_droppedReportTime > 1000000000 )  // 1s
+        {
+            m_droppedReportTime = t;
+            const auto dropped = m_droppedZones.exchange( 0, std::memory_order_relaxed );
+            if( dropped != 0 )
+            {
+                char buf[64];
+                const auto len = snprintf( buf, sizeof( buf ), "Queue budget exceeded, dropped %llu zones", (unsigned long long)dropped );
+                Message( buf, len, 0 );
+            }
+        }
+    }
+}
+
+bool Profiler::SendDroppedZones()
+{
+    // Written directly to the connection, as the queues are not drained anymore when this is called.
+    const auto dropped = m_droppedZones.exchange( 0, std::memory_order_relaxed );
+    if( dropped == 0 ) return true;
+    char buf[64];
+    const auto len = snprintf( buf, sizeof( buf ), "Dropped %llu zones over queue budget", (unsigned long long)dropped );
+    if( ThreadCtxCheck( GetThreadHandle() ) == ThreadCtxStatus::ConnectionLost ) return false;
+    SendSingleString( buf, len );
+    QueueItem item;
+    MemWrite( &item.hdr.type, QueueType::Message );
+    MemWrite( &item.message.time, GetTime() );
+    return AppendData( &item, QueueDataSize[(int)QueueType::Message] );
+}
+#endif
+
 #ifdef TRACY_HAS_SYSTIME
 void Profiler::ProcessSysTime()
 {
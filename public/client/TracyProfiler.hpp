@@ -3,6 +3,8 @@
 
 #include <assert.h>
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <stdint.h>
 #include <string.h>
 #include <time.h>
@@ -70,6 +72,7 @@ TRACY_API GpuCtxWrapper& GetGpuCtx();
 TRACY_API uint32_t GetThreadHandle();
 TRACY_API bool ProfilerAvailable();
 TRACY_API bool ProfilerAllocatorAvailable();
+TRACY_API bool ProfilerThreadQueueAvailable();
 TRACY_API int64_t GetFrequencyQpc();
 
 #if defined TRACY_TIMER_FALLBACK && defined TRACY_HW_TIMER && ( defined __i386 || defined _M_IX86 || defined __x86_64__ || defined _M_X64 )
@@ -106,8 +109,32 @@ struct LuaZoneState
 };
 #endif
 
+#ifdef TRACY_QUEUE_BUDGET
+#  ifdef TRACY_FIBERS
+#    error "TRACY_QUEUE_BUDGET can't be used together with TRACY_FIBERS"
+#  endif
+// Zone begin which was not sent yet, because the queue is over budget. If the zone turns out to be
+// short and has no children, it is dropped. Any other item queued by the thread sends it first, so
+// that the thread's events stay in time order.
+struct DeferredZone
+{
+    int64_t time;
+    uint64_t srcloc;
+#  ifdef TRACY_ON_DEMAND
+    uint64_t connectionId;
+#  endif
+};
+
+TRACY_API DeferredZone*& GetDeferredZone();
+
+#  define TracyFlushDeferredZone tracy::Profiler::SendDeferredZone()
+#else
+#  define TracyFlushDeferredZone
+#endif
+
 
 #define TracyLfqPrepare( _type ) \
+    TracyFlushDeferredZone; \
     moodycamel::ConcurrentQueueDefaultTraits::index_t __magic; \
     auto __token = GetToken(); \
     auto& __tail = __token->get_tail_index(); \
@@ -118,6 +145,7 @@ struct LuaZoneState
     __tail.store( __magic + 1, std::memory_order_release );
 
 #define TracyLfqPrepareC( _type ) \
+    TracyFlushDeferredZone; \
     tracy::moodycamel::ConcurrentQueueDefaultTraits::index_t __magic; \
     auto __token = tracy::GetToken(); \
     auto& __tail = __token->get_tail_index(); \
@@ -178,6 +206,41 @@ class Profiler
         uint32_t extra;
     };
 
+#ifdef TRACY_PARALLEL_COMPRESSION
+    enum class DataFrameState : int { Free, Pending, Busy, Done };
+
+    struct DataFrame
+    {
+        char* data;
+        char* lz4;
+        int size;
+        std::atomic<DataFrameState> state;
+    };
+#endif
+
+    struct MemEventSlot
+    {
+        QueueItem event;
+        uint64_t callstack;
+        uint64_t name;
+        bool ready;
+    };
+
+    // Sequence number given up on while its event was not received yet.
+    struct MemSkippedSlot
+    {
+        uint32_t seq;
+        uint64_t callstack;
+        uint64_t name;
+    };
+
+    struct CallstackCacheEntry
+    {
+        uint64_t hash;
+        uint64_t ptr;
+        bool wide;
+    };
+
 public:
     Profiler();
     ~Profiler();
@@ -462,10 +525,9 @@ public:
         if( !GetProfiler().IsConnected() ) return;
 #endif
         const auto thread = GetThreadHandle();
+        const auto seq = GetProfiler().GetNextMemSeq();
 
-        GetProfiler().m_serialLock.lock();
-        SendMemAlloc( QueueType::MemAlloc, thread, ptr, size );
-        GetProfiler().m_serialLock.unlock();
+        SendMemAlloc( QueueType::MemAlloc, thread, ptr, size, seq );
     }
 
     static tracy_force_inline void MemFree( const void* ptr, bool secure )
@@ -475,15 +537,19 @@ public:
         if( !GetProfiler().IsConnected() ) return;
 #endif
         const auto thread = GetThreadHandle();
+        const auto seq = GetProfiler().GetNextMemSeq();
 
-        GetProfiler().m_serialLock.lock();
-        SendMemFree( QueueType::MemFree, thread, ptr );
-        GetProfiler().m_serialLock.unlock();
+        SendMemFree( QueueType::MemFree, thread, ptr, seq );
     }
 
     static tracy_force_inline void MemAllocCallstack( const void* ptr, size_t size, int depth, bool secure )
     {
         if( secure && !ProfilerAvailable() ) return;
+        if( !ProfilerThreadQueueAvailable() )
+        {
+            MemAlloc( ptr, size, secure );
+            return;
+        }
 #ifdef TRACY_HAS_CALLSTACK
         auto& profiler = GetProfiler();
 #  ifdef TRACY_ON_DEMAND
@@ -493,10 +559,9 @@ public:
 
         auto callstack = Callstack( depth );
 
-        profiler.m_serialLock.lock();
-        SendCallstackSerial( callstack );
-        SendMemAlloc( QueueType::MemAllocCallstack, thread, ptr, size );
-        profiler.m_serialLock.unlock();
+        const auto seq = profiler.GetNextMemSeq();
+        SendMemCallstack( callstack, seq );
+        SendMemAlloc( QueueType::MemAllocCallstack, thread, ptr, size, seq );
 #else
         static_cast<void>(depth); // unused
         MemAlloc( ptr, size, secure );
@@ -506,7 +571,7 @@ public:
     static tracy_force_inline void MemFreeCallstack( const void* ptr, int depth, bool secure )
     {
         if( secure && !ProfilerAvailable() ) return;
-        if( !ProfilerAllocatorAvailable() )
+        if( !ProfilerAllocatorAvailable() || !ProfilerThreadQueueAvailable() )
         {
             MemFree( ptr, secure );
             return;
@@ -520,10 +585,9 @@ public:
 
         auto callstack = Callstack( depth );
 
-        profiler.m_serialLock.lock();
-        SendCallstackSerial( callstack );
-        SendMemFree( QueueType::MemFreeCallstack, thread, ptr );
-        profiler.m_serialLock.unlock();
+        const auto seq = profiler.GetNextMemSeq();
+        SendMemCallstack( callstack, seq );
+        SendMemFree( QueueType::MemFreeCallstack, thread, ptr, seq );
 #else
         static_cast<void>(depth); // unused
         MemFree( ptr, secure );
@@ -537,11 +601,10 @@ public:
         if( !GetProfiler().IsConnected() ) return;
 #endif
         const auto thread = GetThreadHandle();
+        const auto seq = GetProfiler().GetNextMemSeq();
 
-        GetProfiler().m_serialLock.lock();
-        SendMemName( name );
-        SendMemAlloc( QueueType::MemAllocNamed, thread, ptr, size );
-        GetProfiler().m_serialLock.unlock();
+        SendMemName( name, seq );
+        SendMemAlloc( QueueType::MemAllocNamed, thread, ptr, size, seq );
     }
 
     static tracy_force_inline void MemFreeNamed( const void* ptr, bool secure, const char* name )
@@ -551,16 +614,20 @@ public:
         if( !GetProfiler().IsConnected() ) return;
 #endif
         const auto thread = GetThreadHandle();
+        const auto seq = GetProfiler().GetNextMemSeq();
 
-        GetProfiler().m_serialLock.lock();
-        SendMemName( name );
-        SendMemFree( QueueType::MemFreeNamed, thread, ptr );
-        GetProfiler().m_serialLock.unlock();
+        SendMemName( name, seq );
+        SendMemFree( QueueType::MemFreeNamed, thread, ptr, seq );
     }
 
     static tracy_force_inline void MemAllocCallstackNamed( const void* ptr, size_t size, int depth, bool secure, const char* name )
     {
         if( secure && !ProfilerAvailable() ) return;
+        if( !ProfilerThreadQueueAvailable() )
+        {
+            MemAllocNamed( ptr, size, secure, name );
+            return;
+        }
 #ifdef TRACY_HAS_CALLSTACK
         auto& profiler = GetProfiler();
 #  ifdef TRACY_ON_DEMAND
@@ -570,11 +637,10 @@ public:
 
         auto callstack = Callstack( depth );
 
-        profiler.m_serialLock.lock();
-        SendCallstackSerial( callstack );
-        SendMemName( name );
-        SendMemAlloc( QueueType::MemAllocCallstackNamed, thread, ptr, size );
-        profiler.m_serialLock.unlock();
+        const auto seq = profiler.GetNextMemSeq();
+        SendMemCallstack( callstack, seq );
+        SendMemName( name, seq );
+        SendMemAlloc( QueueType::MemAllocCallstackNamed, thread, ptr, size, seq );
 #else
         static_cast<void>(depth); // unused
         static_cast<void>(name); // unused
@@ -585,6 +651,11 @@ public:
     static tracy_force_inline void MemFreeCallstackNamed( const void* ptr, int depth, bool secure, const char* name )
     {
         if( secure && !ProfilerAvailable() ) return;
+        if( !ProfilerThreadQueueAvailable() )
+        {
+            MemFreeNamed( ptr, secure, name );
+            return;
+        }
 #ifdef TRACY_HAS_CALLSTACK
         auto& profiler = GetProfiler();
 #  ifdef TRACY_ON_DEMAND
@@ -594,11 +665,10 @@ public:
 
         auto callstack = Callstack( depth );
 
-        profiler.m_serialLock.lock();
-        SendCallstackSerial( callstack );
-        SendMemName( name );
-        SendMemFree( QueueType::MemFreeCallstackNamed, thread, ptr );
-        profiler.m_serialLock.unlock();
+        const auto seq = profiler.GetNextMemSeq();
+        SendMemCallstack( callstack, seq );
+        SendMemName( name, seq );
+        SendMemFree( QueueType::MemFreeCallstackNamed, thread, ptr, seq );
 #else
         static_cast<void>(depth); // unused
         static_cast<void>(name); // unused
@@ -661,6 +731,42 @@ public:
         return m_isConnected.load( std::memory_order_acquire );
     }
 
+#ifdef TRACY_QUEUE_BUDGET
+    tracy_force_inline bool IsThrottled() const
+    {
+        return m_throttle.load( std::memory_order_relaxed );
+    }
+
+    // Returns false if the zone is too short, and it should be dropped.
+    tracy_force_inline bool KeepDeferredZone( int64_t time )
+    {
+        if( time - GetDeferredZone()->time >= m_dropThreshold ) return true;
+        m_droppedZones.fetch_add( 1, std::memory_order_relaxed );
+        return false;
+    }
+
+    // Can't use TracyLfqPrepare, as it calls this function.
+    static tracy_force_inline void SendDeferredZone()
+    {
+        auto& zone = GetDeferredZone();
+        if( !zone ) return;
+        const auto deferred = zone;
+        zone = nullptr;
+#  ifdef TRACY_ON_DEMAND
+        // The zone was started during a previous connection. Its end won't be sent either.
+        if( GetProfiler().ConnectionId() != deferred->connectionId ) return;
+#  endif
+        moodycamel::ConcurrentQueueDefaultTraits::index_t magic;
+        auto token = GetToken();
+        auto& tail = token->get_tail_index();
+        auto item = token->enqueue_begin( magic );
+        MemWrite( &item->hdr.type, QueueType::ZoneBegin );
+        MemWrite( &item->zoneBegin.time, deferred->time );
+        MemWrite( &item->zoneBegin.srcloc, deferred->srcloc );
+        tail.store( magic + 1, std::memory_order_release );
+    }
+#endif
+
 #ifdef TRACY_ON_DEMAND
     tracy_force_inline uint64_t ConnectionId() const
     {
@@ -744,6 +850,17 @@ private:
     void CompressWorker();
 #endif
 
+#ifdef TRACY_PARALLEL_COMPRESSION
+    static void LaunchDataCompressWorker( void* ptr ) { ((Profiler*)ptr)->DataCompressWorker(); }
+    void DataCompressWorker();
+    void CompressDataFrame( DataFrame& frame, void* state );
+    bool ClaimDataFrame( DataFrame& frame );
+    bool WaitDataFrame( DataFrame& frame );
+    bool QueueDataFrame();
+    bool SendDataFrames( bool wait );
+    void ResetDataFrames();
+#endif
+
 #ifdef TRACY_HAS_CALLSTACK
     static void LaunchSymbolWorker( void* ptr ) { ((Profiler*)ptr)->SymbolWorker(); }
     void SymbolWorker();
@@ -755,6 +872,12 @@ private:
     DequeueStatus Dequeue( tracy::moodycamel::ConsumerToken& token );
     DequeueStatus DequeueContextSwitches( tracy::moodycamel::ConsumerToken& token, int64_t& timeStop );
     DequeueStatus DequeueSerial();
+    bool StashMemEvent( const QueueItem& item );
+    bool SendMemEvents( uint32_t skipUntil );
+    bool SendMemEvent( MemEventSlot& slot, int64_t& refSerial );
+    bool StashSkippedMemEvent( const QueueItem& item, uint32_t seq );
+    bool MemQueuesEmpty();
+    void ClearMemEvents();
     ThreadCtxStatus ThreadCtxCheck( uint32_t threadId );
     bool CommitData();
 
@@ -771,7 +894,11 @@ private:
         bool ret = true;
         if( m_bufferOffset - m_bufferStart + (int)len > TargetFrameSize )
         {
+#ifdef TRACY_PARALLEL_COMPRESSION
+            ret = QueueDataFrame();
+#else
             ret = CommitData();
+#endif
         }
         return ret;
     }
@@ -788,6 +915,8 @@ private:
     void SendSourceLocationPayload( uint64_t ptr );
     void SendCallstackPayload( uint64_t ptr );
     void SendCallstackPayload64( uint64_t ptr );
+    bool SendCallstackCached( uint64_t ptr, uint64_t hash, bool wide, uint32_t& id );
+    void ClearCallstackCache();
     void SendCallstackAlloc( uint64_t ptr );
 
     void QueueCallstackFrame( uint64_t ptr );
@@ -822,48 +951,106 @@ private:
 #endif
     }
 
-    static tracy_force_inline void SendMemAlloc( QueueType type, const uint32_t thread, const void* ptr, size_t size )
+    // Memory events are posted to the per-thread queues. The sequence number
+    // allows the worker thread to restore the global order of allocations
+    // and frees, which is required to match them correctly on the server.
+    // Allocation hooks may still run on a thread after its queue token was
+    // destroyed. Such events go through the serial queue instead, without
+    // callstacks, and are reordered in the same way.
+    static tracy_force_inline void SendMemCallstack( void* ptr, uint32_t seq )
     {
-        assert( type == QueueType::MemAlloc || type == QueueType::MemAllocCallstack || type == QueueType::MemAllocNamed || type == QueueType::MemAllocCallstackNamed );
+        TracyLfqPrepare( QueueType::CallstackSerial );
+        MemWrite( &item->callstackFatSeq.ptr, (uint64_t)ptr );
+        MemWrite( &item->callstackFatSeq.seq, seq );
+        TracyLfqCommit;
+    }
 
-        auto item = GetProfiler().m_serialQueue.prepare_next();
-        MemWrite( &item->hdr.type, type );
-        MemWrite( &item->memAlloc.time, GetTime() );
-        MemWrite( &item->memAlloc.thread, thread );
-        MemWrite( &item->memAlloc.ptr, (uint64_t)ptr );
+    static tracy_force_inline void WriteMemAlloc( QueueItem* item, const uint32_t thread, const void* ptr, size_t size, uint32_t seq )
+    {
+        MemWrite( &item->memAllocSeq.time, GetTime() );
+        MemWrite( &item->memAllocSeq.thread, thread );
+        MemWrite( &item->memAllocSeq.ptr, (uint64_t)ptr );
         if( compile_time_condition<sizeof( size ) == 4>::value )
         {
-            memcpy( &item->memAlloc.size, &size, 4 );
-            memset( &item->memAlloc.size + 4, 0, 2 );
+            memcpy( &item->memAllocSeq.size, &size, 4 );
+            memset( &item->memAllocSeq.size + 4, 0, 2 );
         }
         else
         {
             assert( sizeof( size ) == 8 );
-            memcpy( &item->memAlloc.size, &size, 4 );
-            memcpy( ((char*)&item->memAlloc.size)+4, ((char*)&size)+4, 2 );
+            memcpy( &item->memAllocSeq.size, &size, 4 );
+            memcpy( ((char*)&item->memAllocSeq.size)+4, ((char*)&size)+4, 2 );
         }
-        GetProfiler().m_serialQueue.commit_next();
+        MemWrite( &item->memAllocSeq.seq, seq );
+    }
+
+    static tracy_force_inline void WriteMemFree( QueueItem* item, const uint32_t thread, const void* ptr, uint32_t seq )
+    {
+        MemWrite( &item->memFreeSeq.time, GetTime() );
+        MemWrite( &item->memFreeSeq.thread, thread );
+        MemWrite( &item->memFreeSeq.ptr, (uint64_t)ptr );
+        MemWrite( &item->memFreeSeq.seq, seq );
+    }
+
+    static tracy_force_inline void WriteMemName( QueueItem* item, const char* name, uint32_t seq )
+    {
+        MemWrite( &item->memNameSeq.name, (uint64_t)name );
+        MemWrite( &item->memNameSeq.seq, seq );
+    }
+
+    static tracy_force_inline void SendMemAlloc( QueueType type, const uint32_t thread, const void* ptr, size_t size, uint32_t seq )
+    {
+        assert( type == QueueType::MemAlloc || type == QueueType::MemAllocCallstack || type == QueueType::MemAllocNamed || type == QueueType::MemAllocCallstackNamed );
+
+        if( !ProfilerThreadQueueAvailable() )
+        {
+            auto item = QueueSerial();
+            MemWrite( &item->hdr.type, type );
+            WriteMemAlloc( item, thread, ptr, size, seq );
+            QueueSerialFinish();
+            return;
+        }
+        TracyLfqPrepare( type );
+        WriteMemAlloc( item, thread, ptr, size, seq );
+        TracyLfqCommit;
     }
 
-    static tracy_force_inline void SendMemFree( QueueType type, const uint32_t thread, const void* ptr )
+    static tracy_force_inline void SendMemFree( QueueType type, const uint32_t thread, const void* ptr, uint32_t seq )
     {
         assert( type == QueueType::MemFree || type == QueueType::MemFreeCallstack || type == QueueType::MemFreeNamed || type == QueueType::MemFreeCallstackNamed );
 
-        auto item = GetProfiler().m_serialQueue.prepare_next();
-        MemWrite( &item->hdr.type, type );
-        MemWrite( &item->memFree.time, GetTime() );
-        MemWrite( &item->memFree.thread, thread );
-        MemWrite( &item->memFree.ptr, (uint64_t)ptr );
-        GetProfiler().m_serialQueue.commit_next();
+        if( !ProfilerThreadQueueAvailable() )
+        {
+            auto item = QueueSerial();
+            MemWrite( &item->hdr.type, type );
+            WriteMemFree( item, thread, ptr, seq );
+            QueueSerialFinish();
+            return;
+        }
+        TracyLfqPrepare( type );
+        WriteMemFree( item, thread, ptr, seq );
+        TracyLfqCommit;
     }
 
-    static tracy_force_inline void SendMemName( const char* name )
+    static tracy_force_inline void SendMemName( const char* name, uint32_t seq )
     {
         assert( name );
-        auto item = GetProfiler().m_serialQueue.prepare_next();
-        MemWrite( &item->hdr.type, QueueType::MemNamePayload );
-        MemWrite( &item->memName.name, (uint64_t)name );
-        GetProfiler().m_serialQueue.commit_next();
+        if( !ProfilerThreadQueueAvailable() )
+        {
+            auto item = QueueSerial();
+            MemWrite( &item->hdr.type, QueueType::MemNamePayload );
+            WriteMemName( item, name, seq );
+            QueueSerialFinish();
+            return;
+        }
+        TracyLfqPrepare( QueueType::MemNamePayload );
+        WriteMemName( item, name, seq );
+        TracyLfqCommit;
+    }
+
+    tracy_force_inline uint32_t GetNextMemSeq()
+    {
+        return m_memSeq.fetch_add( 1, std::memory_order_relaxed );
     }
 
 #if defined _WIN32 && defined TRACY_TIMER_QPC
@@ -891,6 +1078,7 @@ private:
     int64_t m_refTimeSerial;
     int64_t m_refTimeCtx;
     int64_t m_refTimeGpu;
+    uint64_t m_refSrcLoc;
 
     void* m_stream;     // LZ4_stream_t*
     char* m_buffer;
@@ -898,10 +1086,38 @@ private:
     int m_bufferStart;
 
     char* m_lz4Buf;
+#ifdef TRACY_ZSTD_COMPRESSION
+    void* m_streamZstd; // ZSTD_CCtx*
+    int m_zstdLevel;
+#endif
+
+#ifdef TRACY_PARALLEL_COMPRESSION
+    DataFrame* m_dataFrames;
+    uint32_t m_dataFramesNum;
+    uint32_t m_dataFramesWrite;
+    uint32_t m_dataFramesSend;
+    uint32_t m_dataCompressThreads;
+    std::atomic<uint32_t> m_dataCompressId;
+    // Compression threads wait on m_dataFrameWorkCv for pending frames, the sender waits on
+    // m_dataFrameDoneCv for a frame to be compressed.
+    std::mutex m_dataFrameLock;
+    std::condition_variable m_dataFrameWorkCv;
+    std::condition_variable m_dataFrameDoneCv;
+#endif
 
     FastVector<QueueItem> m_serialQueue, m_serialDequeue;
     TracyMutex m_serialLock;
 
+    std::atomic<uint32_t> m_memSeq;
+    uint32_t m_memSeqNext;
+    uint32_t m_memSeqEnd;
+    int64_t m_memGapTime;
+    MemEventSlot* m_memSlots;
+    uint32_t m_memSlotsSize;
+    FastVector<MemSkippedSlot> m_memSkipped;
+    int64_t m_memTimeLast;
+    CallstackCacheEntry* m_callstackCache;
+
 #ifndef TRACY_NO_FRAME_IMAGE
     FastVector<FrameImageQueueItem> m_fiQueue, m_fiDequeue;
     TracyMutex m_fiLock;
@@ -918,6 +1134,17 @@ private:
     FastVector<QueueItem> m_deferredQueue;
 #endif
 
+#ifdef TRACY_QUEUE_BUDGET
+    void UpdateQueueBudget();
+    bool SendDroppedZones();
+
+    std::atomic<bool> m_throttle;
+    std::atomic<uint64_t> m_droppedZones;
+    int64_t m_droppedReportTime;
+    size_t m_queueBudget;
+    int64_t m_dropThreshold;
+#endif
+
 #ifdef TRACY_HAS_SYSTIME
     void ProcessSysTime();
 
@@ -31,6 +31,20 @@ public:
         if( !m_active ) return;
 #ifdef TRACY_ON_DEMAND
         m_connectionId = GetProfiler().ConnectionId();
+#endif
+#ifdef TRACY_QUEUE_BUDGET
+        if( GetProfiler().IsThrottled() )
+        {
+            // The enclosing zone may be deferred too. It has a child now, so it must be kept.
+            Profiler::SendDeferredZone();
+            m_deferred.time = Profiler::GetTime();
+            m_deferred.srcloc = (uint64_t)srcloc;
+#  ifdef TRACY_ON_DEMAND
+            m_deferred.connectionId = m_connectionId;
+#  endif
+            GetDeferredZone() = &m_deferred;
+            return;
+        }
 #endif
         TracyQueuePrepare( QueueType::ZoneBegin );
         MemWrite( &item->zoneBegin.time, Profiler::GetTime() );
@@ -98,6 +112,26 @@ public:
     tracy_force_inline ~ScopedZone()
     {
         if( !m_active ) return;
+#ifdef TRACY_QUEUE_BUDGET
+        if( GetDeferredZone() == &m_deferred )
+        {
+            const auto time = Profiler::GetTime();
+#  ifdef TRACY_ON_DEMAND
+            if( GetProfiler().ConnectionId() != m_connectionId || !GetProfiler().KeepDeferredZone( time ) )
+#  else
+            if( !GetProfiler().KeepDeferredZone( time ) )
+#  endif
+            {
+                GetDeferredZone() = nullptr;
+                return;
+            }
+            // Queueing the end sends the deferred begin first.
+            TracyQueuePrepare( QueueType::ZoneEnd );
+            MemWrite( &item->zoneEnd.time, time );
+            TracyQueueCommit( zoneEndThread );
+            return;
+        }
+#endif
 #ifdef TRACY_ON_DEMAND
         if( GetProfiler().ConnectionId() != m_connectionId ) return;
 #endif
@@ -168,6 +202,10 @@ private:
 #ifdef TRACY_ON_DEMAND
     uint64_t m_connectionId;
 #endif
+
+#ifdef TRACY_QUEUE_BUDGET
+    DeferredZone m_deferred;
+#endif
 };
 
 }
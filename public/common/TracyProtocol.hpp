@@ -9,7 +9,7 @@ namespace tracy
 
 constexpr unsigned Lz4CompressBound( unsigned isize ) { return isize + ( isize / 255 ) + 16; }
 
-enum : uint32_t { ProtocolVersion = 60 };
+enum : uint32_t { ProtocolVersion = 63 };
 enum : uint16_t { BroadcastVersion = 2 };
 
 using lz4sz_t = uint32_t;
@@ -19,6 +19,10 @@ enum { LZ4Size = Lz4CompressBound( TargetFrameSize ) };
 static_assert( LZ4Size <= std::numeric_limits<lz4sz_t>::max(), "LZ4Size greater than lz4sz_t" );
 static_assert( TargetFrameSize * 2 >= 64 * 1024, "Not enough space for LZ4 stream buffer" );
 
+// Number of slots in the client table of recently sent callstacks. A callstack payload carries its slot
+// index, and a repeated callstack is sent as the slot index alone.
+enum { CallstackCacheSize = 16 * 1024 };
+
 enum { HandshakeShibbolethSize = 8 };
 static const char HandshakeShibboleth[HandshakeShibbolethSize] = { 'T', 'r', 'a', 'c', 'y', 'P', 'r', 'f' };
 
@@ -83,11 +87,13 @@ struct WelcomeFlag
 {
     enum _t : uint8_t
     {
-        OnDemand        = 1 << 0,
-        IsApple         = 1 << 1,
-        CodeTransfer    = 1 << 2,
-        CombineSamples  = 1 << 3,
-        IdentifySamples = 1 << 4,
+        OnDemand          = 1 << 0,
+        IsApple           = 1 << 1,
+        CodeTransfer      = 1 << 2,
+        CombineSamples    = 1 << 3,
+        IdentifySamples   = 1 << 4,
+        IndependentFrames = 1 << 5,
+        ZstdFrames        = 1 << 6,
     };
 };
 
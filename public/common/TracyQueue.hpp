@@ -4,6 +4,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "TracyForceInline.hpp"
+
 namespace tracy
 {
 
@@ -64,6 +66,7 @@ enum class QueueType : uint8_t
     CodeInformation,
     ExternalNameMetadata,
     SymbolCodeMetadata,
+    ImageInfo,
     FiberEnter,
     FiberLeave,
     Terminate,
@@ -106,6 +109,7 @@ enum class QueueType : uint8_t
     SingleStringData,
     SecondStringData,
     MemNamePayload,
+    CallstackCached,
     StringData,
     ThreadName,
     PlotName,
@@ -468,6 +472,11 @@ struct QueueMemNamePayload
     uint64_t name;
 };
 
+struct QueueMemNamePayloadSeq : public QueueMemNamePayload
+{
+    uint32_t seq;
+};
+
 struct QueueMemAlloc
 {
     int64_t time;
@@ -483,16 +492,36 @@ struct QueueMemFree
     uint64_t ptr;
 };
 
+struct QueueMemAllocSeq : public QueueMemAlloc
+{
+    uint32_t seq;
+};
+
+struct QueueMemFreeSeq : public QueueMemFree
+{
+    uint32_t seq;
+};
+
 struct QueueCallstackFat
 {
     uint64_t ptr;
 };
 
+struct QueueCallstackFatSeq : public QueueCallstackFat
+{
+    uint32_t seq;
+};
+
 struct QueueCallstackFatThread : public QueueCallstackFat
 {
     uint32_t thread;
 };
 
+struct QueueCallstackCached
+{
+    uint32_t id;
+};
+
 struct QueueCallstackAllocFat
 {
     uint64_t ptr;
@@ -649,6 +678,17 @@ struct QueueSymbolCodeMetadata
     uint32_t size;
 };
 
+struct QueueImageInfo
+{
+    uint64_t base;
+};
+
+struct QueueImageInfoFat : public QueueImageInfo
+{
+    uint64_t path;
+    uint64_t buildId;
+};
+
 struct QueueHeader
 {
     union
@@ -714,10 +754,15 @@ struct QueueItem
         QueueGpuContextName gpuContextName;
         QueueGpuContextNameFat gpuContextNameFat;
         QueueMemAlloc memAlloc;
+        QueueMemAllocSeq memAllocSeq;
         QueueMemFree memFree;
+        QueueMemFreeSeq memFreeSeq;
         QueueMemNamePayload memName;
+        QueueMemNamePayloadSeq memNameSeq;
         QueueCallstackFat callstackFat;
+        QueueCallstackFatSeq callstackFatSeq;
         QueueCallstackFatThread callstackFatThread;
+        QueueCallstackCached callstackCached;
         QueueCallstackAllocFat callstackAllocFat;
         QueueCallstackAllocFatThread callstackAllocFatThread;
         QueueCallstackSample callstackSample;
@@ -741,6 +786,8 @@ struct QueueItem
         QueueCpuTopology cpuTopology;
         QueueExternalNameMetadata externalNameMetadata;
         QueueSymbolCodeMetadata symbolCodeMetadata;
+        QueueImageInfo imageInfo;
+        QueueImageInfoFat imageInfoFat;
         QueueFiberEnter fiberEnter;
         QueueFiberLeave fiberLeave;
     };
@@ -806,6 +853,7 @@ static constexpr size_t QueueDataSize[] = {
     sizeof( QueueHeader ) + sizeof( QueueCodeInformation ),
     sizeof( QueueHeader ),                                  // ExternalNameMetadata - not for wire transfer
     sizeof( QueueHeader ),                                  // SymbolCodeMetadata - not for wire transfer
+    sizeof( QueueHeader ) + sizeof( QueueImageInfo ),
     sizeof( QueueHeader ) + sizeof( QueueFiberEnter ),
     sizeof( QueueHeader ) + sizeof( QueueFiberLeave ),
     // above items must be first
@@ -849,6 +897,7 @@ static constexpr size_t QueueDataSize[] = {
     sizeof( QueueHeader ),                                  // single string data
     sizeof( QueueHeader ),                                  // second string data
     sizeof( QueueHeader ) + sizeof( QueueMemNamePayload ),
+    sizeof( QueueHeader ) + sizeof( QueueCallstackCached ),
     // keep all QueueStringTransfer below
     sizeof( QueueHeader ) + sizeof( QueueStringTransfer ),  // string data
     sizeof( QueueHeader ) + sizeof( QueueStringTransfer ),  // thread name
@@ -870,6 +919,54 @@ static_assert( sizeof( QueueDataSize ) / sizeof( size_t ) == (uint8_t)QueueType:
 static_assert( sizeof( void* ) <= sizeof( uint64_t ), "Pointer size > 8 bytes" );
 static_assert( sizeof( void* ) == sizeof( uintptr_t ), "Pointer size != uintptr_t" );
 
+
+// Zone begin, zone end and thread context events are the bulk of the data stream. On the wire they are
+// not sent with their QueueDataSize[] size, but as the header followed by variable-length integers:
+//   ZoneBegin, ZoneBeginCallstack:    time delta, source location delta (both zigzag)
+//   ZoneBeginAllocSrcLoc(Callstack):  time delta (zigzag)
+//   ZoneEnd:                          time delta (zigzag)
+//   ThreadContext:                    thread id
+// The source location delta is relative to the previous compact zone begin in the stream.
+enum { VarIntMaxSize = 10 };
+enum { QueueCompactMaxSize = sizeof( QueueHeader ) + VarIntMaxSize * 2 };
+
+static tracy_force_inline uint64_t ZigZagEncode( int64_t val )
+{
+    return ( uint64_t( val ) << 1 ) ^ uint64_t( val >> 63 );
+}
+
+static tracy_force_inline int64_t ZigZagDecode( uint64_t val )
+{
+    return int64_t( val >> 1 ) ^ -int64_t( val & 1 );
+}
+
+static tracy_force_inline char* WriteVarInt( char* dst, uint64_t val )
+{
+    while( val >= 0x80 )
+    {
+        *dst++ = char( val | 0x80 );
+        val >>= 7;
+    }
+    *dst++ = char( val );
+    return dst;
+}
+
+static tracy_force_inline const char* ReadVarInt( const char* src, uint64_t& val )
+{
+    uint64_t ret = 0;
+    int shift = 0;
+    uint8_t byte;
+    do
+    {
+        byte = uint8_t( *src++ );
+        ret |= uint64_t( byte & 0x7F ) << shift;
+        shift += 7;
+    }
+    while( byte & 0x80 );
+    val = ret;
+    return src;
+}
+
 }
 
 #endif
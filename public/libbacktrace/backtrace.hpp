@@ -87,6 +87,18 @@ extern struct backtrace_state *backtrace_create_state (
     const char *filename, int threaded,
     backtrace_error_callback error_callback, void *data);
 
+/* Tracy addition.  Load the symbols and debug info of the ELF file
+   FILENAME into STATE, which must be newly created and not threaded.
+   Unlike the default initialization, the running program is not
+   examined, so that STATE can be used to look up addresses relative
+   to FILENAME, e.g. in a copy of a binary from another machine.  This
+   returns 1 on success, 0 on error.  */
+
+extern int backtrace_initialize_file (struct backtrace_state *state,
+				      const char *filename,
+				      backtrace_error_callback error_callback,
+				      void *data);
+
 /* The type of the callback argument to the backtrace_full function.
    DATA is the argument passed to backtrace_full.  PC is the program
    counter.  FILENAME is the name of the file containing PC, or NULL
@@ -4969,4 +4969,37 @@ backtrace_initialize (struct backtrace_state *state, const char *filename,
   return 1;
 }
 
+/* Initialize STATE with the data of the single ELF file FILENAME,
+   which is not necessarily loaded in the current process.  The
+   process itself is not examined.  Addresses are the ones in the ELF
+   file, not adjusted by any load address.  Returns 1 on success, 0 on
+   failure.  */
+
+int
+backtrace_initialize_file (struct backtrace_state *state,
+			   const char *filename,
+			   backtrace_error_callback error_callback,
+			   void *data)
+{
+  int descriptor;
+  int does_not_exist;
+  int found_sym;
+  int found_dwarf;
+  fileline elf_fileline_fn = elf_nodebug;
+
+  descriptor = backtrace_open (filename, error_callback, data,
+			       &does_not_exist);
+  if (descriptor < 0)
+    return 0;
+
+  if (!elf_add (state, filename, descriptor, NULL, 0, 0, error_callback,
+		data, &elf_fileline_fn, &found_sym, &found_dwarf, NULL, 0, 0,
+		NULL, 0))
+    return 0;
+
+  state->syminfo_fn = found_sym ? elf_syminfo : elf_nosyms;
+  state->fileline_fn = found_dwarf ? elf_fileline_fn : elf_nodebug;
+  return 1;
+}
+
 }
@@ -368,6 +368,7 @@ struct LockMap
     StringIdx customName;
     int16_t srcloc;
     Vector<LockEventPtr> timeline;
+    std::vector<Vector<uint32_t>> threadEvents;     // per-thread indices into timeline
     unordered_flat_map<uint64_t, uint8_t> threadMap;
     std::vector<uint64_t> threadList;
     LockType type;
@@ -494,6 +495,17 @@ struct CallstackFrameData
 enum { CallstackFrameDataSize = sizeof( CallstackFrameData ) };
 
 
+// Image loaded in the profiled program, for the offline symbol resolution.
+struct ImageData
+{
+    uint64_t base;
+    StringIdx path;
+    StringIdx buildId;
+};
+
+enum { ImageDataSize = sizeof( ImageData ) };
+
+
 struct MemCallstackFrameTree
 {
     MemCallstackFrameTree( CallstackFrameId id ) : frame( id ), alloc( 0 ), count( 0 ) {}
@@ -736,6 +748,19 @@ enum class PlotValueFormatting : uint8_t
     Percentage
 };
 
+// Level of detail summary of plot values. Each item at level 0 covers PlotLodSize consecutive
+// data points, and each item at level N covers PlotLodSize items of level N-1.
+struct PlotLod
+{
+    double min;
+    double max;
+    double sum;
+};
+
+enum { PlotLodShift = 5 };
+enum { PlotLodSize = 1 << PlotLodShift };
+enum { PlotLodLevels = 7 };
+
 struct PlotData
 {
     struct PlotItemSort { bool operator()( const PlotItem& lhs, const PlotItem& rhs ) { return lhs.time.Val() < rhs.time.Val(); }; };
@@ -750,8 +775,18 @@ struct PlotData
     uint8_t showSteps;
     uint8_t fill;
     uint32_t color;
+
+    Vector<PlotLod> lod[PlotLodLevels];
+    int64_t lodInvalid = std::numeric_limits<int64_t>::max();   // lod must be rebuilt from this time on
 };
 
+// Free time index of memory events. Each item at level 0 covers MemIndexSize consecutive
+// allocations and holds the latest free time among them, or int64 max if any of them is still
+// active. Each item at level N covers MemIndexSize items of level N-1.
+enum { MemIndexShift = 6 };
+enum { MemIndexSize = 1 << MemIndexShift };
+enum { MemIndexLevels = 4 };
+
 struct MemData
 {
     Vector<MemEvent> data;
@@ -763,6 +798,10 @@ struct MemData
     PlotData* plot = nullptr;
     bool reconstruct = false;
     uint64_t name = 0;
+
+    Vector<int64_t> freeIdx[MemIndexLevels];
+    Vector<int64_t> freeMax;        // latest free time in each level 0 item, active allocations excluded
+    Vector<uint8_t> activeCnt;      // number of active allocations in each level 0 item
 };
 
 struct FrameData
@@ -174,6 +174,10 @@ void EventDebug( const QueueItem& ev )
     case QueueType::CodeInformation:
         fprintf( f, "ev %i (CodeInformation)\n", ev.hdr.idx );
         break;
+    case QueueType::ImageInfo:
+        fprintf( f, "ev %i (ImageInfo)\n", ev.hdr.idx );
+        fprintf( f, "\tbase = 0x%" PRIx64 "\n", ev.imageInfo.base );
+        break;
     case QueueType::FiberEnter:
         fprintf( f, "ev %i (FiberEnter)\n", ev.hdr.idx );
         fprintf( f, "\ttime   = %" PRIi64 "\n", ev.fiberEnter.time );
@@ -309,6 +313,10 @@ void EventDebug( const QueueItem& ev )
     case QueueType::MemNamePayload:
         fprintf( f, "ev %i (MemNamePayload)\n", ev.hdr.idx );
         break;
+    case QueueType::CallstackCached:
+        fprintf( f, "ev %i (CallstackCached)\n", ev.hdr.idx );
+        fprintf( f, "\tid = %" PRIu32 "\n", ev.callstackCached.id );
+        break;
     case QueueType::StringData:
         fprintf( f, "ev %i (StringData)\n", ev.hdr.idx );
         break;
@@ -11,6 +11,47 @@ namespace tracy
 static const char Lz4Header[4]  = { 't', 'l', 'Z', 4 };
 static const char ZstdHeader[4] = { 't', 'Z', 's', 't' };
 
+// Block container. The header is followed by a compression type byte and by independently compressed
+// blocks, each prefixed with its size. All blocks, except the last one, hold FileBlockSize bytes of data.
+// The block index is placed after the last block and the file ends with the index offset:
+//   uint64_t blockCount, uint64_t dataSize, uint64_t blockOffset[blockCount],
+//   uint64_t sectionCount, { uint64_t section, uint64_t begin, uint64_t end }[sectionCount], uint64_t indexOffset
+// Section boundaries are offsets in the uncompressed data. They allow skipping whole blocks of data which
+// won't be loaded. Blocks stored with no compression are parsed directly from the memory mapped file,
+// without an intermediate copy. The parsed data is always stored in the worker's own memory.
+// The container has its own magic, so that readers which only know the streamed formats reject it.
+static const char BlockHeader[4] = { 't', 'B', 'l', 'k' };
+
+enum { FileBlockSize = 64 * 1024 };
+
+// Raw capture. The header is followed by uint32_t protocol version, the client WelcomeMessage and,
+// for on-demand clients, the OnDemandPayloadMessage. The rest of the file is the compressed data
+// stream exactly as it was received, each frame prefixed with its lz4sz_t size.
+static const char RawCaptureHeader[4] = { 't', 'r', 'R', 'w' };
+
+enum class FileBlockCompression : uint8_t
+{
+    Lz4,
+    Zstd,
+    None
+};
+
+enum class FileSection : uint8_t
+{
+    Locks,
+    Messages,
+    Plots,
+    Memory,
+    FrameImages,
+    ContextSwitches,
+    ContextSwitchesPerCpu,
+    SymbolCode,
+    CodeLocations,
+    SourceCache,
+    Statistics,     // optional, derived data which otherwise is reconstructed after load
+    Images          // optional, images of clients which leave symbol resolution to the update utility
+};
+
 static constexpr tracy_force_inline int FileVersion( uint8_t h5, uint8_t h6, uint8_t h7 )
 {
     return ( h5 << 16 ) | ( h6 << 8 ) | h7;
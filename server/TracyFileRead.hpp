@@ -4,12 +4,15 @@
 #include <assert.h>
 #include <atomic>
 #include <algorithm>
+#include <condition_variable>
+#include <mutex>
 #include <stdexcept>
 #include <stdio.h>
 #include <string.h>
 #include <string>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include <sys/stat.h>
 
@@ -22,7 +25,6 @@
 
 #include "TracyFileHeader.hpp"
 #include "TracyMmap.hpp"
-#include "../public/common/TracyYield.hpp"
 #include "../public/common/tracy_lz4.hpp"
 #include "../public/common/TracyForceInline.hpp"
 #include "../zstd/zstd.h"
@@ -44,12 +46,19 @@ public:
 
     ~FileRead()
     {
-        m_exit.store( true, std::memory_order_relaxed );
-        m_decThread.join();
+        {
+            std::lock_guard<std::mutex> lock( m_lock );
+            m_exit = true;
+        }
+        m_cvWork.notify_all();
+        if( m_decThread.joinable() ) m_decThread.join();
+        for( auto& t : m_blockThreads ) t.join();
+        for( auto& slot : m_blockSlots ) delete[] slot.buf;
 
         if( m_data ) munmap( m_data, m_dataSize );
         if( m_stream ) LZ4_freeStreamDecode( m_stream );
         if( m_streamZstd ) ZSTD_freeDStream( m_streamZstd );
+        if( m_blockCtx ) ZSTD_freeDCtx( m_blockCtx );
     }
 
     tracy_force_inline void Read( void* ptr, size_t size )
@@ -328,6 +337,40 @@ public:
 
     const std::string& GetFilename() const { return m_filename; }
 
+    // Excluded sections are not decompressed at all, if the file has a section index. Must be called
+    // before anything is read.
+    void ExcludeSection( FileSection section )
+    {
+        assert( m_blockSchedule.empty() );
+        m_sectionExclude |= 1u << uint32_t( section );
+    }
+
+    // Only files with a section index can report optional sections.
+    bool HasSection( FileSection section ) const
+    {
+        for( auto& v : m_sections )
+        {
+            if( v.section == uint64_t( section ) ) return true;
+        }
+        return false;
+    }
+
+    // Returns false if the section can't be skipped by seeking, and it has to be read through instead.
+    bool SkipSection( FileSection section )
+    {
+        if( ( m_sectionExclude & ( 1u << uint32_t( section ) ) ) == 0 ) return false;
+        for( auto& v : m_sections )
+        {
+            if( v.section == uint64_t( section ) )
+            {
+                assert( m_blockSchedule[m_block] * BufSize + m_offset == v.begin );
+                Seek( v.end );
+                return true;
+            }
+        }
+        return false;
+    }
+
 private:
     FileRead( FILE* f, const char* fn )
         : m_stream( nullptr )
@@ -337,6 +380,11 @@ private:
         , m_second( m_bufData[0] )
         , m_offset( 0 )
         , m_lastBlock( 0 )
+        , m_block( 0 )
+        , m_blockCount( 0 )
+        , m_blockNext( 0 )
+        , m_blockCtx( nullptr )
+        , m_sectionExclude( 0 )
         , m_signalSwitch( false )
         , m_signalAvailable( false )
         , m_exit( false )
@@ -348,7 +396,12 @@ private:
             fclose( f );
             throw NotTracyDump();
         }
-        if( memcmp( hdr, Lz4Header, sizeof( hdr ) ) == 0 )
+        bool blocks = false;
+        if( memcmp( hdr, BlockHeader, sizeof( hdr ) ) == 0 )
+        {
+            blocks = true;
+        }
+        else if( memcmp( hdr, Lz4Header, sizeof( hdr ) ) == 0 )
         {
             m_stream = LZ4_createStreamDecode();
         }
@@ -381,9 +434,247 @@ private:
         }
         m_dataOffset = sizeof( hdr );
 
-        ReadBlock( ReadBlockSize() );
-        std::swap( m_buf, m_second );
-        m_decThread = std::thread( [this] { Worker(); } );
+        if( blocks )
+        {
+            try
+            {
+                OpenBlocks();
+            }
+            catch( ... )
+            {
+                munmap( m_data, m_dataSize );
+                throw;
+            }
+        }
+        else
+        {
+            ReadBlock( ReadBlockSize() );
+            std::swap( m_buf, m_second );
+            m_decThread = std::thread( [this] { Worker(); } );
+        }
+    }
+
+    void OpenBlocks()
+    {
+        uint64_t indexOffset;
+        const auto dataBegin = sizeof( BlockHeader ) + sizeof( FileBlockCompression );
+        if( m_dataSize < dataBegin + sizeof( uint64_t ) * 3 ) throw NotTracyDump();
+        memcpy( &m_compression, m_data + m_dataOffset, sizeof( m_compression ) );
+        if( m_compression > FileBlockCompression::None ) throw NotTracyDump();
+        memcpy( &indexOffset, m_data + m_dataSize - sizeof( indexOffset ), sizeof( indexOffset ) );
+        if( indexOffset < dataBegin || indexOffset > m_dataSize - sizeof( uint64_t ) * 3 ) throw NotTracyDump();
+        memcpy( &m_blockCount, m_data + indexOffset, sizeof( m_blockCount ) );
+        if( m_blockCount == 0 || m_blockCount > ( m_dataSize - indexOffset - sizeof( uint64_t ) * 3 ) / sizeof( uint64_t ) ) throw NotTracyDump();
+        m_blockOffset.resize( m_blockCount );
+        memcpy( m_blockOffset.data(), m_data + indexOffset + sizeof( uint64_t ) * 2, sizeof( uint64_t ) * m_blockCount );
+
+        // Blocks are stored back to back, and each one must fit within the space up to the next one.
+        // Uncompressed blocks are read in place, so they must be complete.
+        uint64_t expected = dataBegin;
+        for( uint64_t i=0; i<m_blockCount; i++ )
+        {
+            const auto offset = m_blockOffset[i];
+            if( offset != expected || offset + sizeof( uint32_t ) > indexOffset ) throw NotTracyDump();
+            uint32_t sz;
+            memcpy( &sz, m_data + offset, sizeof( sz ) );
+            if( sz == 0 || sz > indexOffset - offset - sizeof( uint32_t ) ) throw NotTracyDump();
+            if( m_compression == FileBlockCompression::None && ( sz > BufSize || ( sz != BufSize && i != m_blockCount - 1 ) ) ) throw NotTracyDump();
+            expected = offset + sizeof( uint32_t ) + sz;
+        }
+        if( expected != indexOffset ) throw NotTracyDump();
+
+        const auto sectionOffset = indexOffset + sizeof( uint64_t ) * ( 2 + m_blockCount );
+        if( sectionOffset + sizeof( uint64_t ) * 2 <= m_dataSize )
+        {
+            uint64_t sectionCount;
+            memcpy( &sectionCount, m_data + sectionOffset, sizeof( sectionCount ) );
+            if( sectionCount > ( m_dataSize - sectionOffset - sizeof( uint64_t ) * 2 ) / sizeof( Section ) ) throw NotTracyDump();
+            m_sections.resize( sectionCount );
+            memcpy( m_sections.data(), m_data + sectionOffset + sizeof( uint64_t ), sizeof( Section ) * sectionCount );
+        }
+
+        // Decompression is started on the first read, after the excluded sections are known.
+        m_offset = BufSize;
+    }
+
+    void StartBlocks()
+    {
+        for( uint64_t i=0; i<m_blockCount; i++ )
+        {
+            const auto begin = i * BufSize;
+            const auto end = begin + BufSize;
+            bool skip = false;
+            for( auto& v : m_sections )
+            {
+                if( ( m_sectionExclude & ( 1u << uint32_t( v.section ) ) ) != 0 && v.begin <= begin && end <= v.end )
+                {
+                    skip = true;
+                    break;
+                }
+            }
+            if( !skip ) m_blockSchedule.push_back( i );
+        }
+
+        // Uncompressed blocks are read in place from the mapped file.
+        if( m_compression == FileBlockCompression::None )
+        {
+            WaitBlock();
+            return;
+        }
+
+        // With no spare core, handing blocks over between threads costs more than decompression itself.
+        const auto cores = std::thread::hardware_concurrency();
+        if( cores <= 1 )
+        {
+            if( m_compression == FileBlockCompression::Zstd ) m_blockCtx = ZSTD_createDCtx();
+            WaitBlock();
+            return;
+        }
+
+        // Blocks are compressed independently, so they can be decompressed ahead of the reader on all
+        // available cores. Each slot holds one block and is reused once the reader moves past it.
+        const auto threads = std::min<size_t>( cores - 1, std::min<uint64_t>( m_blockSchedule.size(), 16 ) );
+        m_blockSlots = std::vector<BlockSlot>( threads * 2 );
+        for( size_t i=0; i<m_blockSlots.size(); i++ )
+        {
+            m_blockSlots[i].buf = new char[BufSize];
+            m_blockSlots[i].state = i * 2;
+        }
+        for( size_t i=0; i<threads; i++ )
+        {
+            m_blockThreads.emplace_back( [this] { BlockWorker(); } );
+        }
+        WaitBlock();
+    }
+
+    void BlockWorker()
+    {
+        ZSTD_DCtx* ctx = m_compression == FileBlockCompression::Zstd ? ZSTD_createDCtx() : nullptr;
+        for(;;)
+        {
+            const auto idx = m_blockNext.fetch_add( 1, std::memory_order_relaxed );
+            if( idx >= m_blockSchedule.size() ) break;
+            const auto block = m_blockSchedule[idx];
+            auto& slot = m_blockSlots[idx % m_blockSlots.size()];
+            {
+                std::unique_lock<std::mutex> lock( m_lock );
+                m_cvWork.wait( lock, [&] { return slot.state == idx * 2 || m_exit; } );
+                if( m_exit ) break;
+            }
+            DecompressBlock( ctx, block, slot.buf );
+            {
+                std::lock_guard<std::mutex> lock( m_lock );
+                slot.state = idx * 2 + 1;
+            }
+            m_cvReady.notify_one();
+        }
+        if( ctx ) ZSTD_freeDCtx( ctx );
+    }
+
+    void DecompressBlock( ZSTD_DCtx* ctx, uint64_t block, char* dst )
+    {
+        uint32_t sz;
+        const auto src = m_data + m_blockOffset[block];
+        memcpy( &sz, src, sizeof( sz ) );
+        if( ctx )
+        {
+            const auto ret = ZSTD_decompressDCtx( ctx, dst, BufSize, src + sizeof( sz ), sz );
+            assert( !ZSTD_isError( ret ) );
+        }
+        else
+        {
+            const auto ret = LZ4_decompress_safe( src + sizeof( sz ), dst, sz, BufSize );
+            assert( ret >= 0 );
+        }
+    }
+
+    void WaitBlock()
+    {
+        if( m_compression == FileBlockCompression::None )
+        {
+            const auto src = m_data + m_blockOffset[m_blockSchedule[m_block]];
+            uint32_t sz;
+            memcpy( &sz, src, sizeof( sz ) );
+            if( sz == BufSize )
+            {
+                m_buf = src + sizeof( sz );
+            }
+            else
+            {
+                // The last block is shorter, and it may be too close to the end of the mapping.
+                m_buf = m_bufData[0];
+                memcpy( m_buf, src + sizeof( sz ), sz );
+            }
+            m_offset = 0;
+            return;
+        }
+        if( m_blockSlots.empty() )
+        {
+            m_buf = m_bufData[0];
+            DecompressBlock( m_blockCtx, m_blockSchedule[m_block], m_buf );
+            m_offset = 0;
+            return;
+        }
+        auto& slot = m_blockSlots[m_block % m_blockSlots.size()];
+        {
+            std::unique_lock<std::mutex> lock( m_lock );
+            m_cvReady.wait( lock, [&] { return slot.state == m_block * 2 + 1; } );
+        }
+        m_buf = slot.buf;
+        m_offset = 0;
+    }
+
+    void NextBlock()
+    {
+        if( m_blockCount == 0 )
+        {
+            std::unique_lock<std::mutex> lock( m_lock );
+            m_signalSwitch = true;
+            m_cvWork.notify_one();
+            m_cvReady.wait( lock, [this] { return m_signalAvailable; } );
+            m_signalAvailable = false;
+            assert( m_offset == 0 );
+        }
+        else if( m_blockSchedule.empty() )
+        {
+            StartBlocks();
+        }
+        else
+        {
+            assert( m_block + 1 < m_blockSchedule.size() && m_blockSchedule[m_block+1] == m_blockSchedule[m_block] + 1 );
+            ReleaseBlock();
+        }
+    }
+
+    void ReleaseBlock()
+    {
+        if( !m_blockSlots.empty() )
+        {
+            {
+                std::lock_guard<std::mutex> lock( m_lock );
+                m_blockSlots[m_block % m_blockSlots.size()].state = ( m_block + m_blockSlots.size() ) * 2;
+            }
+            m_cvWork.notify_all();
+        }
+        m_block++;
+        WaitBlock();
+    }
+
+    // Moves to an uncompressed data offset. Blocks in between are dropped, if they were scheduled at all.
+    void Seek( uint64_t pos )
+    {
+        const auto block = pos / BufSize;
+        while( m_blockSchedule[m_block] < block && m_block + 1 < m_blockSchedule.size() ) ReleaseBlock();
+        if( m_blockSchedule[m_block] == block )
+        {
+            m_offset = pos - block * BufSize;
+        }
+        else
+        {
+            // Seek to the end of data.
+            assert( pos == ( m_blockSchedule[m_block] + 1 ) * BufSize );
+            m_offset = BufSize;
+        }
     }
 
     tracy_force_inline uint32_t ReadBlockSize()
@@ -401,16 +692,16 @@ private:
         {
             ReadBlock( blockSz );
             if( m_lastBlock == BufSize ) blockSz = ReadBlockSize();
-            for(;;)
             {
-                if( m_exit.load( std::memory_order_relaxed ) == true ) return;
-                if( m_signalSwitch.load( std::memory_order_relaxed ) == true ) break;
-                YieldThread();
+                std::unique_lock<std::mutex> lock( m_lock );
+                m_cvWork.wait( lock, [this] { return m_signalSwitch || m_exit; } );
+                if( m_exit ) return;
+                m_signalSwitch = false;
+                std::swap( m_buf, m_second );
+                m_offset = 0;
+                m_signalAvailable = true;
             }
-            m_signalSwitch.store( false, std::memory_order_relaxed );
-            std::swap( m_buf, m_second );
-            m_offset = 0;
-            m_signalAvailable.store( true, std::memory_order_release );
+            m_cvReady.notify_one();
             if( m_lastBlock != BufSize ) return;
         }
     }
@@ -432,10 +723,7 @@ private:
             {
                 sz = std::min<size_t>( size, BufSize );
 
-                m_signalSwitch.store( true, std::memory_order_relaxed );
-                while( m_signalAvailable.load( std::memory_order_acquire ) == false ) { YieldThread(); }
-                m_signalAvailable.store( false, std::memory_order_relaxed );
-                assert( m_offset == 0 );
+                NextBlock();
 
                 memcpy( dst, m_buf, sz );
                 m_offset = sz;
@@ -459,9 +747,7 @@ private:
         {
             if( m_offset == BufSize )
             {
-                m_signalSwitch.store( true, std::memory_order_relaxed );
-                while( m_signalAvailable.load( std::memory_order_acquire ) == false ) { YieldThread(); }
-                m_signalAvailable.store( false, std::memory_order_relaxed );
+                NextBlock();
             }
 
             const auto sz = std::min( size, BufSize - m_offset );
@@ -488,7 +774,22 @@ private:
         }
     }
 
-    enum { BufSize = 64 * 1024 };
+    struct Section
+    {
+        uint64_t section;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    struct BlockSlot
+    {
+        char* buf;
+        uint64_t state;     // block * 2 when free for block, block * 2 + 1 when block is ready, guarded by m_lock
+
+        BlockSlot() : buf( nullptr ), state( 0 ) {}
+    };
+
+    enum { BufSize = FileBlockSize };
     enum { LZ4Size = std::max( LZ4_COMPRESSBOUND( BufSize ), ZSTD_COMPRESSBOUND( BufSize ) ) };
 
     LZ4_streamDecode_t* m_stream;
@@ -501,9 +802,26 @@ private:
     size_t m_offset;
     size_t m_lastBlock;
 
-    alignas(64) std::atomic<bool> m_signalSwitch;
-    alignas(64) std::atomic<bool> m_signalAvailable;
-    alignas(64) std::atomic<bool> m_exit;
+    FileBlockCompression m_compression;
+    uint64_t m_block;
+    uint64_t m_blockCount;
+    std::vector<uint64_t> m_blockOffset;
+    std::vector<uint64_t> m_blockSchedule;
+    std::vector<BlockSlot> m_blockSlots;
+    std::vector<std::thread> m_blockThreads;
+    alignas(64) std::atomic<uint64_t> m_blockNext;
+    ZSTD_DCtx* m_blockCtx;
+    std::vector<Section> m_sections;
+    uint32_t m_sectionExclude;
+
+    // Guards the slot states and the signals below. Decompression threads wait on m_cvWork, the reader
+    // waits on m_cvReady.
+    std::mutex m_lock;
+    std::condition_variable m_cvWork;
+    std::condition_variable m_cvReady;
+    bool m_signalSwitch;
+    bool m_signalAvailable;
+    bool m_exit;
 
     std::thread m_decThread;
 
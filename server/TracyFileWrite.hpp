@@ -7,9 +7,14 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <stdio.h>
 #include <string.h>
+#include <thread>
 #include <utility>
+#include <vector>
 
 #include "TracyFileHeader.hpp"
 #include "../public/common/tracy_lz4.hpp"
@@ -28,32 +33,53 @@ public:
         Fast,
         Slow,
         Extreme,
-        Zstd
+        Zstd,
+        None
     };
 
-    static FileWrite* Open( const char* fn, Compression comp = Compression::Fast, int level = 1 )
+    static FileWrite* Open( const char* fn, Compression comp = Compression::Fast, int level = 1, int threads = 1 )
     {
         auto f = fopen( fn, "wb" );
-        return f ? new FileWrite( f, comp, level ) : nullptr;
+        return f ? new FileWrite( f, comp, level, threads ) : nullptr;
     }
 
     ~FileWrite()
     {
-        if( m_offset > 0 ) WriteLz4Block();
+        Finish();
         fclose( m_file );
 
-        if( m_stream ) LZ4_freeStream( m_stream );
-        if( m_streamHC ) LZ4_freeStreamHC( m_streamHC );
-        if( m_streamZstd ) ZSTD_freeCStream( m_streamZstd );
+        for( auto& slot : m_slots )
+        {
+            delete[] slot.buf;
+            delete[] slot.lz4;
+        }
+        FreeContext( m_ctx );
     }
 
-    void Finish()
+    // Returns false if a block could not be compressed. The file is not usable then.
+    bool Finish()
     {
-        if( m_offset > 0 ) WriteLz4Block();
+        if( m_finished ) return !m_failed;
+        if( m_offset > 0 ) WriteBlock();
+        if( !m_threads.empty() )
+        {
+            while( m_blockWrite != m_block ) WriteSlot();
+            {
+                std::lock_guard<std::mutex> lock( m_lock );
+                m_exit = true;
+            }
+            m_cvWork.notify_all();
+            for( auto& t : m_threads ) t.join();
+            m_threads.clear();
+        }
+        if( !m_failed ) WriteIndex();
+        m_finished = true;
+        return !m_failed;
     }
 
     tracy_force_inline void Write( const void* ptr, size_t size )
     {
+        assert( !m_finished );
         if( m_offset + size <= BufSize )
         {
             WriteSmall( ptr, size );
@@ -66,50 +92,188 @@ public:
 
     std::pair<size_t, size_t> GetCompressionStatistics() const { return std::make_pair( m_srcBytes, m_dstBytes ); }
 
+    void BeginSection( FileSection section )
+    {
+        m_sections.push_back( Section { uint64_t( section ), GetPosition(), 0 } );
+    }
+
+    void EndSection()
+    {
+        assert( !m_sections.empty() && m_sections.back().end == 0 );
+        m_sections.back().end = GetPosition();
+    }
+
 private:
-    FileWrite( FILE* f, Compression comp, int level )
-        : m_stream( nullptr )
-        , m_streamHC( nullptr )
-        , m_streamZstd( nullptr )
+    struct Section
+    {
+        uint64_t section;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    struct Context
+    {
+        LZ4_stream_t* stream;
+        LZ4_streamHC_t* streamHC;
+        ZSTD_CStream* streamZstd;
+    };
+
+    struct Slot
+    {
+        char* buf;
+        char* lz4;
+        size_t size;
+        uint32_t lz4sz;
+        uint64_t state;     // see SlotState, guarded by m_lock
+
+        Slot() : buf( nullptr ), lz4( nullptr ), size( 0 ), lz4sz( 0 ), state( 0 ) {}
+    };
+
+    // Slot state for a given block number. Blocks are assigned to slots round robin.
+    enum SlotState { Free, Pending, Done };
+    static tracy_force_inline uint64_t SlotValue( uint64_t block, SlotState state ) { return block * 3 + state; }
+
+    FileWrite( FILE* f, Compression comp, int level, int threads )
+        : m_comp( comp )
+        , m_level( level )
         , m_file( f )
-        , m_buf( m_bufData[0] )
-        , m_second( m_bufData[1] )
+        , m_buf( m_bufData )
         , m_offset( 0 )
+        , m_fileOffset( 0 )
+        , m_dataOffset( 0 )
         , m_srcBytes( 0 )
         , m_dstBytes( 0 )
+        , m_finished( false )
+        , m_failed( false )
+        , m_block( 0 )
+        , m_blockWrite( 0 )
+        , m_blockNext( 0 )
+        , m_exit( false )
     {
+        m_ctx = CreateContext();
+
+        FileBlockCompression type;
         switch( comp )
         {
+        case Compression::Zstd:
+            type = FileBlockCompression::Zstd;
+            break;
+        case Compression::None:
+            type = FileBlockCompression::None;
+            break;
+        default:
+            type = FileBlockCompression::Lz4;
+            break;
+        }
+        fwrite( BlockHeader, 1, sizeof( BlockHeader ), m_file );
+        fwrite( &type, 1, sizeof( type ), m_file );
+        m_fileOffset = sizeof( BlockHeader ) + sizeof( type );
+
+        if( threads > 1 && comp != Compression::None )
+        {
+            // Two slots per thread bound the memory in flight, while keeping all threads busy when the
+            // writer waits for the oldest block.
+            m_slots = std::vector<Slot>( threads * 2 );
+            for( size_t i=0; i<m_slots.size(); i++ )
+            {
+                m_slots[i].buf = new char[BufSize];
+                m_slots[i].lz4 = new char[LZ4Size];
+                m_slots[i].state = SlotValue( i, Free );
+            }
+            for( int i=0; i<threads; i++ )
+            {
+                m_threads.emplace_back( [this] { Worker(); } );
+            }
+            m_buf = m_slots[0].buf;
+        }
+    }
+
+    Context CreateContext() const
+    {
+        Context ctx = {};
+        switch( m_comp )
+        {
         case Compression::Fast:
-            m_stream = LZ4_createStream();
+            ctx.stream = LZ4_createStream();
             break;
         case Compression::Slow:
-            m_streamHC = LZ4_createStreamHC();
-            break;
         case Compression::Extreme:
-            m_streamHC = LZ4_createStreamHC();
-            LZ4_resetStreamHC( m_streamHC, LZ4HC_CLEVEL_MAX );
+            ctx.streamHC = LZ4_createStreamHC();
             break;
         case Compression::Zstd:
-            m_streamZstd = ZSTD_createCStream();
-            ZSTD_CCtx_setParameter( m_streamZstd, ZSTD_c_compressionLevel, level );
-            ZSTD_CCtx_setParameter( m_streamZstd, ZSTD_c_contentSizeFlag, 0 );
+            ctx.streamZstd = ZSTD_createCStream();
+            ZSTD_CCtx_setParameter( ctx.streamZstd, ZSTD_c_compressionLevel, m_level );
+            ZSTD_CCtx_setParameter( ctx.streamZstd, ZSTD_c_contentSizeFlag, 0 );
+            break;
+        case Compression::None:
             break;
         default:
             assert( false );
             break;
         }
+        return ctx;
+    }
+
+    static void FreeContext( Context& ctx )
+    {
+        if( ctx.stream ) LZ4_freeStream( ctx.stream );
+        if( ctx.streamHC ) LZ4_freeStreamHC( ctx.streamHC );
+        if( ctx.streamZstd ) ZSTD_freeCStream( ctx.streamZstd );
+    }
 
-        if( comp == Compression::Zstd )
+    // Returns zero on failure.
+    uint32_t Compress( Context& ctx, const char* src, size_t size, char* dst ) const
+    {
+        uint32_t sz;
+        switch( m_comp )
+        {
+        case Compression::Fast:
+            sz = LZ4_compress_fast_extState( ctx.stream, src, dst, size, LZ4Size, 1 );
+            break;
+        case Compression::Slow:
+            sz = LZ4_compress_HC_extStateHC( ctx.streamHC, src, dst, size, LZ4Size, LZ4HC_CLEVEL_DEFAULT );
+            break;
+        case Compression::Extreme:
+            sz = LZ4_compress_HC_extStateHC( ctx.streamHC, src, dst, size, LZ4Size, LZ4HC_CLEVEL_MAX );
+            break;
+        case Compression::Zstd:
         {
-            fwrite( ZstdHeader, 1, sizeof( ZstdHeader ), m_file );
+            const size_t ret = ZSTD_compress2( ctx.streamZstd, dst, LZ4Size, src, size );
+            sz = ZSTD_isError( ret ) ? 0 : uint32_t( ret );
+            break;
         }
-        else
+        default:
+            assert( false );
+            sz = 0;
+            break;
+        }
+        return sz;
+    }
+
+    void Worker()
+    {
+        auto ctx = CreateContext();
+        for(;;)
         {
-            fwrite( Lz4Header, 1, sizeof( Lz4Header ), m_file );
+            const auto block = m_blockNext.fetch_add( 1, std::memory_order_relaxed );
+            auto& slot = m_slots[block % m_slots.size()];
+            {
+                std::unique_lock<std::mutex> lock( m_lock );
+                m_cvWork.wait( lock, [&] { return slot.state == SlotValue( block, Pending ) || m_exit; } );
+                if( m_exit ) break;
+            }
+            slot.lz4sz = Compress( ctx, slot.buf, slot.size, slot.lz4 );
+            {
+                std::lock_guard<std::mutex> lock( m_lock );
+                slot.state = SlotValue( block, Done );
+            }
+            m_cvDone.notify_one();
         }
+        FreeContext( ctx );
     }
 
+    tracy_force_inline uint64_t GetPosition() const { return m_dataOffset + m_offset; }
+
     tracy_force_inline void WriteSmall( const void* ptr, size_t size )
     {
         memcpy( m_buf + m_offset, ptr, size );
@@ -129,54 +293,125 @@ private:
 
             if( m_offset == BufSize )
             {
-                WriteLz4Block();
+                WriteBlock();
             }
         }
     }
 
-    void WriteLz4Block()
+    void WriteBlock()
     {
-        char lz4[LZ4Size];
-        uint32_t sz;
-        if( m_stream )
+        m_dataOffset += m_offset;
+        if( m_comp == Compression::None )
         {
-            sz = LZ4_compress_fast_continue( m_stream, m_buf, lz4, m_offset, LZ4Size, 1 );
+            WriteData( m_buf, m_offset, m_offset );
+            m_offset = 0;
+            return;
         }
-        else if( m_streamZstd )
+        if( m_threads.empty() )
         {
-            ZSTD_outBuffer out = { lz4, LZ4Size, 0 };
-            ZSTD_inBuffer in = { m_buf, m_offset, 0 };
-            const auto ret = ZSTD_compressStream2( m_streamZstd, &out, &in, ZSTD_e_flush );
-            assert( ret == 0 );
-            sz = out.pos;
+            char lz4[LZ4Size];
+            const auto sz = Compress( m_ctx, m_buf, m_offset, lz4 );
+            WriteData( lz4, sz, m_offset );
+            m_offset = 0;
+            return;
         }
-        else
+
+        auto& slot = m_slots[m_block % m_slots.size()];
+        slot.size = m_offset;
         {
-            sz = LZ4_compress_HC_continue( m_streamHC, m_buf, lz4, m_offset, LZ4Size );
+            std::lock_guard<std::mutex> lock( m_lock );
+            slot.state = SlotValue( m_block, Pending );
         }
+        m_cvWork.notify_all();
+        m_block++;
+        m_offset = 0;
+
+        // Write out blocks which are already compressed, and wait for the oldest one if the next slot
+        // is still in use.
+        auto& next = m_slots[m_block % m_slots.size()];
+        while( m_blockWrite != m_block && GetSlotState( m_slots[m_blockWrite % m_slots.size()] ) == SlotValue( m_blockWrite, Done ) ) WriteSlot();
+        while( GetSlotState( next ) != SlotValue( m_block, Free ) ) WriteSlot();
+        m_buf = next.buf;
+    }
 
-        m_srcBytes += m_offset;
+    void WriteSlot()
+    {
+        auto& slot = m_slots[m_blockWrite % m_slots.size()];
+        {
+            std::unique_lock<std::mutex> lock( m_lock );
+            m_cvDone.wait( lock, [&] { return slot.state == SlotValue( m_blockWrite, Done ); } );
+        }
+        WriteData( slot.lz4, slot.lz4sz, slot.size );
+        {
+            std::lock_guard<std::mutex> lock( m_lock );
+            slot.state = SlotValue( m_blockWrite + m_slots.size(), Free );
+        }
+        m_blockWrite++;
+    }
+
+    uint64_t GetSlotState( const Slot& slot )
+    {
+        std::lock_guard<std::mutex> lock( m_lock );
+        return slot.state;
+    }
+
+    void WriteData( const char* lz4, uint32_t sz, size_t srcSize )
+    {
+        if( sz == 0 ) m_failed = true;
+        if( m_failed ) return;
+        m_srcBytes += srcSize;
         m_dstBytes += sz;
 
+        m_blockOffset.push_back( m_fileOffset );
         fwrite( &sz, 1, sizeof( sz ), m_file );
         fwrite( lz4, 1, sz, m_file );
-        m_offset = 0;
-        std::swap( m_buf, m_second );
+        m_fileOffset += sizeof( sz ) + sz;
     }
 
-    enum { BufSize = 64 * 1024 };
+    void WriteIndex()
+    {
+        const uint64_t indexOffset = m_fileOffset;
+        const uint64_t blockCount = m_blockOffset.size();
+        const uint64_t dataSize = m_dataOffset;
+        const uint64_t sectionCount = m_sections.size();
+        fwrite( &blockCount, 1, sizeof( blockCount ), m_file );
+        fwrite( &dataSize, 1, sizeof( dataSize ), m_file );
+        fwrite( m_blockOffset.data(), 1, sizeof( uint64_t ) * blockCount, m_file );
+        fwrite( &sectionCount, 1, sizeof( sectionCount ), m_file );
+        fwrite( m_sections.data(), 1, sizeof( Section ) * sectionCount, m_file );
+        fwrite( &indexOffset, 1, sizeof( indexOffset ), m_file );
+    }
+
+    enum { BufSize = FileBlockSize };
     enum { LZ4Size = std::max( LZ4_COMPRESSBOUND( BufSize ), ZSTD_COMPRESSBOUND( BufSize ) ) };
 
-    LZ4_stream_t* m_stream;
-    LZ4_streamHC_t* m_streamHC;
-    ZSTD_CStream* m_streamZstd;
+    Compression m_comp;
+    int m_level;
+    Context m_ctx;
     FILE* m_file;
-    char m_bufData[2][BufSize];
+    char m_bufData[BufSize];
     char* m_buf;
-    char* m_second;
     size_t m_offset;
+    uint64_t m_fileOffset;
+    uint64_t m_dataOffset;
     size_t m_srcBytes;
     size_t m_dstBytes;
+    bool m_finished;
+    bool m_failed;
+    std::vector<uint64_t> m_blockOffset;
+    std::vector<Section> m_sections;
+
+    uint64_t m_block;
+    uint64_t m_blockWrite;
+    std::vector<Slot> m_slots;
+    std::vector<std::thread> m_threads;
+    alignas(64) std::atomic<uint64_t> m_blockNext;
+
+    // Guards the slot states and m_exit. Compression threads wait on m_cvWork, the writer waits on m_cvDone.
+    std::mutex m_lock;
+    std::condition_variable m_cvWork;
+    std::condition_variable m_cvDone;
+    bool m_exit;
 };
 
 }
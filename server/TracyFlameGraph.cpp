@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <mutex>
+
+#include "TracyFlameGraph.hpp"
+#include "TracySort.hpp"
+#include "TracyWorker.hpp"
+
+namespace tracy
+{
+
+FlameGraph::~FlameGraph()
+{
+    m_cancel.store( true, std::memory_order_relaxed );
+    if( m_thread.joinable() ) m_thread.join();
+}
+
+void FlameGraph::Build( Worker& worker, Source source )
+{
+    // The running build may be waiting for the data lock held by the caller, so it is only
+    // cancelled here. The new build is started by Update() once the old one has finished.
+    if( m_thread.joinable() )
+    {
+        m_cancel.store( true, std::memory_order_relaxed );
+        m_pending = true;
+        m_pendingSource = source;
+        return;
+    }
+    m_done.store( false, std::memory_order_relaxed );
+    m_cancel.store( false, std::memory_order_relaxed );
+    m_thread = std::thread( [this, &worker, source] {
+        BuildImpl( worker, source );
+        m_done.store( true, std::memory_order_release );
+    } );
+}
+
+bool FlameGraph::Update( Worker& worker )
+{
+    if( !m_thread.joinable() || !m_done.load( std::memory_order_acquire ) ) return false;
+    m_thread.join();
+    if( m_pending )
+    {
+        m_pending = false;
+        Build( worker, m_pendingSource );
+        return false;
+    }
+    m_nodes = std::move( m_result );
+    m_maxDepth = m_resultDepth;
+    m_result = std::vector<FlameGraphNode>();
+    return true;
+}
+
+static inline const ZoneEvent& GetZone( const Vector<short_ptr<ZoneEvent>>& vec, size_t idx )
+{
+    if( vec.is_magic() ) return ( (const Vector<ZoneEvent>&)vec )[idx];
+    return *vec[idx];
+}
+
+static void CountZoneCallstack( const Worker& worker, const ZoneEvent& ev, std::vector<uint64_t>& weight )
+{
+    if( worker.HasZoneExtra( ev ) && ev.IsEndValid() )
+    {
+        const auto cs = worker.GetZoneExtra( ev ).callstack.Val();
+        if( cs != 0 )
+        {
+            if( cs >= weight.size() ) weight.resize( cs + 1 );
+            weight[cs] += ev.End() - ev.Start();
+        }
+    }
+}
+
+void FlameGraph::BuildImpl( Worker& worker, Source source )
+{
+    auto& lock = worker.GetDataLock();
+
+    // Weight of each callstack: number of samples, or total time of zones which have it.
+    std::vector<uint64_t> weight;
+    {
+        std::lock_guard<std::mutex> guard( lock );
+        weight.resize( worker.GetCallstackPayloadCount() + 1 );
+    }
+    size_t thread = 0;
+    size_t pos = 0;
+    // Zone tree walk position, kept across batches: children vector index (-1 for the thread
+    // timeline) and the next zone in it. Vectors may be reallocated while the lock is released,
+    // so they are looked up again in each batch.
+    std::vector<std::pair<int32_t, size_t>> stack;
+    for(;;)
+    {
+        if( m_cancel.load( std::memory_order_relaxed ) ) return;
+        std::lock_guard<std::mutex> guard( lock );
+        const auto& threads = worker.GetThreadData();
+        if( thread >= threads.size() ) break;
+        const auto td = threads[thread];
+        size_t done = 0;
+        if( source == Source::Samples )
+        {
+            const auto& samples = td->samples;
+            const auto end = std::min<size_t>( samples.size(), pos + BatchSize );
+            for( ; pos<end; pos++ )
+            {
+                const auto cs = samples[pos].callstack.Val();
+                if( cs >= weight.size() ) weight.resize( cs + 1 );
+                weight[cs]++;
+            }
+            done = pos == samples.size();
+        }
+        else
+        {
+            if( stack.empty() ) stack.emplace_back( -1, 0 );
+            size_t visited = 0;
+            while( !stack.empty() && visited < BatchSize )
+            {
+                const auto idx = stack.back().first;
+                const auto& vec = idx < 0 ? td->timeline : worker.GetZoneChildren( idx );
+                if( stack.back().second == vec.size() )
+                {
+                    stack.pop_back();
+                    continue;
+                }
+                const auto& ev = GetZone( vec, stack.back().second++ );
+                CountZoneCallstack( worker, ev, weight );
+                visited++;
+                if( ev.HasChildren() ) stack.emplace_back( ev.Child(), 0 );
+            }
+            done = stack.empty();
+        }
+        if( done )
+        {
+            thread++;
+            pos = 0;
+        }
+    }
+
+    // Each distinct callstack is inserted into the tree once. Child lookup goes through a single
+    // map keyed by parent node and function name.
+    std::vector<FlameGraphNode> nodes;
+    nodes.push_back( FlameGraphNode { 0, NoName, 0, 0, 0 } );
+    unordered_flat_map<uint64_t, uint32_t> childMap;
+    std::vector<uint32_t> path;
+    size_t cs = 1;
+    while( cs < weight.size() )
+    {
+        if( m_cancel.load( std::memory_order_relaxed ) ) return;
+        std::lock_guard<std::mutex> guard( lock );
+        const auto end = std::min( weight.size(), cs + StackBatchSize );
+        for( ; cs<end; cs++ )
+        {
+            const auto w = weight[cs];
+            if( w == 0 ) continue;
+            path.clear();
+            const auto& stack = worker.GetCallstack( cs );
+            for( int i=int( stack.size() )-1; i>=0; i-- )
+            {
+                const auto frameData = worker.GetCallstackFrame( stack[i] );
+                if( !frameData )
+                {
+                    path.push_back( NoName );
+                }
+                else
+                {
+                    for( int j=frameData->size-1; j>=0; j-- ) path.push_back( frameData->data[j].name.Idx() );
+                }
+            }
+            uint32_t node = 0;
+            nodes[0].weight += w;
+            for( auto name : path )
+            {
+                const auto key = ( uint64_t( node ) << 32 ) | name;
+                auto it = childMap.find( key );
+                if( it == childMap.end() )
+                {
+                    const auto idx = uint32_t( nodes.size() );
+                    nodes.push_back( FlameGraphNode { 0, name, node, 0, 0 } );
+                    it = childMap.emplace( key, idx ).first;
+                }
+                node = it->second;
+                nodes[node].weight += w;
+            }
+        }
+    }
+    childMap = unordered_flat_map<uint64_t, uint32_t>();
+    weight = std::vector<uint64_t>();
+
+    // Lay out the tree breadth first, so that the children of each node are contiguous.
+    const auto num = nodes.size();
+    std::vector<uint32_t> offset( num + 1 );
+    for( size_t i=1; i<num; i++ ) offset[nodes[i].parent + 1]++;
+    for( size_t i=0; i<num; i++ ) offset[i+1] += offset[i];
+    std::vector<uint32_t> children( num > 0 ? num - 1 : 0 );
+    {
+        auto fill = offset;
+        for( size_t i=1; i<num; i++ ) children[fill[nodes[i].parent]++] = uint32_t( i );
+    }
+
+    std::vector<FlameGraphNode> result;
+    result.reserve( num );
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> depth;
+    order.reserve( num );
+    depth.reserve( num );
+    result.push_back( FlameGraphNode { nodes[0].weight, NoName, 0, 0, 0 } );
+    order.push_back( 0 );
+    depth.push_back( 0 );
+    uint32_t maxDepth = 0;
+    for( size_t i=0; i<order.size(); i++ )
+    {
+        const auto src = order[i];
+        const auto c0 = children.begin() + offset[src];
+        const auto c1 = children.begin() + offset[src+1];
+        pdqsort_branchless( c0, c1, [&nodes] ( const auto& l, const auto& r ) { return nodes[l].weight > nodes[r].weight; } );
+        result[i].child = uint32_t( result.size() );
+        result[i].numChildren = uint32_t( c1 - c0 );
+        for( auto it = c0; it != c1; ++it )
+        {
+            result.push_back( FlameGraphNode { nodes[*it].weight, nodes[*it].name, uint32_t( i ), 0, 0 } );
+            order.push_back( *it );
+            depth.push_back( depth[i] + 1 );
+            maxDepth = std::max( maxDepth, depth[i] + 1 );
+        }
+    }
+
+    m_result = std::move( result );
+    m_resultDepth = maxDepth;
+}
+
+}
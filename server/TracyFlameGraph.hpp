@@ -0,0 +1,73 @@
+#ifndef __TRACYFLAMEGRAPH_HPP__
+#define __TRACYFLAMEGRAPH_HPP__
+
+#include <atomic>
+#include <limits>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace tracy
+{
+
+class Worker;
+
+struct FlameGraphNode
+{
+    uint64_t weight;
+    uint32_t name;          // string index of the function name, or FlameGraph::NoName
+    uint32_t parent;
+    uint32_t child;         // children are stored contiguously, heaviest first
+    uint32_t numChildren;
+};
+
+// Call tree of callstack samples or of zone callstacks (weighted by zone time), stored as a flat
+// node array with node 0 being the root. Samples are first counted per unique callstack, so the
+// tree build cost depends on the number of distinct callstacks rather than the number of samples.
+// The build runs on a background thread, which takes the worker data lock for each batch of work.
+class FlameGraph
+{
+    enum { BatchSize = 1024 * 1024 };
+    enum { StackBatchSize = 16 * 1024 };
+
+public:
+    enum class Source
+    {
+        Samples,
+        Zones
+    };
+
+    enum : uint32_t { NoName = std::numeric_limits<uint32_t>::max() };
+
+    FlameGraph() = default;
+    ~FlameGraph();
+
+    // Both must be called with the worker data lock held. Update() returns true when a new tree
+    // has been made available.
+    void Build( Worker& worker, Source source );
+    bool Update( Worker& worker );
+    bool IsBuilding() const { return m_thread.joinable(); }
+
+    const std::vector<FlameGraphNode>& GetNodes() const { return m_nodes; }
+    uint32_t GetMaxDepth() const { return m_maxDepth; }
+
+private:
+    void BuildImpl( Worker& worker, Source source );
+
+    std::vector<FlameGraphNode> m_nodes;
+    uint32_t m_maxDepth = 0;
+
+    std::vector<FlameGraphNode> m_result;
+    uint32_t m_resultDepth = 0;
+
+    bool m_pending = false;
+    Source m_pendingSource;
+
+    std::thread m_thread;
+    std::atomic<bool> m_done { false };
+    std::atomic<bool> m_cancel { false };
+};
+
+}
+
+#endif
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <limits>
+#include <mutex>
+
+#include "TracyMemoryMap.hpp"
+#include "TracySort.hpp"
+#include "TracyWorker.hpp"
+
+namespace tracy
+{
+
+MemoryMap::~MemoryMap()
+{
+    m_cancel.store( true, std::memory_order_relaxed );
+    if( m_thread.joinable() ) m_thread.join();
+}
+
+void MemoryMap::Update( Worker& worker, uint64_t pool )
+{
+    if( m_thread.joinable() )
+    {
+        if( !m_done.load( std::memory_order_acquire ) )
+        {
+            if( pool != m_pool ) m_cancel.store( true, std::memory_order_relaxed );
+            return;
+        }
+        m_thread.join();
+    }
+
+    const auto& mem = worker.GetMemoryNamed( pool );
+    // A new lowest address moves the origin of all chunks.
+    if( pool != m_pool || &mem != m_mem || mem.low != m_low ) Reset( pool, &mem );
+
+    // Frees of loaded traces are put in time order by the memory plot reconstruction.
+    if( mem.reconstruct && !mem.plot ) return;
+
+    const auto pending = mem.data.size() - m_allocs + mem.frees.size() - m_frees;
+    if( pending == 0 ) return;
+    if( pending < BackgroundThreshold )
+    {
+        Process( mem, pending );
+        return;
+    }
+
+    m_done.store( false, std::memory_order_relaxed );
+    m_cancel.store( false, std::memory_order_relaxed );
+    m_thread = std::thread( [this, &worker, &mem] {
+        for(;;)
+        {
+            std::lock_guard<std::mutex> lock( worker.GetDataLock() );
+            if( m_cancel.load( std::memory_order_relaxed ) || !Process( mem, BatchSize ) ) break;
+        }
+        m_done.store( true, std::memory_order_release );
+    } );
+}
+
+void MemoryMap::GetPageDecay( size_t idx, int64_t lastTime, int8_t* out ) const
+{
+    const auto last = int32_t( ( std::max<int64_t>( lastTime, 0 ) >> 24 ) - m_base + 1 );
+    const auto data = m_data.data() + size_t( m_pages[idx].second ) * PageSize;
+    for( size_t i=0; i<PageSize; i++ )
+    {
+        const int32_t v = data[i];
+        if( v == 0 )
+        {
+            out[i] = 0;
+        }
+        else if( v > 0 )
+        {
+            out[i] = int8_t( std::max( 1, 127 - std::max( 0, last - v ) ) );
+        }
+        else
+        {
+            out[i] = int8_t( -std::max( 1, 127 - std::max( 0, last + v ) ) );
+        }
+    }
+}
+
+void MemoryMap::Reset( uint64_t pool, const MemData* mem )
+{
+    m_pool = pool;
+    m_mem = mem;
+    m_low = mem->low;
+    m_base = 0;
+    m_allocs = 0;
+    m_frees = 0;
+    m_pageMap.clear();
+    m_pages.clear();
+    m_data.clear();
+}
+
+// Applies up to limit events in time order. Returns true if more events are pending.
+bool MemoryMap::Process( const MemData& mem, size_t limit )
+{
+    const auto asz = mem.data.size();
+    const auto fsz = mem.frees.size();
+    const auto pages = m_pages.size();
+
+    auto ait = m_allocs;
+    auto fit = m_frees;
+    while( limit-- != 0 && ( ait != asz || fit != fsz ) )
+    {
+        const MemEvent* ev;
+        int64_t time;
+        bool alloc;
+        if( fit == fsz || ( ait != asz && mem.data[ait].TimeAlloc() <= mem.data[mem.frees[fit]].TimeFree() ) )
+        {
+            ev = &mem.data[ait++];
+            time = ev->TimeAlloc();
+            alloc = true;
+        }
+        else
+        {
+            ev = &mem.data[mem.frees[fit++]];
+            time = ev->TimeFree();
+            alloc = false;
+        }
+        const auto t = std::max<int64_t>( time, 0 ) >> 24;
+        if( t - m_base >= std::numeric_limits<int16_t>::max() ) Rebase( t - 128 );
+        const auto stamp = int16_t( t - m_base + 1 );
+        const auto ptr = ev->Ptr() - m_low;
+        Fill( ptr >> ChunkBits, ( ptr + ev->Size() ) >> ChunkBits, alloc ? stamp : int16_t( -stamp ) );
+    }
+    m_allocs = ait;
+    m_frees = fit;
+
+    if( m_pages.size() != pages )
+    {
+        pdqsort_branchless( m_pages.begin(), m_pages.end(), []( const auto& lhs, const auto& rhs ) { return lhs.first < rhs.first; } );
+    }
+    return ait != asz || fit != fsz;
+}
+
+void MemoryMap::Fill( uint64_t c0, uint64_t c1, int16_t stamp )
+{
+    auto p0 = c0 >> PageBits;
+    const auto p1 = c1 >> PageBits;
+
+    if( p0 == p1 )
+    {
+        const auto a0 = c0 & ( PageSize - 1 );
+        const auto a1 = c1 & ( PageSize - 1 );
+        auto page = GetPage( p0 );
+        std::fill( page + a0, page + a1 + 1, stamp );
+    }
+    else
+    {
+        {
+            const auto a0 = c0 & ( PageSize - 1 );
+            auto page = GetPage( p0 );
+            std::fill( page + a0, page + PageSize, stamp );
+        }
+        while( ++p0 < p1 )
+        {
+            auto page = GetPage( p0 );
+            std::fill( page, page + PageSize, stamp );
+        }
+        {
+            const auto a1 = c1 & ( PageSize - 1 );
+            auto page = GetPage( p1 );
+            std::fill( page, page + a1 + 1, stamp );
+        }
+    }
+}
+
+// Events are processed in time order, so this happens at most once per 2^39 ns of the trace.
+void MemoryMap::Rebase( int64_t base )
+{
+    const auto delta = base - m_base;
+    for( auto& v : m_data )
+    {
+        if( v > 0 ) v = int16_t( std::max<int64_t>( 1, v - delta ) );
+        else if( v < 0 ) v = int16_t( std::min<int64_t>( -1, v + delta ) );
+    }
+    m_base = base;
+}
+
+int16_t* MemoryMap::GetPage( uint64_t page )
+{
+    auto it = m_pageMap.find( page );
+    if( it == m_pageMap.end() )
+    {
+        const auto idx = uint32_t( m_pages.size() );
+        it = m_pageMap.emplace( page, idx ).first;
+        m_pages.emplace_back( page, idx );
+        m_data.resize( m_data.size() + PageSize );
+    }
+    return m_data.data() + size_t( it->second ) * PageSize;
+}
+
+}
@@ -0,0 +1,73 @@
+#ifndef __TRACYMEMORYMAP_HPP__
+#define __TRACYMEMORYMAP_HPP__
+
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "tracy_robin_hood.h"
+
+namespace tracy
+{
+
+class Worker;
+struct MemData;
+
+enum { ChunkBits = 10 };
+enum { PageBits = 10 };
+enum { PageSize = 1 << PageBits };
+enum { PageChunkBits = ChunkBits + PageBits };
+enum { PageChunkSize = 1 << PageChunkBits };
+
+// Memory map of a single pool, updated with the alloc and free events that arrived since the
+// previous update. Chunks are addressed relative to the lowest address of the pool, as in the
+// range view. Each chunk holds the time of the last event that touched it, in 2^24 ns units past
+// m_base, positive for allocations and negative for frees. When the time no longer fits, m_base is
+// moved forward and older stamps are clamped to it, which loses nothing, as the displayed decay is
+// saturated by then. Large updates are processed on a background thread, which takes the worker
+// data lock for each batch of events.
+class MemoryMap
+{
+    enum { BackgroundThreshold = 1024 * 1024 };
+    enum { BatchSize = 256 * 1024 };
+
+public:
+    MemoryMap() = default;
+    ~MemoryMap();
+
+    // Must be called with the worker data lock held, as well as all other methods below.
+    void Update( Worker& worker, uint64_t pool );
+
+    bool IsBuilding() const { return m_thread.joinable(); }
+    size_t GetPageCount() const { return m_pages.size(); }
+    uint64_t GetPageAddress( size_t idx ) const { return m_pages[idx].first; }
+    void GetPageDecay( size_t idx, int64_t lastTime, int8_t* out ) const;
+
+private:
+    void Reset( uint64_t pool, const MemData* mem );
+    bool Process( const MemData& mem, size_t limit );
+    void Fill( uint64_t c0, uint64_t c1, int16_t stamp );
+    void Rebase( int64_t base );
+    int16_t* GetPage( uint64_t page );
+
+    uint64_t m_pool = 0;
+    const MemData* m_mem = nullptr;
+    uint64_t m_low = 0;
+    int64_t m_base = 0;
+    size_t m_allocs = 0;
+    size_t m_frees = 0;
+
+    unordered_flat_map<uint64_t, uint32_t> m_pageMap;
+    std::vector<std::pair<uint64_t, uint32_t>> m_pages;
+    std::vector<int16_t> m_data;
+
+    std::thread m_thread;
+    std::atomic<bool> m_done { false };
+    std::atomic<bool> m_cancel { false };
+};
+
+}
+
+#endif
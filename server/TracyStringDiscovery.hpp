@@ -68,6 +68,14 @@ public:
         }
     }
 
+    tracy_force_inline T Find( uint64_t name ) const
+    {
+        auto it = m_map.find( name );
+        if( it != m_map.end() ) return it->second;
+        auto pit = m_pending.find( name );
+        return pit != m_pending.end() ? pit->second : T {};
+    }
+
     tracy_force_inline void AddExternal( const T& val )
     {
         m_data.push_back( val );
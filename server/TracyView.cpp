@@ -18,6 +18,7 @@
 #include "TracyImGui.hpp"
 #include "TracyPrint.hpp"
 #include "TracySourceView.hpp"
+#include "TracyTaskDispatch.hpp"
 #include "TracyTexture.hpp"
 #include "TracyView.hpp"
 #include "../public/common/TracyStackFrames.hpp"
@@ -222,6 +223,7 @@ static const char* CompressionName[] = {
     "LZ4 HC",
     "LZ4 HC extreme",
     "Zstd",
+    "None",
     nullptr
 };
 
@@ -230,6 +232,7 @@ static const char* CompressionDesc[] = {
     "Slow save, fastest load time, reasonable file size",
     "Very slow save, fastest load time, file smaller than LZ4 HC",
     "Configurable save time (fast-slowest), reasonable load time, smallest file size",
+    "Fastest save, fastest load time (no decompression), huge file size",
     nullptr
 };
 
@@ -544,6 +547,14 @@ bool View::Draw()
         }
         ImGui::Unindent();
 
+        static int threads = std::max<int>( std::thread::hardware_concurrency(), 1 );
+        ImGui::TextUnformatted( "Compression threads" );
+        ImGui::SameLine();
+        TextDisabledUnformatted( "Blocks are compressed in parallel" );
+        ImGui::Indent();
+        ImGui::SliderInt( "##threads", &threads, 1, std::max<int>( std::thread::hardware_concurrency(), 1 ), "%d", ImGuiSliderFlags_AlwaysClamp );
+        ImGui::Unindent();
+
         static bool buildDict = false;
         if( s_instance->m_worker.GetFrameImageCount() != 0 )
         {
@@ -556,7 +567,7 @@ bool View::Draw()
         ImGui::Separator();
         if( ImGui::Button( ICON_FA_SAVE " Save trace" ) )
         {
-            saveFailed = !s_instance->Save( fn, comp, zlvl, buildDict );
+            saveFailed = !s_instance->Save( fn, comp, zlvl, threads, buildDict );
             s_instance->m_filenameStaging.clear();
             ImGui::CloseCurrentPopup();
         }
@@ -812,6 +823,10 @@ bool View::DrawImpl()
         {
             m_showWaitStacks = true;
         }
+        if( ButtonDisablable( ICON_FA_FIRE " Flame graph", m_worker.GetCallstackPayloadCount() == 0 ) )
+        {
+            m_flameGraph.show = true;
+        }
         ImGui::EndPopup();
     }
     if( m_sscb )
@@ -983,6 +998,7 @@ bool View::DrawImpl()
     if( m_memInfo.show ) DrawMemory();
     if( m_memInfo.showAllocList ) DrawAllocList();
     if( m_compare.show ) DrawCompare();
+    if( m_flameGraph.show ) DrawFlameGraph();
     if( m_callstackInfoWindow != 0 ) DrawCallstackWindow();
     if( m_memoryAllocInfoWindow >= 0 ) DrawMemoryAllocWindow();
     if( m_showInfo ) DrawInfo();
@@ -1256,9 +1272,9 @@ void View::DrawSourceTooltip( const char* filename, uint32_t srcline, int before
     ImGui::PopStyleVar();
 }
 
-bool View::Save( const char* fn, FileWrite::Compression comp, int zlevel, bool buildDict )
+bool View::Save( const char* fn, FileWrite::Compression comp, int zlevel, int threads, bool buildDict )
 {
-    std::unique_ptr<FileWrite> f( FileWrite::Open( fn, comp, zlevel ) );
+    std::unique_ptr<FileWrite> f( FileWrite::Open( fn, comp, zlevel, threads ) );
     if( !f ) return false;
 
     m_userData.StateShouldBePreserved();
@@ -1276,4 +1292,19 @@ bool View::Save( const char* fn, FileWrite::Compression comp, int zlevel, bool b
     return true;
 }
 
+// Runs the job for each chunk index on the task dispatch threads and waits until all are done.
+void View::DispatchChunks( size_t chunks, const std::function<void(size_t)>& job )
+{
+    if( chunks > 1 )
+    {
+        if( !m_taskDispatch ) m_taskDispatch = std::make_unique<TaskDispatch>( std::max<int>( std::thread::hardware_concurrency() - 1, 1 ) );
+        for( size_t c=0; c<chunks; c++ ) m_taskDispatch->Queue( [&job, c] { job( c ); } );
+        m_taskDispatch->Sync();
+    }
+    else if( chunks == 1 )
+    {
+        job( 0 );
+    }
+}
+
 }
@@ -14,9 +14,12 @@
 #include "TracyBuzzAnim.hpp"
 #include "TracyDecayValue.hpp"
 #include "TracyFileWrite.hpp"
+#include "TracyFlameGraph.hpp"
+#include "TracyMemoryMap.hpp"
 #include "TracyShortPtr.hpp"
 #include "TracySourceContents.hpp"
 #include "TracyUserData.hpp"
+#include "TracyZoneCompare.hpp"
 #include "TracyVector.hpp"
 #include "TracyViewData.hpp"
 #include "TracyWorker.hpp"
@@ -37,6 +40,7 @@ constexpr const char* GpuContextNames[] = {
 struct MemoryPage;
 class FileRead;
 class SourceView;
+class TaskDispatch;
 
 class View
 {
@@ -174,6 +178,8 @@ private:
         uint32_t count;
     };
 
+    enum { SampleStatChunkSize = 16 * 1024 };
+
     void InitMemory();
     void InitTextEditor( ImFont* font );
 
@@ -215,10 +221,14 @@ private:
     void DrawFindZone();
     void AccumulationModeComboBox();
     void DrawStatistics();
-    void DrawSamplesStatistics(Vector<SymList>& data, int64_t timeRange, AccumulationMode accumulationMode);
+    void UpdateSampleStatistics();
+    void AggregateSamplesStatistics( Vector<SymList>& data, unordered_flat_map<uint64_t, SymList>& inlineMap, AccumulationMode accumulationMode );
+    void DrawSamplesStatistics( const Vector<SymList>& data, const unordered_flat_map<uint64_t, SymList>& inlineMap, int64_t timeRange, AccumulationMode accumulationMode );
+    void DispatchChunks( size_t chunks, const std::function<void(size_t)>& job );
     void DrawMemory();
     void DrawAllocList();
     void DrawCompare();
+    void DrawCompareAllZones();
     void DrawCallstackWindow();
     void DrawCallstackTable( uint32_t callstack, bool globalEntriesButton );
     void DrawMemoryAllocWindow();
@@ -234,6 +244,9 @@ private:
     void DrawRangeEntry( Range& range, const char* label, uint32_t color, const char* popupLabel, int id );
     void DrawSourceTooltip( const char* filename, uint32_t line, int before = 3, int after = 3, bool separateTooltip = true );
     void DrawWaitStacks();
+    void DrawFlameGraph();
+    void DrawFlameGraphNode( uint32_t idx, double x0, double x1, uint32_t depth, const ImVec2& wpos, float rowHeight, uint64_t total );
+    const char* GetFlameGraphNodeName( uint32_t idx ) const;
 
     void ListMemData( std::vector<const MemEvent*>& vec, std::function<void(const MemEvent*)> DrawAddress, const char* id = nullptr, int64_t startTime = -1, uint64_t pool = 0 );
 
@@ -310,6 +323,7 @@ private:
     void FindZones();
     void FindZonesCompare();
 #endif
+    void MergeSortedRuns( int64_t* data, std::vector<size_t>& runs );
 
     std::vector<MemoryPage> GetMemoryPages() const;
     const char* GetPlotName( const PlotData* plot ) const;
@@ -335,7 +349,7 @@ private:
     void CalcZoneTimeDataImpl( const V& children, const ContextSwitch* ctx, unordered_flat_map<int16_t, ZoneTimeData>& data, int64_t& ztime, const ZoneEvent& zone );
 
     void SetPlaybackFrame( uint32_t idx );
-    bool Save( const char* fn, FileWrite::Compression comp, int zlevel, bool buildDict );
+    bool Save( const char* fn, FileWrite::Compression comp, int zlevel, int threads, bool buildDict );
 
     unordered_flat_map<const void*, VisData> m_visData;
     unordered_flat_map<uint64_t, bool> m_visibleMsgThread;
@@ -498,6 +512,7 @@ private:
 
     SourceContents m_srcHintCache;
     std::unique_ptr<SourceView> m_sourceView;
+    std::unique_ptr<TaskDispatch> m_taskDispatch;
     const char* m_sourceViewFile;
     bool m_uarchSet = false;
 
@@ -561,12 +576,30 @@ private:
     unordered_flat_map<int16_t, StatisticsCache> m_statCache;
     unordered_flat_map<int16_t, StatisticsCache> m_gpuStatCache;
 
+    struct {
+        bool valid = false;
+        RangeSlim range;
+        AccumulationMode accumulationMode;
+        bool showAll;
+        bool separateInlines;
+        bool showKernel;
+        size_t symbolCount;
+        size_t sampleCount;
+        std::string filter;
+        std::string imageFilter;
+        Vector<SymList> raw;
+        Vector<SymList> data;
+        unordered_flat_map<uint64_t, SymList> inlineMap;
+    } m_sampleStats;
+
     void(*m_cbMainThread)(std::function<void()>, bool);
 
     struct FindZone {
         enum : uint64_t { Unselected = std::numeric_limits<uint64_t>::max() - 1 };
         enum class GroupBy : int { Thread, UserText, ZoneName, Callstack, Parent, NoGrouping };
         enum class SortBy : int { Order, Count, Time, Mtpc };
+        enum { ChunkSize = 256 * 1024 };
+        enum { MaxZonesPerFrame = 16 * 1024 * 1024 };
 
         struct Group
         {
@@ -700,6 +733,19 @@ private:
         double v1;
     };
 
+    struct CompareTimes
+    {
+        std::vector<int64_t> sorted;
+        size_t num = 0;
+        int64_t total = 0;
+        float average = 0;
+        float median = 0;
+    };
+
+#ifndef TRACY_NO_STATISTICS
+    void UpdateCompareTimes( CompareTimes& times, const Worker& worker, int16_t srcloc );
+#endif
+
     struct {
         bool show = false;
         bool ignoreCase = false;
@@ -717,23 +763,17 @@ private:
         bool normalize = true;
         int64_t numBins = -1;
         std::unique_ptr<CompVal[]> bins, binTime;
-        std::vector<int64_t> sorted[2];
-        size_t sortedNum[2] = { 0, 0 };
-        float average[2];
-        float median[2];
-        int64_t total[2];
+        CompareTimes frameTimes[2];
+        unordered_flat_map<int16_t, CompareTimes> zoneTimes[2];
         int minBinVal = 1;
         int compareMode = 0;
+        ZoneCompare all;
 
         void ResetSelection()
         {
             for( int i=0; i<2; i++ )
             {
-                sorted[i].clear();
-                sortedNum[i] = 0;
-                average[i] = 0;
-                median[i] = 0;
-                total[i] = 0;
+                frameTimes[i] = CompareTimes();
             }
         }
 
@@ -742,6 +782,7 @@ private:
             ResetSelection();
             for( int i=0; i<2; i++ )
             {
+                zoneTimes[i].clear();
                 match[i].clear();
                 selMatch[i] = 0;
             }
@@ -756,8 +797,17 @@ private:
         bool showAllocList = false;
         std::vector<size_t> allocList;
         Range range;
+        MemoryMap map;
     } m_memInfo;
 
+    struct {
+        bool show = false;
+        bool built = false;
+        FlameGraph::Source source = FlameGraph::Source::Samples;
+        uint32_t root = 0;
+        FlameGraph graph;
+    } m_flameGraph;
+
     struct {
         std::vector<int64_t> data;
         const FrameData* frameSet = nullptr;
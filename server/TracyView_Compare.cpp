@@ -51,6 +51,50 @@ extern double s_time;
             }
         }
     }
+
+void View::UpdateCompareTimes( CompareTimes& times, const Worker& worker, int16_t srcloc )
+{
+    const auto& zones = worker.GetZonesForSourceLocation( srcloc ).zones;
+    const auto first = times.num;
+    const auto last = zones.size();
+    if( first == last ) return;
+
+    // Each chunk of new zones is collected and sorted by its own job, then all runs are merged
+    // with the times sorted before.
+    auto& vec = times.sorted;
+    vec.resize( last );
+    const auto chunks = ( last - first + FindZone::ChunkSize - 1 ) / FindZone::ChunkSize;
+    std::vector<int64_t> chunkTotal( chunks );
+    DispatchChunks( chunks, [&] ( size_t c ) {
+        const auto begin = first + c * FindZone::ChunkSize;
+        const auto end = std::min<size_t>( last, begin + FindZone::ChunkSize );
+        int64_t sum = 0;
+        for( size_t i=begin; i<end; i++ )
+        {
+            auto& zone = *zones[i].Zone();
+            const auto t = zone.End() - zone.Start();
+            vec[i] = t;
+            sum += t;
+        }
+        pdqsort_branchless( vec.begin() + begin, vec.begin() + end );
+        chunkTotal[c] = sum;
+    } );
+
+    std::vector<size_t> runs;
+    runs.reserve( chunks + 2 );
+    runs.emplace_back( 0 );
+    if( first != 0 ) runs.emplace_back( first );
+    for( size_t c=0; c<chunks; c++ )
+    {
+        runs.emplace_back( std::min<size_t>( last, first + ( c+1 ) * FindZone::ChunkSize ) );
+        times.total += chunkTotal[c];
+    }
+    MergeSortedRuns( vec.data(), runs );
+
+    times.num = last;
+    times.average = float( times.total ) / last;
+    times.median = vec[last/2];
+}
 #endif
 
 bool View::FindMatchingZone( int prev0, int prev1, int flags )
@@ -234,9 +278,10 @@ void View::DrawCompare()
         ImGui::TextDisabled( "(%s)", m_compare.second->GetCaptureName().c_str() );
     }
 
-    if( ImGui::Button( ICON_FA_TRASH_ALT " Unload" ) )
+    if( ButtonDisablable( ICON_FA_TRASH_ALT " Unload", m_compare.all.IsRunning() ) )
     {
         m_compare.Reset();
+        m_compare.all.ClearResult();
         m_compare.second.reset();
         m_compare.userData.reset();
         ImGui::End();
@@ -251,11 +296,21 @@ void View::DrawCompare()
     ImGui::RadioButton( "Zones", &m_compare.compareMode, 0 );
     ImGui::SameLine();
     ImGui::RadioButton( "Frames", &m_compare.compareMode, 1 );
+    ImGui::SameLine();
+    ImGui::RadioButton( "All zones", &m_compare.compareMode, 2 );
     if( oldMode != m_compare.compareMode )
     {
         m_compare.Reset();
     }
 
+    m_compare.all.Update();
+    if( m_compare.compareMode == 2 )
+    {
+        DrawCompareAllZones();
+        ImGui::End();
+        return;
+    }
+
     bool findClicked = false;
 
     if( m_compare.compareMode == 0 )
@@ -483,53 +538,37 @@ void View::DrawCompare()
         size_t size0, size1;
         int64_t total0, total1;
         double sumSq0, sumSq1;
+        CompareTimes* times[2];
 
         if( m_compare.compareMode == 0 )
         {
-            auto& zoneData0 = m_worker.GetZonesForSourceLocation( m_compare.match[0][m_compare.selMatch[0]] );
-            auto& zoneData1 = m_compare.second->GetZonesForSourceLocation( m_compare.match[1][m_compare.selMatch[1]] );
-            auto& zones0 = zoneData0.zones;
-            auto& zones1 = zoneData1.zones;
-            zones0.ensure_sorted();
-            zones1.ensure_sorted();
+            const auto srcloc0 = m_compare.match[0][m_compare.selMatch[0]];
+            const auto srcloc1 = m_compare.match[1][m_compare.selMatch[1]];
+            auto& zoneData0 = m_worker.GetZonesForSourceLocation( srcloc0 );
+            auto& zoneData1 = m_compare.second->GetZonesForSourceLocation( srcloc1 );
+            zoneData0.zones.ensure_sorted();
+            {
+                // The external trace may be read by the all zones comparison job.
+                std::lock_guard<std::mutex> lock( m_compare.second->GetDataLock() );
+                zoneData1.zones.ensure_sorted();
+            }
 
             tmin = std::min( zoneData0.min, zoneData1.min );
             tmax = std::max( zoneData0.max, zoneData1.max );
 
-            size0 = zones0.size();
-            size1 = zones1.size();
+            size0 = zoneData0.zones.size();
+            size1 = zoneData1.zones.size();
             total0 = zoneData0.total;
             total1 = zoneData1.total;
             sumSq0 = zoneData0.sumSq;
             sumSq1 = zoneData1.sumSq;
 
-            const size_t zsz[2] = { size0, size1 };
-            for( int k=0; k<2; k++ )
-            {
-                if( m_compare.sortedNum[k] != zsz[k] )
-                {
-                    auto& zones = k == 0 ? zones0 : zones1;
-                    auto& vec = m_compare.sorted[k];
-                    vec.reserve( zsz[k] );
-                    int64_t total = m_compare.total[k];
-                    size_t i;
-                    for( i=m_compare.sortedNum[k]; i<zsz[k]; i++ )
-                    {
-                        auto& zone = *zones[i].Zone();
-                        const auto t = zone.End() - zone.Start();
-                        vec.emplace_back( t );
-                        total += t;
-                    }
-                    auto mid = vec.begin() + m_compare.sortedNum[k];
-                    pdqsort_branchless( mid, vec.end() );
-                    std::inplace_merge( vec.begin(), mid, vec.end() );
-
-                    m_compare.average[k] = float( total ) / i;
-                    m_compare.median[k] = vec[i/2];
-                    m_compare.total[k] = total;
-                    m_compare.sortedNum[k] = i;
-                }
-            }
+            // Sorted times are kept per source location, so going back to a previously selected
+            // pair does not collect them again.
+            times[0] = &m_compare.zoneTimes[0][srcloc0];
+            times[1] = &m_compare.zoneTimes[1][srcloc1];
+            UpdateCompareTimes( *times[0], m_worker, srcloc0 );
+            UpdateCompareTimes( *times[1], *m_compare.second, srcloc1 );
         }
         else
         {
@@ -551,29 +590,31 @@ void View::DrawCompare()
             const size_t zsz[2] = { size0, size1 };
             for( int k=0; k<2; k++ )
             {
-                if( m_compare.sortedNum[k] != zsz[k] )
+                auto& ft = m_compare.frameTimes[k];
+                times[k] = &ft;
+                if( ft.num != zsz[k] )
                 {
                     auto& frameSet = k == 0 ? f0 : f1;
                     auto worker = k == 0 ? &m_worker : m_compare.second.get();
-                    auto& vec = m_compare.sorted[k];
+                    auto& vec = ft.sorted;
                     vec.reserve( zsz[k] );
-                    int64_t total = m_compare.total[k];
+                    int64_t total = ft.total;
                     size_t i;
-                    for( i=m_compare.sortedNum[k]; i<zsz[k]; i++ )
+                    for( i=ft.num; i<zsz[k]; i++ )
                     {
                         if( worker->GetFrameEnd( *frameSet, i ) == worker->GetLastTime() ) break;
                         const auto t = worker->GetFrameTime( *frameSet, i );
                         vec.emplace_back( t );
                         total += t;
                     }
-                    auto mid = vec.begin() + m_compare.sortedNum[k];
+                    auto mid = vec.begin() + ft.num;
                     pdqsort_branchless( mid, vec.end() );
                     std::inplace_merge( vec.begin(), mid, vec.end() );
 
-                    m_compare.average[k] = float( total ) / i;
-                    m_compare.median[k] = vec[i/2];
-                    m_compare.total[k] = total;
-                    m_compare.sortedNum[k] = i;
+                    ft.average = float( total ) / i;
+                    ft.median = vec[i/2];
+                    ft.total = total;
+                    ft.num = i;
                 }
             }
         }
@@ -638,11 +679,10 @@ void View::DrawCompare()
                         }
                     }
 
-                    const auto& sorted = m_compare.sorted;
-                    auto sBegin0 = sorted[0].begin();
-                    auto sBegin1 = sorted[1].begin();
-                    auto sEnd0 = sorted[0].end();
-                    auto sEnd1 = sorted[1].end();
+                    auto sBegin0 = times[0]->sorted.begin();
+                    auto sBegin1 = times[1]->sorted.begin();
+                    auto sEnd0 = times[0]->sorted.end();
+                    auto sEnd1 = times[1]->sorted.end();
 
                     if( m_compare.minBinVal > 1 )
                     {
@@ -778,17 +818,17 @@ void View::DrawCompare()
 
                     TextColoredUnformatted( ImVec4( 0xDD/511.f, 0xDD/511.f, 0x22/511.f, 1.f ), ICON_FA_LEMON );
                     ImGui::SameLine();
-                    TextFocused( "Mean time (this):", TimeToString( m_compare.average[0] ) );
+                    TextFocused( "Mean time (this):", TimeToString( times[0]->average ) );
                     ImGui::SameLine();
                     ImGui::Spacing();
                     ImGui::SameLine();
                     TextColoredUnformatted( ImVec4( 0xDD/511.f, 0xDD/511.f, 0x22/511.f, 1.f ), ICON_FA_LEMON );
                     ImGui::SameLine();
-                    TextFocused( "Median time (this):", TimeToString( m_compare.median[0] ) );
-                    if( sorted[0].size() > 1 )
+                    TextFocused( "Median time (this):", TimeToString( times[0]->median ) );
+                    if( times[0]->sorted.size() > 1 )
                     {
-                        const auto sz = sorted[0].size();
-                        const auto avg = m_compare.average[0];
+                        const auto sz = times[0]->sorted.size();
+                        const auto avg = times[0]->average;
                         const auto ss = sumSq0 - 2. * total0 * avg + avg * avg * sz;
                         const auto sd = sqrt( ss / ( sz - 1 ) );
 
@@ -804,17 +844,17 @@ void View::DrawCompare()
 
                     TextColoredUnformatted( ImVec4( 0xDD/511.f, 0x22/511.f, 0x22/511.f, 1.f ), ICON_FA_GEM );
                     ImGui::SameLine();
-                    TextFocused( "Mean time (ext.):", TimeToString( m_compare.average[1] ) );
+                    TextFocused( "Mean time (ext.):", TimeToString( times[1]->average ) );
                     ImGui::SameLine();
                     ImGui::Spacing();
                     ImGui::SameLine();
                     TextColoredUnformatted( ImVec4( 0xDD/511.f, 0x22/511.f, 0x22/511.f, 1.f ), ICON_FA_GEM );
                     ImGui::SameLine();
-                    TextFocused( "Median time (ext.):", TimeToString( m_compare.median[1] ) );
-                    if( sorted[1].size() > 1 )
+                    TextFocused( "Median time (ext.):", TimeToString( times[1]->median ) );
+                    if( times[1]->sorted.size() > 1 )
                     {
-                        const auto sz = sorted[1].size();
-                        const auto avg = m_compare.average[1];
+                        const auto sz = times[1]->sorted.size();
+                        const auto avg = times[1]->average;
                         const auto ss = sumSq1 - 2. * total1 * avg + avg * avg * sz;
                         const auto sd = sqrt( ss / ( sz - 1 ) );
 
@@ -1081,4 +1121,156 @@ void View::DrawCompare()
     ImGui::End();
 }
 
+#ifndef TRACY_NO_STATISTICS
+static double GetMedianChange( const ZoneCompareEntry& v )
+{
+    return double( v.median[0] - v.median[1] ) / std::max<int64_t>( v.median[1], 1 );
+}
+
+void View::DrawCompareAllZones()
+{
+    auto& all = m_compare.all;
+
+    ImGui::Separator();
+    if( all.IsRunning() )
+    {
+        if( ImGui::Button( ICON_FA_BAN " Cancel" ) ) all.Cancel();
+        ImGui::SameLine();
+        TextFocused( "Comparing source locations:", RealToString( all.GetProgress() ) );
+        ImGui::SameLine();
+        ImGui::TextDisabled( "/ %s", RealToString( all.GetTotal() ) );
+    }
+    else if( ImGui::Button( ICON_FA_BALANCE_SCALE " Compare all zones" ) )
+    {
+        all.Start( m_worker, *m_compare.second );
+    }
+    ImGui::SameLine();
+    DrawHelpMarker( "Source locations are matched by name, source file and line.\n\nMedian change is the relative difference of the median zone time in this trace to the one in the external trace. Positive values mean that zones in this trace are slower." );
+
+    auto& result = all.GetResult();
+    if( result.empty() ) return;
+
+    ImGui::SameLine();
+    ImGui::Spacing();
+    ImGui::SameLine();
+    TextFocused( "Matched source locations:", RealToString( result.size() ) );
+
+    ImGui::BeginChild( "##compareAll" );
+    if( ImGui::BeginTable( "##compareAll", 7, ImGuiTableFlags_Resizable | ImGuiTableFlags_Reorderable | ImGuiTableFlags_Hideable | ImGuiTableFlags_Sortable | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_ScrollY ) )
+    {
+        ImGui::TableSetupScrollFreeze( 0, 1 );
+        ImGui::TableSetupColumn( "Name", ImGuiTableColumnFlags_NoHide );
+        ImGui::TableSetupColumn( "Location", ImGuiTableColumnFlags_NoSort );
+        ImGui::TableSetupColumn( "Counts", ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_WidthFixed );
+        ImGui::TableSetupColumn( "Median", ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_WidthFixed );
+        ImGui::TableSetupColumn( "90th percentile", ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_WidthFixed );
+        ImGui::TableSetupColumn( "Median change", ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_WidthFixed );
+        ImGui::TableSetupColumn( "Total time change", ImGuiTableColumnFlags_PreferSortDescending | ImGuiTableColumnFlags_WidthFixed );
+        ImGui::TableHeadersRow();
+
+        const auto& sortspec = *ImGui::TableGetSortSpecs()->Specs;
+        const auto asc = sortspec.SortDirection == ImGuiSortDirection_Ascending;
+        auto sortBy = [&result, asc] ( auto&& key ) {
+            if( asc )
+            {
+                pdqsort_branchless( result.begin(), result.end(), [&key]( const auto& lhs, const auto& rhs ) { return key( lhs ) < key( rhs ); } );
+            }
+            else
+            {
+                pdqsort_branchless( result.begin(), result.end(), [&key]( const auto& lhs, const auto& rhs ) { return key( lhs ) > key( rhs ); } );
+            }
+        };
+        switch( sortspec.ColumnIndex )
+        {
+        case 0:
+            if( asc )
+            {
+                pdqsort_branchless( result.begin(), result.end(), [this]( const auto& lhs, const auto& rhs ) { return strcmp( m_worker.GetZoneName( m_worker.GetSourceLocation( lhs.srcloc[0] ) ), m_worker.GetZoneName( m_worker.GetSourceLocation( rhs.srcloc[0] ) ) ) < 0; } );
+            }
+            else
+            {
+                pdqsort_branchless( result.begin(), result.end(), [this]( const auto& lhs, const auto& rhs ) { return strcmp( m_worker.GetZoneName( m_worker.GetSourceLocation( lhs.srcloc[0] ) ), m_worker.GetZoneName( m_worker.GetSourceLocation( rhs.srcloc[0] ) ) ) > 0; } );
+            }
+            break;
+        case 2:
+            sortBy( []( const ZoneCompareEntry& v ) { return v.count[0]; } );
+            break;
+        case 3:
+            sortBy( []( const ZoneCompareEntry& v ) { return v.median[0]; } );
+            break;
+        case 4:
+            sortBy( []( const ZoneCompareEntry& v ) { return v.p90[0]; } );
+            break;
+        case 5:
+            sortBy( []( const ZoneCompareEntry& v ) { return GetMedianChange( v ); } );
+            break;
+        case 6:
+            sortBy( []( const ZoneCompareEntry& v ) { return v.total[0] - v.total[1]; } );
+            break;
+        default:
+            assert( false );
+            break;
+        }
+
+        const ZoneCompareEntry* select = nullptr;
+        ImGuiListClipper clipper;
+        clipper.Begin( result.size() );
+        while( clipper.Step() )
+        {
+            for( auto i=clipper.DisplayStart; i<clipper.DisplayEnd; i++ )
+            {
+                const auto& v = result[i];
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+
+                ImGui::PushID( i );
+                auto& srcloc = m_worker.GetSourceLocation( v.srcloc[0] );
+                SmallColorBox( GetSrcLocColor( srcloc, 0 ) );
+                ImGui::SameLine();
+                if( ImGui::Selectable( m_worker.GetZoneName( srcloc ), false, ImGuiSelectableFlags_SpanAllColumns ) ) select = &v;
+                ImGui::PopID();
+                ImGui::TableNextColumn();
+                TextDisabledUnformatted( LocationToString( m_worker.GetString( srcloc.file ), srcloc.line ) );
+                ImGui::TableNextColumn();
+                ImGui::Text( "%s / %s", RealToString( v.count[0] ), RealToString( v.count[1] ) );
+                ImGui::TableNextColumn();
+                ImGui::Text( "%s / %s", TimeToString( v.median[0] ), TimeToString( v.median[1] ) );
+                ImGui::TableNextColumn();
+                ImGui::Text( "%s / %s", TimeToString( v.p90[0] ), TimeToString( v.p90[1] ) );
+                ImGui::TableNextColumn();
+                const auto change = GetMedianChange( v );
+                if( change > 0 )
+                {
+                    ImGui::TextColored( ImVec4( 1.f, 0.4f, 0.4f, 1.f ), "+%.2f%%", change * 100 );
+                }
+                else
+                {
+                    ImGui::TextColored( ImVec4( 0.4f, 1.f, 0.4f, 1.f ), "%.2f%%", change * 100 );
+                }
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted( TimeToString( v.total[0] - v.total[1] ) );
+            }
+        }
+        ImGui::EndTable();
+
+        if( select )
+        {
+            const auto name = m_worker.GetZoneName( m_worker.GetSourceLocation( select->srcloc[0] ) );
+            const int16_t srcloc[2] = { select->srcloc[0], select->srcloc[1] };
+            m_compare.compareMode = 0;
+            m_compare.Reset();
+            snprintf( m_compare.pattern, sizeof( m_compare.pattern ), "%s", name );
+            FindZonesCompare();
+            for( int k=0; k<2; k++ )
+            {
+                auto& match = m_compare.match[k];
+                auto it = std::find( match.begin(), match.end(), srcloc[k] );
+                if( it != match.end() ) m_compare.selMatch[k] = int( it - match.begin() );
+            }
+        }
+    }
+    ImGui::EndChild();
+}
+#endif
+
 }
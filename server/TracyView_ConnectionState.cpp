@@ -43,6 +43,8 @@ bool View::DrawConnection()
         ImGui::SameLine();
         ImGui::Text( "%.1f%%", m_worker.GetCompRatio() * 100.f );
         ImGui::SameLine();
+        TextDisabledUnformatted( m_worker.HasZstdFrames() ? "(Zstd)" : "(LZ4)" );
+        ImGui::SameLine();
         TextDisabledUnformatted( "Real:" );
         ImGui::SameLine();
         ImGui::Text( "%6.2f Mbps", mbps / m_worker.GetCompRatio() );
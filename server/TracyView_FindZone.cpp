@@ -245,6 +245,23 @@ void View::DrawZoneList( int id, const Vector<short_ptr<ZoneEvent>>& zones )
     ImGui::TreePop();
 }
 
+// Merges adjacent sorted runs pairwise, in parallel. The runs vector holds the run boundaries,
+// starting with 0 and ending with the data size.
+void View::MergeSortedRuns( int64_t* data, std::vector<size_t>& runs )
+{
+    while( runs.size() > 2 )
+    {
+        const auto pairs = ( runs.size() - 1 ) / 2;
+        DispatchChunks( pairs, [data, &runs] ( size_t p ) {
+            std::inplace_merge( data + runs[p*2], data + runs[p*2+1], data + runs[p*2+2] );
+        } );
+        size_t n = 0;
+        for( size_t k=0; k<runs.size(); k+=2 ) runs[n++] = runs[k];
+        if( runs.size() % 2 == 0 ) runs[n++] = runs.back();
+        runs.resize( n );
+    }
+}
+
 void View::DrawFindZone()
 {
     if( m_shortcut == ShortcutAction::OpenFind ) ImGui::SetNextWindowFocus();
@@ -441,80 +458,89 @@ void View::DrawFindZone()
                             else if( t > tmax ) tmax = t;
                         }
                     }
+                    auto mid = vec.begin() + vszorig;
+#ifdef NO_PARALLEL_SORT
+                    pdqsort_branchless( mid, vec.end() );
+#else
+                    std::sort( std::execution::par_unseq, mid, vec.end() );
+#endif
+                    std::inplace_merge( vec.begin(), mid, vec.end() );
                 }
-                else if( m_findZone.selfTime )
+                else
                 {
-                    tmin = zoneData.selfMin;
-                    tmax = zoneData.selfMax;
-                    if( m_findZone.range.active )
+                    // Zone times are collected in chunks of ChunkSize zones, each job writing and
+                    // sorting its own run directly in the destination vector. The runs are then
+                    // compacted and merged with the already sorted data. Context switch lookups
+                    // are not thread safe, so running time is handled above.
+                    const bool selfTime = m_findZone.selfTime;
+                    const bool limitRange = m_findZone.range.active;
+                    if( selfTime )
                     {
-                        for( i=m_findZone.sortedNum; i<zsz; i++ )
-                        {
-                            auto& zone = *zones[i].Zone();
-                            const auto end = zone.End();
-                            const auto start = zone.Start();
-                            if( end > rangeMax || start < rangeMin ) continue;
-                            const auto t = end - start - GetZoneChildTimeFast( zone );
-                            vec.push_back_no_space_check( t );
-                            total += t;
-                        }
+                        tmin = zoneData.selfMin;
+                        tmax = zoneData.selfMax;
                     }
                     else
                     {
-                        for( i=m_findZone.sortedNum; i<zsz; i++ )
-                        {
-                            auto& zone = *zones[i].Zone();
-                            const auto end = zone.End();
-                            const auto t = end - zone.Start() - GetZoneChildTimeFast( zone );
-                            vec.push_back_no_space_check( t );
-                            total += t;
-                        }
+                        tmin = zoneData.min;
+                        tmax = zoneData.max;
                     }
-                }
-                else
-                {
-                    tmin = zoneData.min;
-                    tmax = zoneData.max;
-                    if( m_findZone.range.active )
-                    {
-                        for( i=m_findZone.sortedNum; i<zsz; i++ )
+
+                    const auto first = m_findZone.sortedNum;
+                    i = std::min<size_t>( zsz, first + FindZone::MaxZonesPerFrame );
+                    const auto chunks = ( i - first + FindZone::ChunkSize - 1 ) / FindZone::ChunkSize;
+                    const auto dst = vec.data() + vszorig;
+                    std::vector<size_t> runSize( chunks );
+                    std::vector<int64_t> runTotal( chunks );
+
+                    auto job = [&, first, last = i] ( size_t c ) {
+                        const auto begin = first + c * FindZone::ChunkSize;
+                        const auto end = std::min<size_t>( last, begin + FindZone::ChunkSize );
+                        const auto out = dst + c * FindZone::ChunkSize;
+                        auto ptr = out;
+                        int64_t sum = 0;
+                        for( size_t j=begin; j<end; j++ )
                         {
-                            auto& zone = *zones[i].Zone();
-                            const auto end = zone.End();
-                            const auto start = zone.Start();
-                            if( end > rangeMax || start < rangeMin ) continue;
-                            const auto t = end - start;
-                            vec.push_back_no_space_check( t );
-                            total += t;
+                            auto& zone = *zones[j].Zone();
+                            const auto zend = zone.End();
+                            const auto zstart = zone.Start();
+                            if( limitRange && ( zend > rangeMax || zstart < rangeMin ) ) continue;
+                            auto t = zend - zstart;
+                            if( selfTime ) t -= GetZoneChildTimeFast( zone );
+                            *ptr++ = t;
+                            sum += t;
                         }
-                    }
-                    else
+                        pdqsort_branchless( out, ptr );
+                        runSize[c] = ptr - out;
+                        runTotal[c] = sum;
+                    };
+
+                    DispatchChunks( chunks, job );
+
+                    std::vector<size_t> runs;
+                    runs.reserve( chunks + 2 );
+                    runs.emplace_back( 0 );
+                    if( vszorig != 0 ) runs.emplace_back( vszorig );
+                    auto wr = dst;
+                    for( size_t c=0; c<chunks; c++ )
                     {
-                        for( i=m_findZone.sortedNum; i<zsz; i++ )
-                        {
-                            auto& zone = *zones[i].Zone();
-                            const auto end = zone.End();
-                            const auto t = end - zone.Start();
-                            vec.push_back_no_space_check( t );
-                            total += t;
-                        }
+                        if( runSize[c] == 0 ) continue;
+                        const auto rd = dst + c * FindZone::ChunkSize;
+                        if( wr != rd ) memmove( wr, rd, runSize[c] * sizeof( int64_t ) );
+                        wr += runSize[c];
+                        runs.emplace_back( wr - vec.data() );
+                        total += runTotal[c];
                     }
+                    vec.set_size( wr - vec.data() );
+                    MergeSortedRuns( vec.data(), runs );
                 }
-                auto mid = vec.begin() + vszorig;
-#ifdef NO_PARALLEL_SORT
-                pdqsort_branchless( mid, vec.end() );
-#else
-                std::sort( std::execution::par_unseq, mid, vec.end() );
-#endif
-                std::inplace_merge( vec.begin(), mid, vec.end() );
 
                 const auto vsz = vec.size();
+                m_findZone.sortedNum = i;
                 if( vsz != 0 )
                 {
                     m_findZone.average = float( total ) / vsz;
                     m_findZone.median = vec[vsz/2];
                     m_findZone.total = total;
-                    m_findZone.sortedNum = i;
                     m_findZone.tmin = tmin;
                     m_findZone.tmax = tmax;
                 }
@@ -1891,10 +1917,12 @@ void View::DrawFindZone()
             }
 
             Vector<SymList> data;
+            unordered_flat_map<uint64_t, SymList> inlineMap;
             data.reserve( m_findZone.samples.counts.size() );
             for( auto it: m_findZone.samples.counts ) data.push_back_no_space_check( it );
+            AggregateSamplesStatistics( data, inlineMap, AccumulationMode::SelfOnly );
             int64_t timeRange = ( m_findZone.selGroup != m_findZone.Unselected ) ? m_findZone.selTotal : m_findZone.total;
-            DrawSamplesStatistics( data, timeRange, AccumulationMode::SelfOnly );
+            DrawSamplesStatistics( data, inlineMap, timeRange, AccumulationMode::SelfOnly );
 
             ImGui::TreePop();
         }
@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <inttypes.h>
+
+#include "TracyColor.hpp"
+#include "TracyImGui.hpp"
+#include "TracyMouse.hpp"
+#include "TracyPrint.hpp"
+#include "TracyView.hpp"
+
+namespace tracy
+{
+
+extern double s_time;
+
+const char* View::GetFlameGraphNodeName( uint32_t idx ) const
+{
+    if( idx == 0 ) return "[all]";
+    const auto name = m_flameGraph.graph.GetNodes()[idx].name;
+    if( name == FlameGraph::NoName ) return "[unknown]";
+    return m_worker.GetString( StringIdx( name ) );
+}
+
+void View::DrawFlameGraphNode( uint32_t idx, double x0, double x1, uint32_t depth, const ImVec2& wpos, float rowHeight, uint64_t total )
+{
+    const auto& nodes = m_flameGraph.graph.GetNodes();
+    const auto& node = nodes[idx];
+    const auto y0 = depth * rowHeight;
+
+    const auto tmin = wpos + ImVec2( x0, y0 );
+    const auto tmax = wpos + ImVec2( x1, y0 + rowHeight - 1 );
+    auto draw = ImGui::GetWindowDrawList();
+    const auto color = idx == 0 ? 0xFF666666 : GetHsvColor( node.name, depth );
+    const auto hover = ImGui::IsWindowHovered() && ImGui::IsMouseHoveringRect( tmin, tmax );
+    draw->AddRectFilled( tmin, tmax, hover ? HighlightColor( color ) : color );
+
+    const auto name = GetFlameGraphNodeName( idx );
+    if( x1 - x0 > ImGui::GetTextLineHeight() )
+    {
+        draw->PushClipRect( tmin, tmax, true );
+        DrawTextContrast( draw, tmin + ImVec2( 2, 0 ), 0xFFFFFFFF, name );
+        draw->PopClipRect();
+    }
+
+    if( hover )
+    {
+        ImGui::BeginTooltip();
+        ImGui::TextUnformatted( name );
+        if( m_flameGraph.source == FlameGraph::Source::Samples )
+        {
+            TextFocused( "Samples:", RealToString( node.weight ) );
+        }
+        else
+        {
+            TextFocused( "Zone time:", TimeToString( node.weight ) );
+        }
+        char buf[64];
+        PrintStringPercent( buf, 100. * node.weight / total );
+        TextDisabledUnformatted( buf );
+        ImGui::EndTooltip();
+
+        if( IsMouseClicked( 0 ) ) m_flameGraph.root = idx;
+    }
+
+    if( node.numChildren == 0 || node.weight == 0 ) return;
+    const auto scale = ( x1 - x0 ) / node.weight;
+    auto x = x0;
+    for( uint32_t i=0; i<node.numChildren; i++ )
+    {
+        const auto cidx = node.child + i;
+        const auto w = nodes[cidx].weight * scale;
+        // Children are sorted by weight, the remaining ones are even narrower.
+        if( w < 1 ) break;
+        DrawFlameGraphNode( cidx, x, x + w, depth + 1, wpos, rowHeight, total );
+        x += w;
+    }
+}
+
+void View::DrawFlameGraph()
+{
+    const auto scale = GetScale();
+    ImGui::SetNextWindowSize( ImVec2( 1400 * scale, 800 * scale ), ImGuiCond_FirstUseEver );
+    ImGui::Begin( "Flame graph", &m_flameGraph.show, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse );
+    if( ImGui::GetCurrentWindowRead()->SkipItems ) { ImGui::End(); return; }
+
+    auto& fg = m_flameGraph;
+    if( fg.graph.Update( m_worker ) ) fg.root = 0;
+
+    bool rebuild = !fg.built;
+    ImGui::PushStyleVar( ImGuiStyleVar_FramePadding, ImVec2( 2, 2 ) );
+    TextDisabledUnformatted( "Source:" );
+    ImGui::SameLine();
+    if( ImGui::RadioButton( "Samples", fg.source == FlameGraph::Source::Samples ) )
+    {
+        fg.source = FlameGraph::Source::Samples;
+        rebuild = true;
+    }
+    ImGui::SameLine();
+    if( ImGui::RadioButton( "Zone call stacks", fg.source == FlameGraph::Source::Zones ) )
+    {
+        fg.source = FlameGraph::Source::Zones;
+        rebuild = true;
+    }
+    ImGui::SameLine();
+    ImGui::Spacing();
+    ImGui::SameLine();
+    if( ButtonDisablable( ICON_FA_REDO " Rebuild", fg.graph.IsBuilding() ) ) rebuild = true;
+    ImGui::SameLine();
+    if( ButtonDisablable( ICON_FA_SEARCH_MINUS " Reset zoom", fg.root == 0 ) ) fg.root = 0;
+    ImGui::SameLine();
+    DrawHelpMarker( "Click on a function to zoom in. Click on a function above the zoomed one to zoom out.\nZone call stacks are weighted by zone time." );
+    ImGui::PopStyleVar();
+
+    if( rebuild )
+    {
+        fg.graph.Build( m_worker, fg.source );
+        fg.built = true;
+    }
+
+    ImGui::Separator();
+    const auto& nodes = fg.graph.GetNodes();
+    if( nodes.empty() )
+    {
+        ImGui::TextWrapped( "Please wait, computing data..." );
+        DrawWaitingDots( s_time );
+        ImGui::End();
+        return;
+    }
+    if( nodes[0].weight == 0 )
+    {
+        ImGui::TextUnformatted( "No call stack data collected." );
+        ImGui::End();
+        return;
+    }
+
+    ImGui::BeginChild( "##flameGraph" );
+    const auto rowHeight = ImGui::GetTextLineHeight() + 2;
+    const auto wpos = ImGui::GetCursorScreenPos();
+    const auto w = ImGui::GetContentRegionAvail().x;
+
+    // The zoomed node and its parents are drawn at full width.
+    std::vector<uint32_t> chain;
+    for( auto n = fg.root; n != 0; n = nodes[n].parent ) chain.push_back( n );
+    chain.push_back( 0 );
+    std::reverse( chain.begin(), chain.end() );
+    const auto total = nodes[0].weight;
+    for( size_t i=0; i<chain.size()-1; i++ )
+    {
+        const auto& node = nodes[chain[i]];
+        const auto tmin = wpos + ImVec2( 0, i * rowHeight );
+        const auto tmax = wpos + ImVec2( w, ( i + 1 ) * rowHeight - 1 );
+        auto draw = ImGui::GetWindowDrawList();
+        const auto color = chain[i] == 0 ? 0xFF666666 : GetHsvColor( node.name, i );
+        const auto hover = ImGui::IsWindowHovered() && ImGui::IsMouseHoveringRect( tmin, tmax );
+        draw->AddRectFilled( tmin, tmax, DarkenColor( hover ? HighlightColor( color ) : color ) );
+        draw->PushClipRect( tmin, tmax, true );
+        DrawTextContrast( draw, tmin + ImVec2( 2, 0 ), 0xFFFFFFFF, GetFlameGraphNodeName( chain[i] ) );
+        draw->PopClipRect();
+        if( hover && IsMouseClicked( 0 ) ) fg.root = chain[i];
+    }
+    const auto depth = uint32_t( chain.size() - 1 );
+    DrawFlameGraphNode( fg.root, 0, w, depth, wpos, rowHeight, total );
+
+    ImGui::Dummy( ImVec2( w, ( fg.graph.GetMaxDepth() + 1 ) * rowHeight ) );
+    ImGui::EndChild();
+    ImGui::End();
+}
+
+}
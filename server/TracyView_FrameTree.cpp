@@ -58,88 +58,55 @@ unordered_flat_map<uint32_t, View::MemPathData> View::GetCallstackPaths( const M
     unordered_flat_map<uint32_t, MemPathData> pathSum;
     pathSum.reserve( m_worker.GetCallstackPayloadCount() );
 
+    auto AddPath = [&pathSum] ( const MemEvent& ev ) {
+        if( ev.CsAlloc() == 0 ) return;
+        auto it = pathSum.find( ev.CsAlloc() );
+        if( it == pathSum.end() )
+        {
+            pathSum.emplace( ev.CsAlloc(), MemPathData { 1, ev.Size() } );
+        }
+        else
+        {
+            it->second.cnt++;
+            it->second.mem += ev.Size();
+        }
+    };
+
+    size_t first = 0;
+    size_t last = mem.data.size();
+    int64_t time = std::numeric_limits<int64_t>::max();
     if( m_memInfo.range.active )
     {
         auto it = std::lower_bound( mem.data.begin(), mem.data.end(), m_memInfo.range.min, []( const auto& lhs, const auto& rhs ) { return lhs.TimeAlloc() < rhs; } );
-        if( it != mem.data.end() )
-        {
-            auto end = std::lower_bound( mem.data.begin(), mem.data.end(), m_memInfo.range.max, []( const auto& lhs, const auto& rhs ) { return lhs.TimeAlloc() < rhs; } );
-            if( memRange != MemRange::Full )
-            {
-                while( it != end )
-                {
-                    auto& ev = *it++;
-                    if( ev.CsAlloc() == 0 ) continue;
-                    if( ( memRange == MemRange::Inactive ) == ( ev.TimeFree() >= 0 && ev.TimeFree() < m_memInfo.range.max ) ) continue;
-                    auto pit = pathSum.find( ev.CsAlloc() );
-                    if( pit == pathSum.end() )
-                    {
-                        pathSum.emplace( ev.CsAlloc(), MemPathData { 1, ev.Size() } );
-                    }
-                    else
-                    {
-                        pit->second.cnt++;
-                        pit->second.mem += ev.Size();
-                    }
-                }
-            }
-            else
-            {
-                while( it != end )
-                {
-                    auto& ev = *it++;
-                    if( ev.CsAlloc() == 0 ) continue;
-                    auto pit = pathSum.find( ev.CsAlloc() );
-                    if( pit == pathSum.end() )
-                    {
-                        pathSum.emplace( ev.CsAlloc(), MemPathData { 1, ev.Size() } );
-                    }
-                    else
-                    {
-                        pit->second.cnt++;
-                        pit->second.mem += ev.Size();
-                    }
-                }
-            }
-        }
+        auto end = std::lower_bound( it, mem.data.end(), m_memInfo.range.max, []( const auto& lhs, const auto& rhs ) { return lhs.TimeAlloc() < rhs; } );
+        first = std::distance( mem.data.begin(), it );
+        last = std::distance( mem.data.begin(), end );
+        time = m_memInfo.range.max;
     }
-    else
+
+    switch( memRange )
     {
-        if( memRange != MemRange::Full )
-        {
-            for( auto& ev : mem.data )
-            {
-                if( ev.CsAlloc() == 0 ) continue;
-                if( ( memRange == MemRange::Inactive ) == ( ev.TimeFree() >= 0 ) ) continue;
-                auto it = pathSum.find( ev.CsAlloc() );
-                if( it == pathSum.end() )
-                {
-                    pathSum.emplace( ev.CsAlloc(), MemPathData { 1, ev.Size() } );
-                }
-                else
-                {
-                    it->second.cnt++;
-                    it->second.mem += ev.Size();
-                }
-            }
-        }
-        else
+    case MemRange::Full:
+        for( size_t i=first; i<last; i++ ) AddPath( mem.data[i] );
+        break;
+    case MemRange::Active:
+    {
+        std::vector<const MemEvent*> active;
+        Worker::GetMemActiveAt( mem, first, last, time, active );
+        for( auto& ev : active ) AddPath( *ev );
+        break;
+    }
+    case MemRange::Inactive:
+        for( size_t i=first; i<last; i++ )
         {
-            for( auto& ev : mem.data )
-            {
-                if( ev.CsAlloc() == 0 ) continue;
-                auto it = pathSum.find( ev.CsAlloc() );
-                if( it == pathSum.end() )
-                {
-                    pathSum.emplace( ev.CsAlloc(), MemPathData { 1, ev.Size() } );
-                }
-                else
-                {
-                    it->second.cnt++;
-                    it->second.mem += ev.Size();
-                }
-            }
+            auto& ev = mem.data[i];
+            const auto tf = ev.TimeFree();
+            if( tf >= 0 && tf < time ) AddPath( ev );
         }
+        break;
+    default:
+        assert( false );
+        break;
     }
     return pathSum;
 }
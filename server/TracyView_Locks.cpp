@@ -244,6 +244,25 @@ static Vector<LockEventPtr>::const_iterator GetNextLockEventShared( const Vector
     return next;
 }
 
+// A thread which does not wait for the lock (and does not hold it) can change its lock state only
+// with its own event, so the events of other threads in between do not need to be checked.
+static Vector<LockEventPtr>::const_iterator SkipToThreadEvent( const LockMap& lockmap, const Vector<LockEventPtr>::const_iterator& it, const Vector<LockEventPtr>::const_iterator& end, uint8_t thread )
+{
+    auto wait = it->waitList;
+    if( lockmap.type == LockType::SharedLockable )
+    {
+        const auto ptr = (const LockEventShared*)(const LockEvent*)it->ptr;
+        wait |= ptr->waitShared | ptr->sharedList;
+    }
+    if( IsThreadWaiting( wait, GetThreadBit( thread ) ) ) return it;
+
+    const auto& events = lockmap.threadEvents[thread];
+    const auto pos = uint32_t( it - lockmap.timeline.begin() );
+    const auto next = std::upper_bound( events.begin(), events.end(), pos );
+    if( next == events.end() ) return end;
+    return std::min( end, lockmap.timeline.begin() + *next - 1 );
+}
+
 static LockState CombineLockState( LockState state, LockState next )
 {
     return (LockState)std::max( (int)state, (int)next );
@@ -448,6 +467,11 @@ int View::DrawLocks( uint64_t tid, bool hover, double pxns, const ImVec2& wpos,
                 {
                     while( vbegin < vend && ( state == LockState::Nothing || state == LockState::HasLock ) )
                     {
+                        if( state == LockState::Nothing )
+                        {
+                            vbegin = SkipToThreadEvent( lockmap, vbegin, vend, thread );
+                            if( vbegin >= vend ) break;
+                        }
                         vbegin = GetNextLockFunc( vbegin, vend, state, threadBit );
                     }
                 }
@@ -455,6 +479,8 @@ int View::DrawLocks( uint64_t tid, bool hover, double pxns, const ImVec2& wpos,
                 {
                     while( vbegin < vend && state == LockState::Nothing )
                     {
+                        vbegin = SkipToThreadEvent( lockmap, vbegin, vend, thread );
+                        if( vbegin >= vend ) break;
                         vbegin = GetNextLockFunc( vbegin, vend, state, threadBit );
                     }
                 }
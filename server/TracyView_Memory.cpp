@@ -8,12 +8,6 @@
 namespace tracy
 {
 
-enum { ChunkBits = 10 };
-enum { PageBits = 10 };
-enum { PageSize = 1 << PageBits };
-enum { PageChunkBits = ChunkBits + PageBits };
-enum { PageChunkSize = 1 << PageChunkBits };
-
 uint32_t MemDecayColor[256] = {
     0x0, 0xFF077F07, 0xFF078007, 0xFF078207, 0xFF078307, 0xFF078507, 0xFF078707, 0xFF078807,
     0xFF078A07, 0xFF078B07, 0xFF078D07, 0xFF078F07, 0xFF079007, 0xFF089208, 0xFF089308, 0xFF089508,
@@ -109,13 +103,13 @@ std::vector<MemoryPage> View::GetMemoryPages() const
 {
     std::vector<MemoryPage> ret;
 
-    static unordered_flat_map<uint64_t, MemoryPage> memmap;
-
-    const auto& mem = m_worker.GetMemoryNamed( m_memInfo.pool );
-    const auto memlow = mem.low;
-
     if( m_memInfo.range.active )
     {
+        unordered_flat_map<uint64_t, MemoryPage> memmap;
+
+        const auto& mem = m_worker.GetMemoryNamed( m_memInfo.pool );
+        const auto memlow = mem.low;
+
         auto it = std::lower_bound( mem.data.begin(), mem.data.end(), m_memInfo.range.min, []( const auto& lhs, const auto& rhs ) { return lhs.TimeAlloc() < rhs; } );
         if( it != mem.data.end() )
         {
@@ -138,33 +132,27 @@ std::vector<MemoryPage> View::GetMemoryPages() const
                 FillPages( memmap, c0, c1, val );
             }
         }
+
+        std::vector<unordered_flat_map<uint64_t, MemoryPage>::const_iterator> itmap;
+        itmap.reserve( memmap.size() );
+        ret.reserve( memmap.size() );
+        for( auto it = memmap.begin(); it != memmap.end(); ++it ) itmap.emplace_back( it );
+        pdqsort_branchless( itmap.begin(), itmap.end(), []( const auto& lhs, const auto& rhs ) { return lhs->second.page < rhs->second.page; } );
+        for( auto& v : itmap ) ret.emplace_back( v->second );
     }
     else
     {
+        const auto& map = m_memInfo.map;
         const auto lastTime = m_worker.GetLastTime();
-        for( auto& alloc : mem.data )
+        const auto num = map.GetPageCount();
+        ret.resize( num );
+        for( size_t i=0; i<num; i++ )
         {
-            const auto a0 = alloc.Ptr() - memlow;
-            const auto a1 = a0 + alloc.Size();
-            const int8_t val = alloc.TimeFree() < 0 ?
-                int8_t( std::max( int64_t( 1 ), 127 - ( ( lastTime - std::min( lastTime, alloc.TimeAlloc() ) ) >> 24 ) ) ) :
-                int8_t( -std::max( int64_t( 1 ), 127 - ( ( lastTime - std::min( lastTime, alloc.TimeFree() ) ) >> 24 ) ) );
-
-            const auto c0 = a0 >> ChunkBits;
-            const auto c1 = a1 >> ChunkBits;
-
-            FillPages( memmap, c0, c1, val );
+            ret[i].page = map.GetPageAddress( i );
+            map.GetPageDecay( i, lastTime, ret[i].data );
         }
     }
 
-    std::vector<unordered_flat_map<uint64_t, MemoryPage>::const_iterator> itmap;
-    itmap.reserve( memmap.size() );
-    ret.reserve( memmap.size() );
-    for( auto it = memmap.begin(); it != memmap.end(); ++it ) itmap.emplace_back( it );
-    pdqsort_branchless( itmap.begin(), itmap.end(), []( const auto& lhs, const auto& rhs ) { return lhs->second.page < rhs->second.page; } );
-    for( auto& v : itmap ) ret.emplace_back( v->second );
-
-    memmap.clear();
     return ret;
 }
 
@@ -328,20 +316,9 @@ void View::DrawMemory()
         if( m_memInfo.range.active )
         {
             auto it = std::lower_bound( mem.data.begin(), mem.data.end(), m_memInfo.range.min, [] ( const auto& lhs, const auto& rhs ) { return lhs.TimeAlloc() < rhs; } );
-            if( it != mem.data.end() )
-            {
-                auto end = std::lower_bound( it, mem.data.end(), m_memInfo.range.max, [] ( const auto& lhs, const auto& rhs ) { return lhs.TimeAlloc() < rhs; } );
-                while( it != end )
-                {
-                    const auto tf = it->TimeFree();
-                    if( tf < 0 || tf >= m_memInfo.range.max )
-                    {
-                        items.emplace_back( it );
-                        total += it->Size();
-                    }
-                    ++it;
-                }
-            }
+            auto end = std::lower_bound( it, mem.data.end(), m_memInfo.range.max, [] ( const auto& lhs, const auto& rhs ) { return lhs.TimeAlloc() < rhs; } );
+            Worker::GetMemActiveAt( mem, std::distance( mem.data.begin(), it ), std::distance( mem.data.begin(), end ), m_memInfo.range.max, items );
+            for( auto& v : items ) total += v->Size();
         }
         else
         {
@@ -383,6 +360,19 @@ void View::DrawMemory()
         ImGui::SameLine();
         TextFocused( "Single line:", MemSizeToString( PageChunkSize ) );
 
+        if( !m_memInfo.range.active )
+        {
+            m_memInfo.map.Update( m_worker, m_memInfo.pool );
+            if( m_memInfo.map.IsBuilding() )
+            {
+                ImGui::SameLine();
+                ImGui::Spacing();
+                ImGui::SameLine();
+                TextColoredUnformatted( 0xFF00FFFF, ICON_FA_HOURGLASS_HALF );
+                TooltipIfHovered( "Please wait, processing data..." );
+            }
+        }
+
         auto pages = GetMemoryPages();
         const size_t lines = pages.size();
 
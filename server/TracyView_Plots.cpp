@@ -174,6 +174,7 @@ int View::DrawPlots( int offset, double pxns, const ImVec2& wpos, bool hover, fl
             {
                 auto& vec = v->data;
                 vec.ensure_sorted();
+                m_worker.UpdatePlotLod( *v );
 
                 const auto color = GetPlotColor( v );
                 const auto bg = 0x22000000 | ( DarkenColorMore( color ) & 0xFFFFFF );
@@ -187,25 +188,10 @@ int View::DrawPlots( int offset, double pxns, const ImVec2& wpos, bool hover, fl
                 if( end != vec.end() ) end++;
                 if( it != vec.begin() ) it--;
 
-                double min = it->val;
-                double max = it->val;
+                const auto visible = m_worker.GetPlotRange( *v, it - vec.begin(), end - vec.begin() );
+                double min = visible.min;
+                double max = visible.max;
                 const auto num = std::distance( it, end );
-                if( num > 1000000 )
-                {
-                    min = v->min;
-                    max = v->max;
-                }
-                else
-                {
-                    auto tmp = it;
-                    ++tmp;
-                    const auto sz = end - tmp;
-                    for( ptrdiff_t i=0; i<sz; i++ )
-                    {
-                        min = tmp[i].val < min ? tmp[i].val : min;
-                        max = tmp[i].val > max ? tmp[i].val : max;
-                    }
-                }
                 if( min == max )
                 {
                     min--;
@@ -293,40 +279,38 @@ int View::DrawPlots( int offset, double pxns, const ImVec2& wpos, bool hover, fl
                     else
                     {
                         prevx = it;
-
                         skip = rsz / MaxPoints;
-                        const auto skip1 = std::max<ptrdiff_t>( 1, skip );
-                        const auto sz = rsz / skip1 + 1;
-                        assert( sz <= MaxPoints*2 );
-
-                        auto dst = tmpvec;
-                        const auto rsz = std::distance( it, range );
-                        const auto ssz = rsz / skip1;
-                        for( int64_t i=0; i<ssz; i++ )
-                        {
-                            *dst++ = float( it->val );
-                            it += skip1;
-                        }
-                        pdqsort_branchless( tmpvec, dst );
 
                         if( rsz > MaxPoints )
                         {
-                            DrawLine( draw, dpos + ImVec2( x1, offset + PlotHeight - ( tmpvec[0] - min ) * revrange * PlotHeight ), dpos + ImVec2( x1, offset + PlotHeight - ( dst[-1] - min ) * revrange * PlotHeight ), color, 4.f );
+                            const auto lod = m_worker.GetPlotRange( *v, it - vec.begin(), range - vec.begin() );
+                            it = range;
+
+                            DrawLine( draw, dpos + ImVec2( x1, offset + PlotHeight - ( lod.min - min ) * revrange * PlotHeight ), dpos + ImVec2( x1, offset + PlotHeight - ( lod.max - min ) * revrange * PlotHeight ), color, 4.f );
 
                             if( hover && ImGui::IsMouseHoveringRect( wpos + ImVec2( x1 - 2, offset ), wpos + ImVec2( x1 + 2, offset + PlotHeight ) ) )
                             {
                                 ImGui::BeginTooltip();
                                 TextFocused( "Number of values:", RealToString( rsz ) );
-                                TextDisabledUnformatted( "Estimated range:" );
+                                TextDisabledUnformatted( "Range:" );
                                 ImGui::SameLine();
-                                ImGui::Text( "%s - %s", FormatPlotValue( tmpvec[0], v->format ), FormatPlotValue( dst[-1], v->format ) );
+                                ImGui::Text( "%s - %s", FormatPlotValue( lod.min, v->format ), FormatPlotValue( lod.max, v->format ) );
                                 ImGui::SameLine();
-                                ImGui::TextDisabled( "(%s)", FormatPlotValue( dst[-1] - tmpvec[0], v->format ) );
+                                ImGui::TextDisabled( "(%s)", FormatPlotValue( lod.max - lod.min, v->format ) );
+                                TextFocused( "Average:", FormatPlotValue( lod.sum / rsz, v->format ) );
                                 ImGui::EndTooltip();
                             }
                         }
                         else
                         {
+                            auto dst = tmpvec;
+                            for( ptrdiff_t i=0; i<rsz; i++ )
+                            {
+                                *dst++ = float( it->val );
+                                ++it;
+                            }
+                            pdqsort_branchless( tmpvec, dst );
+
                             DrawLine( draw, dpos + ImVec2( x1, offset + PlotHeight - ( tmpvec[0] - min ) * revrange * PlotHeight ), dpos + ImVec2( x1, offset + PlotHeight - ( dst[-1] - min ) * revrange * PlotHeight ), color );
 
                             auto vit = tmpvec;
@@ -93,40 +93,213 @@ void View::DrawSamples( const Vector<SampleData>& vec, bool hover, double pxns,
     }
 }
 
-void View::DrawSamplesStatistics( Vector<SymList>& data, int64_t timeRange, AccumulationMode accumulationMode )
+void View::UpdateSampleStatistics()
 {
-    static unordered_flat_map<uint64_t, SymList> inlineMap;
-    assert( inlineMap.empty() );
-    if( !m_statSeparateInlines )
+    auto& cache = m_sampleStats;
+    const auto& symMap = m_worker.GetSymbolMap();
+    const auto& symStat = m_worker.GetSymbolStats();
+    const auto symbolCount = m_showAllSymbols ? symMap.size() : symStat.size();
+    const auto sampleCount = m_worker.GetCallstackSampleCount();
+
+    const bool sameQuery = cache.valid &&
+        cache.range == m_statRange &&
+        cache.accumulationMode == m_statAccumulationMode &&
+        cache.showAll == m_showAllSymbols &&
+        cache.separateInlines == m_statSeparateInlines &&
+        cache.showKernel == m_statShowKernel &&
+        cache.symbolCount == symbolCount &&
+        cache.filter == m_statisticsFilter.InputBuf &&
+        cache.imageFilter == m_statisticsImageFilter.InputBuf;
+    if( sameQuery && cache.sampleCount == sampleCount ) return;
+
+    // Symbol lookups below are done from worker threads and must not trigger postponed work.
+    m_worker.DoPostponedSymbols();
+
+    if( !sameQuery )
     {
-        static unordered_flat_map<uint64_t, SymList> baseMap;
-        assert( baseMap.empty() );
-        for( auto& v : data )
+        cache.valid = true;
+        cache.range = m_statRange;
+        cache.accumulationMode = m_statAccumulationMode;
+        cache.showAll = m_showAllSymbols;
+        cache.separateInlines = m_statSeparateInlines;
+        cache.showKernel = m_statShowKernel;
+        cache.symbolCount = symbolCount;
+        cache.filter = m_statisticsFilter.InputBuf;
+        cache.imageFilter = m_statisticsImageFilter.InputBuf;
+
+        cache.raw.clear();
+        cache.raw.reserve( symbolCount );
+        if( m_showAllSymbols )
         {
-            auto sym = m_worker.GetSymbolData( v.symAddr );
-            const auto symAddr = ( sym && sym->isInline ) ? m_worker.GetSymbolForAddress( v.symAddr ) : v.symAddr;
-            auto it = baseMap.find( symAddr );
-            if( it == baseMap.end() )
+            for( auto& v : symMap ) cache.raw.push_back_no_space_check( SymList { v.first, 0, 0 } );
+        }
+        else
+        {
+            for( auto& v : symStat ) cache.raw.push_back_no_space_check( SymList { v.first, 0, 0 } );
+        }
+
+        if( m_statisticsFilter.IsActive() || m_statisticsImageFilter.IsActive() || !m_statShowKernel )
+        {
+            // Each chunk marks rejected symbols, the list is compacted afterwards.
+            const auto num = cache.raw.size();
+            const auto chunks = ( num + SampleStatChunkSize - 1 ) / SampleStatChunkSize;
+            std::function<void(size_t)> job = [this, &cache, &symMap, num] ( size_t c ) {
+                const auto end = std::min<size_t>( num, ( c + 1 ) * SampleStatChunkSize );
+                for( size_t i=c*SampleStatChunkSize; i<end; i++ )
+                {
+                    auto& v = cache.raw[i];
+                    auto sit = symMap.find( v.symAddr );
+                    bool pass = false;
+                    if( sit != symMap.end() )
+                    {
+                        const auto name = m_worker.GetString( sit->second.name );
+                        const auto image = m_worker.GetString( sit->second.imageName );
+                        pass = ( m_statShowKernel || ( v.symAddr >> 63 ) == 0 ) && m_statisticsFilter.PassFilter( name ) && m_statisticsImageFilter.PassFilter( image );
+                        if( !pass && sit->second.size.Val() == 0 )
+                        {
+                            const auto parentAddr = m_worker.GetSymbolForAddress( v.symAddr );
+                            if( parentAddr != 0 )
+                            {
+                                auto pit = symMap.find( parentAddr );
+                                if( pit != symMap.end() )
+                                {
+                                    const auto parentName = m_worker.GetString( pit->second.name );
+                                    pass = ( m_statShowKernel || ( parentAddr >> 63 ) == 0 ) && m_statisticsFilter.PassFilter( parentName ) && m_statisticsImageFilter.PassFilter( image );
+                                }
+                            }
+                        }
+                    }
+                    v.count = pass ? 0 : 1;
+                }
+            };
+            DispatchChunks( chunks, job );
+            auto dst = cache.raw.begin();
+            for( auto& v : cache.raw ) if( v.count == 0 ) *dst++ = v;
+            cache.raw.set_size( std::distance( cache.raw.begin(), dst ) );
+        }
+    }
+    cache.sampleCount = sampleCount;
+
+    // Sample counts are refreshed in place for the cached symbol list. This is all that needs to be
+    // done when new samples arrive during a live capture.
+    {
+        const auto num = cache.raw.size();
+        const auto chunks = ( num + SampleStatChunkSize - 1 ) / SampleStatChunkSize;
+        const auto range = cache.range;
+        std::function<void(size_t)> job = [this, &cache, &symStat, num, range] ( size_t c ) {
+            const auto end = std::min<size_t>( num, ( c + 1 ) * SampleStatChunkSize );
+            for( size_t i=c*SampleStatChunkSize; i<end; i++ )
             {
-                baseMap.emplace( symAddr, SymList { symAddr, v.incl, v.excl, 0 } );
+                auto& v = cache.raw[i];
+                v.incl = v.excl = v.count = 0;
+                if( range.active )
+                {
+                    auto samples = m_worker.GetSamplesForSymbol( v.symAddr );
+                    if( samples )
+                    {
+                        auto it = std::lower_bound( samples->begin(), samples->end(), range.min, [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs; } );
+                        auto end = std::lower_bound( it, samples->end(), range.max, [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs; } );
+                        v.excl = uint32_t( end - it );
+                    }
+                }
+                else
+                {
+                    auto it = symStat.find( v.symAddr );
+                    if( it != symStat.end() )
+                    {
+                        v.incl = it->second.incl;
+                        v.excl = it->second.excl;
+                    }
+                }
             }
-            else
+        };
+        DispatchChunks( chunks, job );
+    }
+
+    cache.data.clear();
+    cache.data.reserve( cache.raw.size() );
+    for( auto& v : cache.raw )
+    {
+        if( m_showAllSymbols || v.incl != 0 || v.excl != 0 ) cache.data.push_back_no_space_check( v );
+    }
+    AggregateSamplesStatistics( cache.data, cache.inlineMap, m_statAccumulationMode );
+}
+
+void View::AggregateSamplesStatistics( Vector<SymList>& data, unordered_flat_map<uint64_t, SymList>& inlineMap, AccumulationMode accumulationMode )
+{
+    inlineMap.clear();
+    if( !m_statSeparateInlines )
+    {
+        // Inline symbols are folded into their parent function using partial maps for each chunk
+        // of the list, which are then merged.
+        m_worker.DoPostponedSymbols();
+        const auto num = data.size();
+        const auto chunks = ( num + SampleStatChunkSize - 1 ) / SampleStatChunkSize;
+        std::vector<unordered_flat_map<uint64_t, SymList>> partial( chunks );
+        std::function<void(size_t)> job = [this, &data, &partial, num] ( size_t c ) {
+            auto& baseMap = partial[c];
+            const auto end = std::min<size_t>( num, ( c + 1 ) * SampleStatChunkSize );
+            for( size_t i=c*SampleStatChunkSize; i<end; i++ )
+            {
+                auto& v = data[i];
+                auto sym = m_worker.GetSymbolData( v.symAddr );
+                const auto symAddr = ( sym && sym->isInline ) ? m_worker.GetSymbolForAddress( v.symAddr ) : v.symAddr;
+                auto it = baseMap.find( symAddr );
+                if( it == baseMap.end() )
+                {
+                    baseMap.emplace( symAddr, SymList { symAddr, v.incl, v.excl, 0 } );
+                }
+                else
+                {
+                    assert( symAddr == it->second.symAddr );
+                    it->second.incl += v.incl;
+                    it->second.excl += v.excl;
+                    it->second.count++;
+                }
+            }
+        };
+        DispatchChunks( chunks, job );
+
+        for( size_t c=1; c<chunks; c++ )
+        {
+            for( auto& v : partial[c] )
             {
-                assert( symAddr == it->second.symAddr );
-                it->second.incl += v.incl;
-                it->second.excl += v.excl;
-                it->second.count++;
+                auto it = partial[0].find( v.first );
+                if( it == partial[0].end() )
+                {
+                    partial[0].emplace( v.first, v.second );
+                }
+                else
+                {
+                    it->second.incl += v.second.incl;
+                    it->second.excl += v.second.excl;
+                    it->second.count += v.second.count + 1;
+                }
             }
         }
+
+        inlineMap.reserve( num );
         for( auto& v : data ) inlineMap.emplace( v.symAddr, SymList { v.symAddr, v.incl, v.excl, v.count } );
         data.clear();
-        for( auto& v : baseMap )
+        if( chunks != 0 )
         {
-            data.push_back_no_space_check( v.second );
+            data.reserve( partial[0].size() );
+            for( auto& v : partial[0] ) data.push_back_no_space_check( v.second );
         }
-        baseMap.clear();
     }
 
+    if( accumulationMode == AccumulationMode::SelfOnly )
+    {
+        pdqsort_branchless( data.begin(), data.end(), []( const auto& l, const auto& r ) { return l.excl != r.excl ? l.excl > r.excl : l.symAddr < r.symAddr; } );
+    }
+    else
+    {
+        pdqsort_branchless( data.begin(), data.end(), []( const auto& l, const auto& r ) { return l.incl != r.incl ? l.incl > r.incl : l.symAddr < r.symAddr; } );
+    }
+}
+
+void View::DrawSamplesStatistics( const Vector<SymList>& data, const unordered_flat_map<uint64_t, SymList>& inlineMap, int64_t timeRange, AccumulationMode accumulationMode )
+{
     if( data.empty() )
     {
         ImGui::TextUnformatted( "No entries to be displayed." );
@@ -135,15 +308,6 @@ void View::DrawSamplesStatistics( Vector<SymList>& data, int64_t timeRange, Accu
     {
         const auto& symMap = m_worker.GetSymbolMap();
 
-        if( accumulationMode == AccumulationMode::SelfOnly )
-        {
-            pdqsort_branchless( data.begin(), data.end(), []( const auto& l, const auto& r ) { return l.excl != r.excl ? l.excl > r.excl : l.symAddr < r.symAddr; } );
-        }
-        else
-        {
-            pdqsort_branchless( data.begin(), data.end(), []( const auto& l, const auto& r ) { return l.incl != r.incl ? l.incl > r.incl : l.symAddr < r.symAddr; } );
-        }
-
         ImGui::BeginChild( "##statisticsSampling" );
         if( ImGui::BeginTable( "##statisticsSampling", 5, ImGuiTableFlags_Resizable | ImGuiTableFlags_Reorderable | ImGuiTableFlags_Hideable | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_ScrollY ) )
         {
@@ -572,8 +736,6 @@ void View::DrawSamplesStatistics( Vector<SymList>& data, int64_t timeRange, Accu
             ImGui::EndTable();
         }
         ImGui::EndChild();
-
-        inlineMap.clear();
     }
 }
 
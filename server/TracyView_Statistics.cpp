@@ -40,7 +40,7 @@ void View::DrawStatistics()
     ImGui::TextWrapped( "Collection of statistical data is disabled in this build." );
     ImGui::TextWrapped( "Rebuild without the TRACY_NO_STATISTICS macro to enable statistics view." );
 #else
-    if( !m_worker.AreSourceLocationZonesReady() && ( !m_worker.AreCallstackSamplesReady() || m_worker.GetCallstackSampleCount() == 0 ) )
+    if( !m_worker.AreSourceLocationStatisticsReady() && ( !m_worker.AreCallstackSamplesReady() || m_worker.GetCallstackSampleCount() == 0 ) )
     {
         ImGui::TextWrapped( "Please wait, computing data..." );
         DrawWaitingDots( s_time );
@@ -86,7 +86,8 @@ void View::DrawStatistics()
 
     if( m_statMode == 0 )
     {
-        if( !m_worker.AreSourceLocationZonesReady() )
+        // Limiting the range requires the zone lists, the whole trace is covered by the aggregates.
+        if( m_statRange.active ? !m_worker.AreSourceLocationZonesReady() : !m_worker.AreSourceLocationStatisticsReady() )
         {
             ImGui::Spacing();
             ImGui::Separator();
@@ -215,11 +216,11 @@ void View::DrawStatistics()
                     switch( m_statAccumulationMode )
                     {
                     case AccumulationMode::SelfOnly:
-                        count = it->second.zones.size();
+                        count = m_worker.GetZoneCount( it->second );
                         total = it->second.selfTotal;
                         break;
                     case AccumulationMode::AllChildren:
-                        count = it->second.zones.size();
+                        count = m_worker.GetZoneCount( it->second );
                         total = it->second.total;
                         break;
                     case AccumulationMode::NonReentrantChildren:
@@ -299,7 +300,7 @@ void View::DrawStatistics()
     else
     {
         assert( m_statMode == 2 );
-        if( !m_worker.AreGpuSourceLocationZonesReady() )
+        if( m_statRange.active ? !m_worker.AreGpuSourceLocationZonesReady() : !m_worker.AreGpuSourceLocationStatisticsReady() )
         {
             ImGui::Spacing();
             ImGui::Separator();
@@ -407,7 +408,7 @@ void View::DrawStatistics()
                 if( it->second.total != 0 )
                 {
                     slzcnt++;
-                    size_t count = it->second.zones.size();
+                    size_t count = m_worker.GetZoneCount( it->second );
                     int64_t total = it->second.total;
                     if( !filterActive )
                     {
@@ -679,193 +680,8 @@ void View::DrawStatistics()
     else
     {
         assert( m_statMode == 1 );
-        const auto& symMap = m_worker.GetSymbolMap();
-        const auto& symStat = m_worker.GetSymbolStats();
-
-        Vector<SymList> data;
-        if( m_showAllSymbols )
-        {
-            data.reserve( symMap.size() );
-            if( m_statisticsFilter.IsActive() || m_statisticsImageFilter.IsActive() || !m_statShowKernel )
-            {
-                for( auto& v : symMap )
-                {
-                    const auto name = m_worker.GetString( v.second.name );
-                    const auto image = m_worker.GetString( v.second.imageName );
-                    bool pass = ( m_statShowKernel || ( v.first >> 63 ) == 0 ) && m_statisticsFilter.PassFilter( name ) && m_statisticsImageFilter.PassFilter( image );
-                    if( !pass && v.second.size.Val() == 0 )
-                    {
-                        const auto parentAddr = m_worker.GetSymbolForAddress( v.first );
-                        if( parentAddr != 0 )
-                        {
-                            auto pit = symMap.find( parentAddr );
-                            if( pit != symMap.end() )
-                            {
-                                const auto parentName = m_worker.GetString( pit->second.name );
-                                pass = ( m_statShowKernel || ( parentAddr >> 63 ) == 0 ) && m_statisticsFilter.PassFilter( parentName ) && m_statisticsImageFilter.PassFilter( image );
-                            }
-                        }
-                    }
-                    if( pass )
-                    {
-                        auto it = symStat.find( v.first );
-                        if( it == symStat.end() )
-                        {
-                            data.push_back_no_space_check( SymList { v.first, 0, 0 } );
-                        }
-                        else
-                        {
-                            if( m_statRange.active )
-                            {
-                                auto samples = m_worker.GetSamplesForSymbol( v.first );
-                                if( samples )
-                                {
-                                    auto it = std::lower_bound( samples->begin(), samples->end(), m_statRange.min, [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs; } );
-                                    if( it != samples->end() )
-                                    {
-                                        auto end = std::lower_bound( it, samples->end(), m_statRange.max, [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs; } );
-                                        const auto count = uint32_t( end - it );
-                                        data.push_back_no_space_check( SymList { v.first, 0, count } );
-                                    }
-                                    else
-                                    {
-                                        data.push_back_no_space_check( SymList { v.first, 0, 0 } );
-                                    }
-                                }
-                                else
-                                {
-                                    data.push_back_no_space_check( SymList { v.first, 0, 0 } );
-                                }
-                            }
-                            else
-                            {
-                                data.push_back_no_space_check( SymList { v.first, it->second.incl, it->second.excl } );
-                            }
-                        }
-                    }
-                }
-            }
-            else
-            {
-                for( auto& v : symMap )
-                {
-                    auto it = symStat.find( v.first );
-                    if( it == symStat.end() )
-                    {
-                        data.push_back_no_space_check( SymList { v.first, 0, 0 } );
-                    }
-                    else
-                    {
-                        if( m_statRange.active )
-                        {
-                            auto samples = m_worker.GetSamplesForSymbol( v.first );
-                            if( samples )
-                            {
-                                auto it = std::lower_bound( samples->begin(), samples->end(), m_statRange.min, [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs; } );
-                                if( it != samples->end() )
-                                {
-                                    auto end = std::lower_bound( it, samples->end(), m_statRange.max, [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs; } );
-                                    const auto count = uint32_t( end - it );
-                                    data.push_back_no_space_check( SymList { v.first, 0, count } );
-                                }
-                                else
-                                {
-                                    data.push_back_no_space_check( SymList { v.first, 0, 0 } );
-                                }
-                            }
-                            else
-                            {
-                                data.push_back_no_space_check( SymList { v.first, 0, 0 } );
-                            }
-                        }
-                        else
-                        {
-                            data.push_back_no_space_check( SymList { v.first, it->second.incl, it->second.excl } );
-                        }
-                    }
-                }
-            }
-        }
-        else
-        {
-            data.reserve( symStat.size() );
-            if( m_statisticsFilter.IsActive() || m_statisticsImageFilter.IsActive() || !m_statShowKernel )
-            {
-                for( auto& v : symStat )
-                {
-                    auto sit = symMap.find( v.first );
-                    if( sit != symMap.end() )
-                    {
-                        const auto name = m_worker.GetString( sit->second.name );
-                        const auto image = m_worker.GetString( sit->second.imageName );
-                        bool pass = ( m_statShowKernel || ( v.first >> 63 ) == 0 ) && m_statisticsFilter.PassFilter( name ) && m_statisticsImageFilter.PassFilter( image );
-                        if( !pass && sit->second.size.Val() == 0 )
-                        {
-                            const auto parentAddr = m_worker.GetSymbolForAddress( v.first );
-                            if( parentAddr != 0 )
-                            {
-                                auto pit = symMap.find( parentAddr );
-                                if( pit != symMap.end() )
-                                {
-                                    const auto parentName = m_worker.GetString( pit->second.name );
-                                    pass = ( m_statShowKernel || ( parentAddr >> 63 ) == 0 ) && m_statisticsFilter.PassFilter( parentName ) && m_statisticsImageFilter.PassFilter( image );
-                                }
-                            }
-                        }
-                        if( pass )
-                        {
-                            if( m_statRange.active )
-                            {
-                                auto samples = m_worker.GetSamplesForSymbol( v.first );
-                                if( samples )
-                                {
-                                    auto it = std::lower_bound( samples->begin(), samples->end(), m_statRange.min, [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs; } );
-                                    if( it != samples->end() )
-                                    {
-                                        auto end = std::lower_bound( it, samples->end(), m_statRange.max, [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs; } );
-                                        const auto count = uint32_t( end - it );
-                                        data.push_back_no_space_check( SymList { v.first, 0, count } );
-                                    }
-                                }
-                            }
-                            else
-                            {
-                                data.push_back_no_space_check( SymList { v.first, v.second.incl, v.second.excl } );
-                            }
-                        }
-                    }
-                }
-            }
-            else
-            {
-                if( m_statRange.active )
-                {
-                    for( auto& v : symStat )
-                    {
-                        auto samples = m_worker.GetSamplesForSymbol( v.first );
-                        if( samples )
-                        {
-                            auto it = std::lower_bound( samples->begin(), samples->end(), m_statRange.min, [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs; } );
-                            if( it != samples->end() )
-                            {
-                                auto end = std::lower_bound( it, samples->end(), m_statRange.max, [] ( const auto& lhs, const auto& rhs ) { return lhs.time.Val() < rhs; } );
-                                const auto count = uint32_t( end - it );
-                                data.push_back_no_space_check( SymList { v.first, 0, count } );
-                            }
-                        }
-                    }
-                }
-                else
-                {
-                    for( auto& v : symStat )
-                    {
-                        data.push_back_no_space_check( SymList { v.first, v.second.incl, v.second.excl } );
-                    }
-                }
-            }
-        }
-
-        DrawSamplesStatistics( data, timeRange, m_statAccumulationMode );
+        UpdateSampleStatistics();
+        DrawSamplesStatistics( m_sampleStats.data, m_sampleStats.inlineMap, timeRange, m_statAccumulationMode );
     }
 #endif
     ImGui::End();
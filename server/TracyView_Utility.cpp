@@ -220,6 +220,9 @@ const ZoneEvent* View::GetZoneChild( const ZoneEvent& zone, int64_t time ) const
 const ZoneEvent* View::GetZoneParent( const ZoneEvent& zone ) const
 {
 #ifndef TRACY_NO_STATISTICS
+    const ZoneEvent* indexed;
+    if( m_worker.GetZoneParent( zone, indexed ) ) return indexed;
+
     if( m_worker.AreSourceLocationZonesReady() )
     {
         auto& slz = m_worker.GetZonesForSourceLocation( zone.SrcLoc() );
@@ -269,6 +272,11 @@ const ZoneEvent* View::GetZoneParent( const ZoneEvent& zone ) const
 
 const ZoneEvent* View::GetZoneParent( const ZoneEvent& zone, uint64_t tid ) const
 {
+#ifndef TRACY_NO_STATISTICS
+    const ZoneEvent* indexed;
+    if( m_worker.GetZoneParent( zone, indexed ) ) return indexed;
+#endif
+
     const auto thread = m_worker.GetThreadData( tid );
     const ZoneEvent* parent = nullptr;
     const Vector<short_ptr<ZoneEvent>>* timeline = &thread->timeline;
@@ -303,6 +311,22 @@ const ZoneEvent* View::GetZoneParent( const ZoneEvent& zone, uint64_t tid ) cons
 bool View::IsZoneReentry( const ZoneEvent& zone ) const
 {
 #ifndef TRACY_NO_STATISTICS
+    const ZoneEvent* parent;
+    if( m_worker.GetZoneParent( zone, parent ) )
+    {
+        // Ancestors of an indexed zone are indexed too.
+        while( parent )
+        {
+            if( parent->SrcLoc() == zone.SrcLoc() ) return true;
+            if( !m_worker.GetZoneParent( *parent, parent ) )
+            {
+                assert( false );
+                break;
+            }
+        }
+        return false;
+    }
+
     if( m_worker.AreSourceLocationZonesReady() )
     {
         auto& slz = m_worker.GetZonesForSourceLocation( zone.SrcLoc() );
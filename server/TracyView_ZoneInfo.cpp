@@ -448,13 +448,13 @@ void View::DrawZoneInfoWindow()
         TextFocused( "Time from start of program:", TimeToStringExact( ev.Start() ) );
         TextFocused( "Execution time:", TimeToString( ztime ) );
 #ifndef TRACY_NO_STATISTICS
-        if( m_worker.AreSourceLocationZonesReady() )
+        if( m_worker.AreSourceLocationStatisticsReady() )
         {
             auto& zoneData = m_worker.GetZonesForSourceLocation( ev.SrcLoc() );
             if( zoneData.total > 0 )
             {
                 ImGui::SameLine();
-                ImGui::TextDisabled( "(%.2f%% of mean time)", float( ztime ) / zoneData.total * zoneData.zones.size() * 100 );
+                ImGui::TextDisabled( "(%.2f%% of mean time)", float( ztime ) / zoneData.total * m_worker.GetZoneCount( zoneData ) * 100 );
             }
         }
 #endif
@@ -1848,13 +1848,13 @@ void View::ZoneTooltip( const ZoneEvent& ev )
     ImGui::Separator();
     TextFocused( "Execution time:", TimeToString( ztime ) );
 #ifndef TRACY_NO_STATISTICS
-    if( m_worker.AreSourceLocationZonesReady() )
+    if( m_worker.AreSourceLocationStatisticsReady() )
     {
         auto& zoneData = m_worker.GetZonesForSourceLocation( ev.SrcLoc() );
         if( zoneData.total > 0 )
         {
             ImGui::SameLine();
-            ImGui::TextDisabled( "(%.2f%% of mean time)", float( ztime ) / zoneData.total * zoneData.zones.size() * 100 );
+            ImGui::TextDisabled( "(%.2f%% of mean time)", float( ztime ) / zoneData.total * m_worker.GetZoneCount( zoneData ) * 100 );
         }
     }
 #endif
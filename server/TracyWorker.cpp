@@ -262,12 +262,12 @@ static bool IsQueryPrio( ServerQuery type )
 
 LoadProgress Worker::s_loadProgress;
 
-Worker::Worker( const char* addr, uint16_t port )
+Worker::Worker( const char* addr, uint16_t port, FILE* rawCapture )
     : m_addr( addr )
     , m_port( port )
     , m_hasData( false )
     , m_stream( LZ4_createStreamDecode() )
-    , m_buffer( new char[TargetFrameSize*3 + 1] )
+    , m_buffer( new char[TargetFrameSize*NetFrameSlots + 1] )
     , m_bufferOffset( 0 )
     , m_inconsistentSamples( false )
     , m_pendingStrings( 0 )
@@ -282,6 +282,7 @@ Worker::Worker( const char* addr, uint16_t port )
     , m_callstackFrameStaging( nullptr )
     , m_traceVersion( CurrentVersion )
     , m_loadTime( 0 )
+    , m_rawCapture( rawCapture )
 {
     m_data.sourceLocationExpand.push_back( 0 );
     m_data.localThreadCompress.InitZero();
@@ -306,6 +307,177 @@ Worker::Worker( const char* addr, uint16_t port )
     m_threadNet = std::thread( [this] { SetThreadName( "Tracy Network" ); Network(); } );
 }
 
+Worker::Worker( FILE* rawCapture )
+    : m_hasData( false )
+    , m_stream( LZ4_createStreamDecode() )
+    , m_buffer( new char[TargetFrameSize*NetFrameSlots + 1] )
+    , m_bufferOffset( 0 )
+    , m_inconsistentSamples( false )
+    , m_pendingStrings( 0 )
+    , m_pendingThreads( 0 )
+    , m_pendingFibers( 0 )
+    , m_pendingExternalNames( 0 )
+    , m_pendingSourceLocation( 0 )
+    , m_pendingCallstackFrames( 0 )
+    , m_pendingCallstackSubframes( 0 )
+    , m_pendingCodeInformation( 0 )
+    , m_pendingSymbolCode( 0 )
+    , m_callstackFrameStaging( nullptr )
+    , m_traceVersion( CurrentVersion )
+    , m_loadTime( 0 )
+    , m_rawReplay( rawCapture )
+{
+    m_data.sourceLocationExpand.push_back( 0 );
+    m_data.localThreadCompress.InitZero();
+    m_data.callstackPayload.push_back( nullptr );
+    m_data.zoneExtra.push_back( ZoneExtra {} );
+    m_data.symbolLocInline.push_back( std::numeric_limits<uint64_t>::max() );
+    m_data.memory = m_slab.AllocInit<MemData>();
+    m_data.memNameMap.emplace( 0, m_data.memory );
+
+    memset( (char*)m_gpuCtxMap, 0, sizeof( m_gpuCtxMap ) );
+
+#ifndef TRACY_NO_STATISTICS
+    m_data.sourceLocationZonesReady = true;
+    m_data.gpuSourceLocationZonesReady = true;
+    m_data.callstackSamplesReady = true;
+    m_data.ghostZonesReady = true;
+    m_data.ctxUsageReady = true;
+    m_data.symbolSamplesReady = true;
+#endif
+
+    WelcomeMessage welcome;
+    OnDemandPayloadMessage onDemand;
+    bool hasOnDemand = false;
+    try
+    {
+        char hdr[sizeof( RawCaptureHeader )];
+        uint32_t protocolVersion;
+        if( fread( hdr, 1, sizeof( hdr ), m_rawReplay ) != sizeof( hdr ) || memcmp( hdr, RawCaptureHeader, sizeof( hdr ) ) != 0 ) throw NotTracyDump();
+        if( fread( &protocolVersion, 1, sizeof( protocolVersion ), m_rawReplay ) != sizeof( protocolVersion ) ) throw FileReadError();
+        if( protocolVersion != ProtocolVersion ) throw UnsupportedVersion( protocolVersion );
+        if( fread( &welcome, 1, sizeof( welcome ), m_rawReplay ) != sizeof( welcome ) ) throw FileReadError();
+        if( welcome.flags & WelcomeFlag::OnDemand )
+        {
+            if( fread( &onDemand, 1, sizeof( onDemand ), m_rawReplay ) != sizeof( onDemand ) ) throw FileReadError();
+            hasOnDemand = true;
+        }
+    }
+    catch( ... )
+    {
+        fclose( m_rawReplay );
+        delete[] m_buffer;
+        LZ4_freeStreamDecode( (LZ4_streamDecode_t*)m_stream );
+        throw;
+    }
+    SetupSession( welcome, hasOnDemand ? &onDemand : nullptr );
+
+    m_hasData.store( true, std::memory_order_release );
+    m_connected.store( true, std::memory_order_relaxed );
+    m_thread = std::thread( [this] { SetThreadName( "Tracy Replay" ); Replay(); } );
+}
+
+Worker::Worker( const char* addr, uint16_t port, int64_t rollingWindow, const char* rollingTrigger )
+    : m_addr( addr )
+    , m_port( port )
+    , m_hasData( false )
+    , m_stream( LZ4_createStreamDecode() )
+    , m_buffer( new char[TargetFrameSize*NetFrameSlots + 1] )
+    , m_bufferOffset( 0 )
+    , m_inconsistentSamples( false )
+    , m_pendingStrings( 0 )
+    , m_pendingThreads( 0 )
+    , m_pendingFibers( 0 )
+    , m_pendingExternalNames( 0 )
+    , m_pendingSourceLocation( 0 )
+    , m_pendingCallstackFrames( 0 )
+    , m_pendingCallstackSubframes( 0 )
+    , m_pendingCodeInformation( 0 )
+    , m_pendingSymbolCode( 0 )
+    , m_callstackFrameStaging( nullptr )
+    , m_traceVersion( CurrentVersion )
+    , m_loadTime( 0 )
+    , m_rolling( std::make_unique<RollingCapture>() )
+{
+    m_rolling->window = rollingWindow;
+    if( rollingTrigger ) m_rolling->trigger = rollingTrigger;
+
+    m_data.sourceLocationExpand.push_back( 0 );
+    m_data.localThreadCompress.InitZero();
+    m_data.callstackPayload.push_back( nullptr );
+    m_data.zoneExtra.push_back( ZoneExtra {} );
+    m_data.symbolLocInline.push_back( std::numeric_limits<uint64_t>::max() );
+    m_data.memory = m_slab.AllocInit<MemData>();
+    m_data.memNameMap.emplace( 0, m_data.memory );
+
+    memset( (char*)m_gpuCtxMap, 0, sizeof( m_gpuCtxMap ) );
+
+#ifndef TRACY_NO_STATISTICS
+    m_data.sourceLocationZonesReady = true;
+    m_data.gpuSourceLocationZonesReady = true;
+    m_data.callstackSamplesReady = true;
+    m_data.ghostZonesReady = true;
+    m_data.ctxUsageReady = true;
+    m_data.symbolSamplesReady = true;
+#endif
+
+    m_thread = std::thread( [this] { SetThreadName( "Tracy Worker" ); Exec(); } );
+    m_threadNet = std::thread( [this] { SetThreadName( "Tracy Network" ); Network(); } );
+}
+
+Worker::Worker( std::unique_ptr<RollingCapture>&& rolling )
+    : m_hasData( false )
+    , m_stream( nullptr )
+    , m_buffer( nullptr )
+    , m_bufferOffset( 0 )
+    , m_inconsistentSamples( false )
+    , m_pendingStrings( 0 )
+    , m_pendingThreads( 0 )
+    , m_pendingFibers( 0 )
+    , m_pendingExternalNames( 0 )
+    , m_pendingSourceLocation( 0 )
+    , m_pendingCallstackFrames( 0 )
+    , m_pendingCallstackSubframes( 0 )
+    , m_pendingCodeInformation( 0 )
+    , m_pendingSymbolCode( 0 )
+    , m_callstackFrameStaging( nullptr )
+    , m_traceVersion( CurrentVersion )
+    , m_loadTime( 0 )
+    , m_rolling( std::move( rolling ) )
+    , m_rollingDump( true )
+{
+    m_data.sourceLocationExpand.push_back( 0 );
+    m_data.localThreadCompress.InitZero();
+    m_data.callstackPayload.push_back( nullptr );
+    m_data.zoneExtra.push_back( ZoneExtra {} );
+    m_data.symbolLocInline.push_back( std::numeric_limits<uint64_t>::max() );
+    m_data.memory = m_slab.AllocInit<MemData>();
+    m_data.memNameMap.emplace( 0, m_data.memory );
+
+    memset( (char*)m_gpuCtxMap, 0, sizeof( m_gpuCtxMap ) );
+
+#ifndef TRACY_NO_STATISTICS
+    m_data.sourceLocationZonesReady = true;
+    m_data.gpuSourceLocationZonesReady = true;
+    m_data.callstackSamplesReady = true;
+    m_data.ghostZonesReady = true;
+    m_data.ctxUsageReady = true;
+    m_data.symbolSamplesReady = true;
+#endif
+
+    const auto& rc = *m_rolling;
+    SetupSession( rc.welcome, rc.hasOnDemand ? &rc.onDemand : nullptr );
+    // Memory allocated before the window starts is freed within it.
+    m_ignoreMemFreeFaults = true;
+
+    PlayRollingCapture();
+
+    m_rolling.reset();
+    m_rollingQueries.clear();
+    m_rollingLocks.clear();
+    m_hasData.store( true, std::memory_order_release );
+}
+
 Worker::Worker( const char* name, const char* program, const std::vector<ImportEventTimeline>& timeline, const std::vector<ImportEventMessages>& messages, const std::vector<ImportEventPlots>& plots, const std::unordered_map<uint64_t, std::string>& threadNames )
     : m_hasData( true )
     , m_delay( 0 )
@@ -535,6 +707,29 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
 {
     auto loadStart = std::chrono::high_resolution_clock::now();
 
+    static const std::pair<FileSection, EventType::Type> sectionEvents[] = {
+        { FileSection::Locks, EventType::Locks },
+        { FileSection::Messages, EventType::Messages },
+        { FileSection::Plots, EventType::Plots },
+        { FileSection::Memory, EventType::Memory },
+        { FileSection::FrameImages, EventType::FrameImages },
+        { FileSection::ContextSwitches, EventType::ContextSwitches },
+        { FileSection::ContextSwitchesPerCpu, EventType::ContextSwitches },
+        { FileSection::SymbolCode, EventType::SymbolCode },
+        { FileSection::CodeLocations, EventType::SymbolCode },
+        { FileSection::SourceCache, EventType::SourceCache }
+    };
+    for( auto& v : sectionEvents )
+    {
+        if( ( eventMask & v.second ) == 0 ) f.ExcludeSection( v.first );
+    }
+#ifndef TRACY_NO_STATISTICS
+    const bool loadStatistics = bgTasks && f.HasSection( FileSection::Statistics );
+    if( !loadStatistics ) f.ExcludeSection( FileSection::Statistics );
+#else
+    f.ExcludeSection( FileSection::Statistics );
+#endif
+
     m_data.callstackPayload.push_back( nullptr );
 
     int fileVer = 0;
@@ -769,6 +964,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
         auto status = m_data.sourceLocationZones.emplace( id, SourceLocationZones() );
         assert( status.second );
         status.first->second.zones.reserve( cnt );
+        status.first->second.loadedCount = cnt;
     }
 
     if( fileVer >= FileVersion( 0, 7, 15 ) )
@@ -782,6 +978,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
             auto status = m_data.gpuSourceLocationZones.emplace( id, GpuSourceLocationZones() );
             assert( status.second );
             status.first->second.zones.reserve( cnt );
+            status.first->second.loadedCount = cnt;
         }
     }
 #else
@@ -823,6 +1020,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
             lockmap.isContended = false;
             lockmap.threadMap.reserve( tsz );
             lockmap.threadList.reserve( tsz );
+            lockmap.threadEvents.resize( tsz );
             for( uint64_t i=0; i<tsz; i++ )
             {
                 uint64_t t;
@@ -846,6 +1044,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
                     lev->SetSrcLoc( srcloc );
                     f.Read( &lev->thread, sizeof( LockEvent::thread ) + sizeof( LockEvent::type ) );
                     *ptr++ = { lev };
+                    lockmap.threadEvents[lev->thread].push_back( uint32_t( i ) );
                     UpdateLockRange( lockmap, *lev, lt );
                 }
             }
@@ -861,6 +1060,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
                     lev->SetSrcLoc( srcloc );
                     f.Read( &lev->thread, sizeof( LockEventShared::thread ) + sizeof( LockEventShared::type ) );
                     *ptr++ = { lev };
+                    lockmap.threadEvents[lev->thread].push_back( uint32_t( i ) );
                     UpdateLockRange( lockmap, *lev, lt );
                 }
             }
@@ -868,7 +1068,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
             m_data.lockMap.emplace( id, lockmapPtr );
         }
     }
-    else
+    else if( !f.SkipSection( FileSection::Locks ) )
     {
         for( uint64_t i=0; i<sz; i++ )
         {
@@ -903,7 +1103,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
             msgMap.emplace( ptr, msgdata );
         }
     }
-    else
+    else if( !f.SkipSection( FileSection::Messages ) )
     {
         f.Skip( sz * ( sizeof( uint64_t ) + sizeof( MessageData::time ) + sizeof( MessageData::ref ) + sizeof( MessageData::color ) + sizeof( MessageData::callstack ) ) );
     }
@@ -935,6 +1135,9 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
     f.Read( sz );
     m_data.zoneChildren.reserve_exact( sz, m_slab );
     memset( (char*)m_data.zoneChildren.data(), 0, sizeof( Vector<short_ptr<ZoneEvent>> ) * sz );
+#ifndef TRACY_NO_STATISTICS
+    m_data.zoneParentIndex.reserve( sz );
+#endif
     int32_t childIdx = 0;
     f.Read( sz );
     m_data.threads.reserve_exact( sz, m_slab );
@@ -964,6 +1167,9 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
         if( tsz != 0 )
         {
             ReadTimeline( f, td->timeline, tsz, 0, childIdx );
+#ifndef TRACY_NO_STATISTICS
+            m_data.zoneParentIndex.push_back( ZoneParentRange { ((Vector<ZoneEvent>*)&td->timeline)->data(), nullptr, tsz } );
+#endif
         }
         uint64_t msz;
         f.Read( msz );
@@ -1033,6 +1239,9 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
         m_data.threads[i] = td;
         m_threadMap.emplace( tid, td );
     }
+#ifndef TRACY_NO_STATISTICS
+    pdqsort_branchless( m_data.zoneParentIndex.begin(), m_data.zoneParentIndex.end(), [] ( const auto& lhs, const auto& rhs ) { return lhs.begin.get() < rhs.begin.get(); } );
+#endif
 
     s_loadProgress.progress.store( LoadProgress::GpuZones, std::memory_order_relaxed );
     f.Read( sz );
@@ -1118,6 +1327,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
                     ptr->time = refTime;
                     ptr++;
                 }
+                UpdatePlotLod( *pd );
                 m_data.plots.Data().push_back_no_space_check( pd );
             }
         }
@@ -1143,6 +1353,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
                     ptr->time = refTime;
                     ptr++;
                 }
+                UpdatePlotLod( *pd );
                 m_data.plots.Data().push_back_no_space_check( pd );
             }
         }
@@ -1170,11 +1381,12 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
                     ptr->time = refTime;
                     ptr++;
                 }
+                UpdatePlotLod( *pd );
                 m_data.plots.Data().push_back_no_space_check( pd );
             }
         }
     }
-    else
+    else if( !f.SkipSection( FileSection::Plots ) )
     {
         if( fileVer >= FileVersion( 0, 8, 3 ) )
         {
@@ -1217,6 +1429,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
         uint64_t memcount, memtarget, memload = 0;
         f.Read2( memcount, memtarget );
         s_loadProgress.subTotal.store( memtarget, std::memory_order_relaxed );
+        if( !( eventMask & EventType::Memory ) && f.SkipSection( FileSection::Memory ) ) memcount = 0;
 
         for( uint64_t k=0; k<memcount; k++ )
         {
@@ -1270,6 +1483,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
                 if( sz != 0 )
                 {
                     memdata.reconstruct = true;
+                    BuildMemFreeIndex( memdata );
                 }
             }
             else
@@ -1331,6 +1545,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
             if( sz != 0 )
             {
                 memdata.reconstruct = true;
+                BuildMemFreeIndex( memdata );
             }
         }
         else
@@ -1507,21 +1722,24 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
     }
     else
     {
-        if( fileVer >= FileVersion( 0, 7, 8 ) )
-        {
-            uint32_t dsz;
-            f.Read( dsz );
-            f.Skip( dsz );
-        }
-        f.Read( sz );
-        s_loadProgress.subTotal.store( sz, std::memory_order_relaxed );
-        for( uint64_t i=0; i<sz; i++ )
+        if( !f.SkipSection( FileSection::FrameImages ) )
         {
-            s_loadProgress.subProgress.store( i, std::memory_order_relaxed );
-            uint16_t w, h;
-            f.Read2( w, h );
-            const auto fisz = w * h / 2;
-            f.Skip( fisz + sizeof( FrameImage::flip ) );
+            if( fileVer >= FileVersion( 0, 7, 8 ) )
+            {
+                uint32_t dsz;
+                f.Read( dsz );
+                f.Skip( dsz );
+            }
+            f.Read( sz );
+            s_loadProgress.subTotal.store( sz, std::memory_order_relaxed );
+            for( uint64_t i=0; i<sz; i++ )
+            {
+                s_loadProgress.subProgress.store( i, std::memory_order_relaxed );
+                uint16_t w, h;
+                f.Read2( w, h );
+                const auto fisz = w * h / 2;
+                f.Skip( fisz + sizeof( FrameImage::flip ) );
+            }
         }
         for( auto& v : m_data.framesBase->frames )
         {
@@ -1589,7 +1807,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
             m_data.ctxSwitch.emplace( thread, data );
         }
     }
-    else
+    else if( !f.SkipSection( FileSection::ContextSwitches ) )
     {
         f.Read( sz );
         s_loadProgress.subTotal.store( sz, std::memory_order_relaxed );
@@ -1642,7 +1860,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
             s_loadProgress.subProgress.store( cnt, std::memory_order_relaxed );
         }
     }
-    else
+    else if( !f.SkipSection( FileSection::ContextSwitchesPerCpu ) )
     {
         for( int i=0; i<256; i++ )
         {
@@ -1730,7 +1948,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
         }
         m_data.symbolCodeSize = ssz;
     }
-    else
+    else if( !f.SkipSection( FileSection::SymbolCode ) )
     {
         for( uint64_t i=0; i<sz; i++ )
         {
@@ -1764,7 +1982,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
             m_data.locationCodeAddressList.emplace( packed, std::move( data ) );
         }
     }
-    else
+    else if( !f.SkipSection( FileSection::CodeLocations ) )
     {
         for( uint64_t i=0; i<sz; i++ )
         {
@@ -1819,7 +2037,7 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
             m_data.sourceFileCache.emplace( key, MemoryBlock { data, len } );
         }
     }
-    else
+    else if( !f.SkipSection( FileSection::SourceCache ) )
     {
         for( uint64_t i=0; i<sz; i++ )
         {
@@ -1831,6 +2049,17 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
         }
     }
 
+    if( f.HasSection( FileSection::Images ) )
+    {
+        f.Read( sz );
+        m_data.images.reserve_exact( sz, m_slab );
+        if( sz != 0 ) f.Read( m_data.images.data(), sizeof( ImageData ) * sz );
+    }
+
+#ifndef TRACY_NO_STATISTICS
+    if( loadStatistics ) ReadStatistics( f, eventMask );
+#endif
+
     s_loadProgress.total.store( 0, std::memory_order_relaxed );
     m_loadTime = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::high_resolution_clock::now() - loadStart ).count();
 
@@ -1853,14 +2082,14 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
         m_threadBackground = std::thread( [this, eventMask] {
             std::vector<std::thread> jobs;
 
-            if( !m_data.ctxSwitch.empty() && m_data.cpuDataCount != 0 )
+            if( !m_data.ctxUsageReady && !m_data.ctxSwitch.empty() && m_data.cpuDataCount != 0 )
             {
                 jobs.emplace_back( std::thread( [this] { ReconstructContextSwitchUsage(); } ) );
             }
 
             for( auto& mem : m_data.memNameMap )
             {
-                if( mem.second->reconstruct ) jobs.emplace_back( std::thread( [this, mem = mem.second] { ReconstructMemAllocPlot( *mem ); } ) );
+                if( mem.second->reconstruct ) jobs.emplace_back( std::thread( [this, mem = mem.second] { ReconstructMemAllocPlot( *mem, true ); } ) );
             }
 
             std::function<void(uint8_t*, Vector<short_ptr<ZoneEvent>>&, uint16_t)> ProcessTimeline;
@@ -1881,20 +2110,35 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
                 }
             };
 
-            jobs.emplace_back( std::thread( [this, ProcessTimeline] {
-                for( auto& t : m_data.threads )
-                {
-                    if( m_shutdown.load( std::memory_order_relaxed ) ) return;
-                    if( !t->timeline.empty() )
+            if( !m_data.sourceLocationZonesReady && m_data.sourceLocationZonesLoaded )
+            {
+                jobs.emplace_back( std::thread( [this] {
+                    for( auto& t : m_data.threads )
                     {
-                        uint8_t countMap[64*1024];
-                        // Don't touch thread compression cache in a thread.
-                        ProcessTimeline( countMap, t->timeline, m_data.localThreadCompress.DecompressMustRaw( t->id ) );
+                        if( m_shutdown.load( std::memory_order_relaxed ) ) return;
+                        if( !t->timeline.empty() ) ReconstructZoneLists( t->timeline, m_data.localThreadCompress.DecompressMustRaw( t->id ) );
                     }
-                }
-                std::lock_guard<std::mutex> lock( m_data.lock );
-                m_data.sourceLocationZonesReady = true;
-            } ) );
+                    std::lock_guard<std::mutex> lock( m_data.lock );
+                    m_data.sourceLocationZonesReady = true;
+                } ) );
+            }
+            else if( !m_data.sourceLocationZonesReady )
+            {
+                jobs.emplace_back( std::thread( [this, ProcessTimeline] {
+                    for( auto& t : m_data.threads )
+                    {
+                        if( m_shutdown.load( std::memory_order_relaxed ) ) return;
+                        if( !t->timeline.empty() )
+                        {
+                            uint8_t countMap[64*1024];
+                            // Don't touch thread compression cache in a thread.
+                            ProcessTimeline( countMap, t->timeline, m_data.localThreadCompress.DecompressMustRaw( t->id ) );
+                        }
+                    }
+                    std::lock_guard<std::mutex> lock( m_data.lock );
+                    m_data.sourceLocationZonesReady = true;
+                } ) );
+            }
 
             std::function<void(Vector<short_ptr<GpuEvent>>&, uint16_t)> ProcessTimelineGpu;
             ProcessTimelineGpu = [this, &ProcessTimelineGpu] ( Vector<short_ptr<GpuEvent>>& _vec, uint16_t thread )
@@ -1912,21 +2156,39 @@ Worker::Worker( FileRead& f, EventType::Type eventMask, bool bgTasks )
                 }
             };
 
-            jobs.emplace_back( std::thread( [this, ProcessTimelineGpu] {
-                for( auto& t : m_data.gpuData )
-                {
-                    for( auto& td : t->threadData )
+            if( !m_data.gpuSourceLocationZonesReady && m_data.gpuSourceLocationZonesLoaded )
+            {
+                jobs.emplace_back( std::thread( [this] {
+                    for( auto& t : m_data.gpuData )
                     {
-                        if( m_shutdown.load( std::memory_order_relaxed ) ) return;
-                        if( !td.second.timeline.empty() )
+                        for( auto& td : t->threadData )
                         {
-                            ProcessTimelineGpu( td.second.timeline, td.first );
+                            if( m_shutdown.load( std::memory_order_relaxed ) ) return;
+                            if( !td.second.timeline.empty() ) ReconstructZoneLists( td.second.timeline, td.first );
                         }
                     }
-                }
-                std::lock_guard<std::mutex> lock( m_data.lock );
-                m_data.gpuSourceLocationZonesReady = true;
-            } ) );
+                    std::lock_guard<std::mutex> lock( m_data.lock );
+                    m_data.gpuSourceLocationZonesReady = true;
+                } ) );
+            }
+            else if( !m_data.gpuSourceLocationZonesReady )
+            {
+                jobs.emplace_back( std::thread( [this, ProcessTimelineGpu] {
+                    for( auto& t : m_data.gpuData )
+                    {
+                        for( auto& td : t->threadData )
+                        {
+                            if( m_shutdown.load( std::memory_order_relaxed ) ) return;
+                            if( !td.second.timeline.empty() )
+                            {
+                                ProcessTimelineGpu( td.second.timeline, td.first );
+                            }
+                        }
+                    }
+                    std::lock_guard<std::mutex> lock( m_data.lock );
+                    m_data.gpuSourceLocationZonesReady = true;
+                } ) );
+            }
 
             if( eventMask & EventType::Samples )
             {
@@ -2097,6 +2359,9 @@ Worker::~Worker()
 
     delete[] m_buffer;
     LZ4_freeStreamDecode( (LZ4_streamDecode_t*)m_stream );
+    if( m_streamZstd ) ZSTD_freeDStream( (ZSTD_DStream*)m_streamZstd );
+    if( m_rawCapture ) fclose( m_rawCapture );
+    if( m_rawReplay ) fclose( m_rawReplay );
 
     delete[] m_frameImageBuffer;
     delete[] m_tmpBuf;
@@ -2880,7 +3145,7 @@ std::vector<int16_t> Worker::GetMatchingSourceLocation( const char* query, bool
 #ifndef TRACY_NO_STATISTICS
 Worker::SourceLocationZones& Worker::GetZonesForSourceLocation( int16_t srcloc )
 {
-    assert( AreSourceLocationZonesReady() );
+    assert( AreSourceLocationStatisticsReady() );
     static SourceLocationZones empty;
     auto it = m_data.sourceLocationZones.find( srcloc );
     return it != m_data.sourceLocationZones.end() ? it->second : empty;
@@ -2888,12 +3153,23 @@ Worker::SourceLocationZones& Worker::GetZonesForSourceLocation( int16_t srcloc )
 
 const Worker::SourceLocationZones& Worker::GetZonesForSourceLocation( int16_t srcloc ) const
 {
-    assert( AreSourceLocationZonesReady() );
+    assert( AreSourceLocationStatisticsReady() );
     static const SourceLocationZones empty;
     auto it = m_data.sourceLocationZones.find( srcloc );
     return it != m_data.sourceLocationZones.end() ? it->second : empty;
 }
 
+bool Worker::GetZoneParent( const ZoneEvent& zone, const ZoneEvent*& parent ) const
+{
+    const auto& index = m_data.zoneParentIndex;
+    auto it = std::upper_bound( index.begin(), index.end(), &zone, [] ( const auto& l, const auto& r ) { return l < r.begin.get(); } );
+    if( it == index.begin() ) return false;
+    --it;
+    if( &zone >= it->begin.get() + it->size ) return false;
+    parent = it->parent.get();
+    return true;
+}
+
 const SymbolStats* Worker::GetSymbolStats( uint64_t symAddr ) const
 {
     assert( AreCallstackSamplesReady() );
@@ -2937,14 +3213,41 @@ void Worker::Network()
             m_netWriteCnt--;
         }
 
+        if( m_independentFrames )
+        {
+            if( !NetworkIndependentFrames() ) goto close;
+            continue;
+        }
+
         auto buf = m_buffer + m_bufferOffset;
         lz4sz_t lz4sz;
         if( !m_sock.Read( &lz4sz, sizeof( lz4sz ), 10, ShouldExit ) ) goto close;
         if( !m_sock.Read( lz4buf.get(), lz4sz, 10, ShouldExit ) ) goto close;
+        if( m_rawCapture )
+        {
+            WriteRawFrame( lz4buf.get(), lz4sz );
+            fflush( m_rawCapture );
+        }
         auto bb = m_bytes.load( std::memory_order_relaxed );
         m_bytes.store( bb + sizeof( lz4sz ) + lz4sz, std::memory_order_relaxed );
 
-        auto sz = LZ4_decompress_safe_continue( (LZ4_streamDecode_t*)m_stream, lz4buf.get(), buf, lz4sz, TargetFrameSize );
+        int sz;
+        if( m_zstdFrames )
+        {
+            // Each frame is flushed by the client, so it decompresses fully without further input.
+            ZSTD_inBuffer in = { lz4buf.get(), lz4sz, 0 };
+            ZSTD_outBuffer out = { buf, TargetFrameSize, 0 };
+            while( in.pos < in.size && out.pos < out.size )
+            {
+                if( ZSTD_isError( ZSTD_decompressStream( (ZSTD_DStream*)m_streamZstd, &out, &in ) ) ) goto close;
+            }
+            if( in.pos < in.size ) goto close;
+            sz = int( out.pos );
+        }
+        else
+        {
+            sz = LZ4_decompress_safe_continue( (LZ4_streamDecode_t*)m_stream, lz4buf.get(), buf, lz4sz, TargetFrameSize );
+        }
         assert( sz >= 0 );
         bb = m_decBytes.load( std::memory_order_relaxed );
         m_decBytes.store( bb + sz, std::memory_order_relaxed );
@@ -2965,40 +3268,130 @@ close:
     m_netReadCv.notify_one();
 }
 
-void Worker::Exec()
+bool Worker::NetworkIndependentFrames()
 {
+    // Each frame was compressed without a shared dictionary, so all frames which are already waiting
+    // in the socket can be decompressed at the same time. One frame slot is already reserved.
     auto ShouldExit = [this] { return m_shutdown.load( std::memory_order_relaxed ); };
+    if( !m_netLz4Buf ) m_netLz4Buf = std::make_unique<char[]>( LZ4Size * NetFrameSlots );
 
+    int lz4sz[NetFrameSlots];
+    int sz[NetFrameSlots];
+    int cnt = 0;
     for(;;)
     {
-        if( m_shutdown.load( std::memory_order_relaxed ) ) { m_netWriteCv.notify_one(); return; };
-        if( m_sock.Connect( m_addr.c_str(), m_port ) ) break;
-        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
-    }
+        lz4sz_t size;
+        if( !m_sock.Read( &size, sizeof( size ), 10, ShouldExit ) ) return false;
+        if( !m_sock.Read( m_netLz4Buf.get() + cnt * LZ4Size, size, 10, ShouldExit ) ) return false;
+        if( m_rawCapture ) WriteRawFrame( m_netLz4Buf.get() + cnt * LZ4Size, size );
+        lz4sz[cnt++] = size;
 
-    std::chrono::time_point<std::chrono::high_resolution_clock> t0;
+        if( cnt == NetFrameSlots || !m_sock.HasData() ) break;
+        std::lock_guard<std::mutex> lock( m_netWriteLock );
+        if( m_netWriteCnt == 0 ) break;
+        m_netWriteCnt--;
+    }
+    if( m_rawCapture ) fflush( m_rawCapture );
 
-    m_sock.Send( HandshakeShibboleth, HandshakeShibbolethSize );
-    uint32_t protocolVersion = ProtocolVersion;
-    m_sock.Send( &protocolVersion, sizeof( protocolVersion ) );
-    HandshakeStatus handshake;
-    if( !m_sock.Read( &handshake, sizeof( handshake ), 10, ShouldExit ) )
+    auto Decompress = [this, &lz4sz, &sz] ( int i ) {
+        const auto slot = ( m_bufferOffset / TargetFrameSize + i ) % NetFrameSlots;
+        sz[i] = LZ4_decompress_safe( m_netLz4Buf.get() + i * LZ4Size, m_buffer + slot * TargetFrameSize, lz4sz[i], TargetFrameSize );
+        assert( sz[i] >= 0 );
+    };
+    if( cnt == 1 )
     {
-        m_handshake.store( HandshakeDropped, std::memory_order_relaxed );
-        goto close;
+        Decompress( 0 );
     }
-    m_handshake.store( handshake, std::memory_order_relaxed );
-    switch( handshake )
+    else
     {
-    case HandshakeWelcome:
-        break;
-    case HandshakeProtocolMismatch:
-    case HandshakeNotAvailable:
-    default:
-        goto close;
+        if( !m_netDispatch ) m_netDispatch = std::make_unique<TaskDispatch>( std::min<int>( NetFrameSlots - 1, std::max<int>( std::thread::hardware_concurrency() - 2, 1 ) ) );
+        for( int i=0; i<cnt; i++ ) m_netDispatch->Queue( [&Decompress, i] { Decompress( i ); } );
+        m_netDispatch->Sync();
     }
 
-    m_data.framesBase = m_data.frames.Retrieve( 0, [this] ( uint64_t name ) {
+    uint64_t bytes = 0, decBytes = 0;
+    for( int i=0; i<cnt; i++ )
+    {
+        bytes += sizeof( lz4sz_t ) + lz4sz[i];
+        decBytes += sz[i];
+    }
+    m_bytes.store( m_bytes.load( std::memory_order_relaxed ) + bytes, std::memory_order_relaxed );
+    m_decBytes.store( m_decBytes.load( std::memory_order_relaxed ) + decBytes, std::memory_order_relaxed );
+
+    std::lock_guard<std::mutex> lock( m_netReadLock );
+    for( int i=0; i<cnt; i++ )
+    {
+        m_netRead.push_back( NetBuffer { m_bufferOffset, sz[i] } );
+        m_bufferOffset = ( m_bufferOffset + TargetFrameSize ) % ( TargetFrameSize * NetFrameSlots );
+    }
+    m_netReadCv.notify_one();
+    return true;
+}
+
+void Worker::WriteRawFrame( const char* data, lz4sz_t sz )
+{
+    fwrite( &sz, 1, sizeof( sz ), m_rawCapture );
+    fwrite( data, 1, sz, m_rawCapture );
+}
+
+void Worker::Replay()
+{
+    auto lz4buf = std::make_unique<char[]>( LZ4Size );
+
+    LZ4_setStreamDecode( (LZ4_streamDecode_t*)m_stream, nullptr, 0 );
+    if( m_zstdFrames ) m_streamZstd = ZSTD_createDStream();
+
+    // A raw capture ends with a partially written frame if the capture was interrupted.
+    while( !m_shutdown.load( std::memory_order_relaxed ) )
+    {
+        lz4sz_t lz4sz;
+        if( fread( &lz4sz, 1, sizeof( lz4sz ), m_rawReplay ) != sizeof( lz4sz ) || lz4sz > LZ4Size ) break;
+        if( fread( lz4buf.get(), 1, lz4sz, m_rawReplay ) != lz4sz ) break;
+
+        auto buf = m_buffer + m_bufferOffset;
+        int sz;
+        if( m_zstdFrames )
+        {
+            ZSTD_inBuffer in = { lz4buf.get(), lz4sz, 0 };
+            ZSTD_outBuffer out = { buf, TargetFrameSize, 0 };
+            while( in.pos < in.size && out.pos < out.size )
+            {
+                if( ZSTD_isError( ZSTD_decompressStream( (ZSTD_DStream*)m_streamZstd, &out, &in ) ) ) break;
+            }
+            sz = in.pos < in.size ? -1 : int( out.pos );
+        }
+        else if( m_independentFrames )
+        {
+            sz = LZ4_decompress_safe( lz4buf.get(), buf, lz4sz, TargetFrameSize );
+        }
+        else
+        {
+            sz = LZ4_decompress_safe_continue( (LZ4_streamDecode_t*)m_stream, lz4buf.get(), buf, lz4sz, TargetFrameSize );
+        }
+        if( sz < 0 ) break;
+
+        const char* ptr = buf;
+        const char* end = ptr + sz;
+        {
+            std::lock_guard<std::mutex> lock( m_data.lock );
+            while( ptr < end )
+            {
+                auto ev = (const QueueItem*)ptr;
+                if( !DispatchProcess( *ev, ptr ) ) goto close;
+            }
+        }
+
+        m_bufferOffset += sz;
+        if( m_bufferOffset > TargetFrameSize * 2 ) m_bufferOffset = 0;
+    }
+
+close:
+    m_connected.store( false, std::memory_order_relaxed );
+}
+
+void Worker::SetupSession( const WelcomeMessage& welcome, const OnDemandPayloadMessage* onDemand )
+{
+    m_data.framesBase = m_data.frames.Retrieve( 0, [this] ( uint64_t name ) {
         auto fd = m_slab.AllocInit<FrameData>();
         fd->name = name;
         fd->continuous = 1;
@@ -3009,6 +3402,81 @@ void Worker::Exec()
         HandleFrameName( name, tmp, 5 );
     } );
 
+    m_timerMul = welcome.timerMul;
+    m_data.baseTime = welcome.initBegin;
+    const auto initEnd = TscTime( welcome.initEnd );
+    m_data.framesBase->frames.push_back( FrameEvent{ 0, -1, -1 } );
+    m_data.framesBase->frames.push_back( FrameEvent{ initEnd, -1, -1 } );
+    m_data.lastTime = initEnd;
+    m_delay = TscPeriod( welcome.delay );
+    m_resolution = TscPeriod( welcome.resolution );
+    m_pid = welcome.pid;
+    m_samplingPeriod = welcome.samplingPeriod;
+    m_onDemand = welcome.flags & WelcomeFlag::OnDemand;
+    m_captureProgram = welcome.programName;
+    m_captureTime = welcome.epoch;
+    m_executableTime = welcome.exectime;
+    m_ignoreMemFreeFaults = ( welcome.flags & WelcomeFlag::OnDemand ) || ( welcome.flags & WelcomeFlag::IsApple );
+    m_data.cpuArch = (CpuArchitecture)welcome.cpuArch;
+    m_codeTransfer = welcome.flags & WelcomeFlag::CodeTransfer;
+    m_combineSamples = welcome.flags & WelcomeFlag::CombineSamples;
+    m_identifySamples = welcome.flags & WelcomeFlag::IdentifySamples;
+    m_independentFrames = welcome.flags & WelcomeFlag::IndependentFrames;
+    m_zstdFrames = welcome.flags & WelcomeFlag::ZstdFrames;
+    m_data.cpuId = welcome.cpuId;
+    memcpy( m_data.cpuManufacturer, welcome.cpuManufacturer, 12 );
+    m_data.cpuManufacturer[12] = '\0';
+
+    char dtmp[64];
+    time_t date = welcome.epoch;
+    auto lt = localtime( &date );
+    strftime( dtmp, 64, "%F %T", lt );
+    char tmp[1024];
+    sprintf( tmp, "%s @ %s", welcome.programName, dtmp );
+    m_captureName = tmp;
+
+    m_hostInfo = welcome.hostInfo;
+
+    if( onDemand )
+    {
+        m_data.frameOffset = onDemand->frames;
+        m_data.framesBase->frames.push_back( FrameEvent{ TscTime( onDemand->currentTime ), -1, -1 } );
+    }
+}
+
+void Worker::Exec()
+{
+    auto ShouldExit = [this] { return m_shutdown.load( std::memory_order_relaxed ); };
+
+    for(;;)
+    {
+        if( m_shutdown.load( std::memory_order_relaxed ) ) { m_netWriteCv.notify_one(); return; };
+        if( m_sock.Connect( m_addr.c_str(), m_port ) ) break;
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    }
+
+    std::chrono::time_point<std::chrono::high_resolution_clock> t0;
+
+    m_sock.Send( HandshakeShibboleth, HandshakeShibbolethSize );
+    uint32_t protocolVersion = ProtocolVersion;
+    m_sock.Send( &protocolVersion, sizeof( protocolVersion ) );
+    HandshakeStatus handshake;
+    if( !m_sock.Read( &handshake, sizeof( handshake ), 10, ShouldExit ) )
+    {
+        m_handshake.store( HandshakeDropped, std::memory_order_relaxed );
+        goto close;
+    }
+    m_handshake.store( handshake, std::memory_order_relaxed );
+    switch( handshake )
+    {
+    case HandshakeWelcome:
+        break;
+    case HandshakeProtocolMismatch:
+    case HandshakeNotAvailable:
+    default:
+        goto close;
+    }
+
     {
         WelcomeMessage welcome;
         if( !m_sock.Read( &welcome, sizeof( welcome ), 10, ShouldExit ) )
@@ -3016,49 +3484,28 @@ void Worker::Exec()
             m_handshake.store( HandshakeDropped, std::memory_order_relaxed );
             goto close;
         }
-        m_timerMul = welcome.timerMul;
-        m_data.baseTime = welcome.initBegin;
-        const auto initEnd = TscTime( welcome.initEnd );
-        m_data.framesBase->frames.push_back( FrameEvent{ 0, -1, -1 } );
-        m_data.framesBase->frames.push_back( FrameEvent{ initEnd, -1, -1 } );
-        m_data.lastTime = initEnd;
-        m_delay = TscPeriod( welcome.delay );
-        m_resolution = TscPeriod( welcome.resolution );
-        m_pid = welcome.pid;
-        m_samplingPeriod = welcome.samplingPeriod;
-        m_onDemand = welcome.flags & WelcomeFlag::OnDemand;
-        m_captureProgram = welcome.programName;
-        m_captureTime = welcome.epoch;
-        m_executableTime = welcome.exectime;
-        m_ignoreMemFreeFaults = ( welcome.flags & WelcomeFlag::OnDemand ) || ( welcome.flags & WelcomeFlag::IsApple );
-        m_data.cpuArch = (CpuArchitecture)welcome.cpuArch;
-        m_codeTransfer = welcome.flags & WelcomeFlag::CodeTransfer;
-        m_combineSamples = welcome.flags & WelcomeFlag::CombineSamples;
-        m_identifySamples = welcome.flags & WelcomeFlag::IdentifySamples;
-        m_data.cpuId = welcome.cpuId;
-        memcpy( m_data.cpuManufacturer, welcome.cpuManufacturer, 12 );
-        m_data.cpuManufacturer[12] = '\0';
-
-        char dtmp[64];
-        time_t date = welcome.epoch;
-        auto lt = localtime( &date );
-        strftime( dtmp, 64, "%F %T", lt );
-        char tmp[1024];
-        sprintf( tmp, "%s @ %s", welcome.programName, dtmp );
-        m_captureName = tmp;
-
-        m_hostInfo = welcome.hostInfo;
+        OnDemandPayloadMessage onDemand;
+        const bool hasOnDemand = welcome.flags & WelcomeFlag::OnDemand;
+        if( hasOnDemand && !m_sock.Read( &onDemand, sizeof( onDemand ), 10, ShouldExit ) )
+        {
+            m_handshake.store( HandshakeDropped, std::memory_order_relaxed );
+            goto close;
+        }
+        SetupSession( welcome, hasOnDemand ? &onDemand : nullptr );
 
-        if( m_onDemand )
+        if( m_rolling )
         {
-            OnDemandPayloadMessage onDemand;
-            if( !m_sock.Read( &onDemand, sizeof( onDemand ), 10, ShouldExit ) )
-            {
-                m_handshake.store( HandshakeDropped, std::memory_order_relaxed );
-                goto close;
-            }
-            m_data.frameOffset = onDemand.frames;
-            m_data.framesBase->frames.push_back( FrameEvent{ TscTime( onDemand.currentTime ), -1, -1 } );
+            m_rolling->welcome = welcome;
+            if( hasOnDemand ) m_rolling->onDemand = onDemand;
+            m_rolling->hasOnDemand = hasOnDemand;
+        }
+        if( m_rawCapture )
+        {
+            fwrite( RawCaptureHeader, 1, sizeof( RawCaptureHeader ), m_rawCapture );
+            fwrite( &protocolVersion, 1, sizeof( protocolVersion ), m_rawCapture );
+            fwrite( &welcome, 1, sizeof( welcome ), m_rawCapture );
+            if( hasOnDemand ) fwrite( &onDemand, 1, sizeof( onDemand ), m_rawCapture );
+            fflush( m_rawCapture );
         }
     }
 
@@ -3066,10 +3513,15 @@ void Worker::Exec()
     m_hasData.store( true, std::memory_order_release );
 
     LZ4_setStreamDecode( (LZ4_streamDecode_t*)m_stream, nullptr, 0 );
+    if( m_zstdFrames )
+    {
+        if( !m_streamZstd ) m_streamZstd = ZSTD_createDStream();
+        ZSTD_DCtx_reset( (ZSTD_DStream*)m_streamZstd, ZSTD_reset_session_only );
+    }
     m_connected.store( true, std::memory_order_relaxed );
     {
         std::lock_guard<std::mutex> lock( m_netWriteLock );
-        m_netWriteCnt = 2;
+        m_netWriteCnt = m_independentFrames ? NetFrameSlots : 2;
         m_netWriteCv.notify_one();
     }
 
@@ -3100,7 +3552,7 @@ void Worker::Exec()
             while( ptr < end )
             {
                 auto ev = (const QueueItem*)ptr;
-                if( !DispatchProcess( *ev, ptr ) )
+                if( !( m_rolling ? DispatchRolling( *ev, ptr ) : m_rawCapture ? DispatchRaw( *ev, ptr ) : DispatchProcess( *ev, ptr ) ) )
                 {
                     if( m_failure != Failure::None ) HandleFailure( ptr, end );
                     QueryTerminate();
@@ -3166,7 +3618,7 @@ void Worker::Exec()
             }
             if( !m_crashed && !m_disconnect )
             {
-                bool done = true;
+                bool done = m_rawOpenZones <= 0;
                 for( auto& v : m_data.threads )
                 {
                     if( !v->stack.empty() )
@@ -3367,6 +3819,17 @@ void Worker::DispatchFailure( const QueueItem& ev, const char*& ptr )
             AddSecondString( ptr, sz );
             ptr += sz;
             break;
+        case QueueType::ZoneBegin:
+        case QueueType::ZoneBeginCallstack:
+        case QueueType::ZoneBeginAllocSrcLoc:
+        case QueueType::ZoneBeginAllocSrcLocCallstack:
+        case QueueType::ZoneEnd:
+        case QueueType::ThreadContext:
+        {
+            QueueItem item;
+            ptr = DecodeCompact( ptr, item );
+            break;
+        }
         default:
             ptr += QueueDataSize[ev.hdr.idx];
             switch( ev.hdr.type )
@@ -3382,6 +3845,9 @@ void Worker::DispatchFailure( const QueueItem& ev, const char*& ptr )
             case QueueType::CallstackFrame:
                 ProcessCallstackFrame( ev.callstackFrame, false );
                 break;
+            case QueueType::ImageInfo:
+                ProcessImageInfo( ev.imageInfo );
+                break;
             case QueueType::SymbolInformation:
             case QueueType::CodeInformation:
             case QueueType::AckServerQueryNoop:
@@ -3398,6 +3864,14 @@ void Worker::DispatchFailure( const QueueItem& ev, const char*& ptr )
 
 void Worker::Query( ServerQuery type, uint64_t data, uint32_t extra )
 {
+    // Replies to queries made during a raw capture are already in the replayed stream.
+    if( m_rawReplay ) return;
+    // A rolling window dump is answered from the replies recorded during the capture.
+    if( m_rollingDump )
+    {
+        m_rollingQueries.emplace_back( type, data );
+        return;
+    }
     ServerQueryPacket query { type, data, extra };
     if( m_serverQuerySpaceLeft > 0 && m_serverQueryQueuePrio.empty() && m_serverQueryQueue.empty() )
     {
@@ -3561,6 +4035,17 @@ bool Worker::DispatchProcess( const QueueItem& ev, const char*& ptr )
             AddSecondString( ptr, sz );
             ptr += sz;
             return true;
+        case QueueType::ZoneBegin:
+        case QueueType::ZoneBeginCallstack:
+        case QueueType::ZoneBeginAllocSrcLoc:
+        case QueueType::ZoneBeginAllocSrcLocCallstack:
+        case QueueType::ZoneEnd:
+        case QueueType::ThreadContext:
+        {
+            QueueItem item;
+            ptr = DecodeCompact( ptr, item );
+            return Process( item );
+        }
         default:
             ptr += QueueDataSize[ev.hdr.idx];
             return Process( ev );
@@ -3568,6 +4053,41 @@ bool Worker::DispatchProcess( const QueueItem& ev, const char*& ptr )
     }
 }
 
+tracy_force_inline const char* Worker::DecodeCompact( const char* ptr, QueueItem& item )
+{
+    uint64_t val;
+    memcpy( &item.hdr, ptr, sizeof( QueueHeader ) );
+    ptr += sizeof( QueueHeader );
+    switch( item.hdr.type )
+    {
+    case QueueType::ZoneBegin:
+    case QueueType::ZoneBeginCallstack:
+        ptr = ReadVarInt( ptr, val );
+        item.zoneBegin.time = ZigZagDecode( val );
+        ptr = ReadVarInt( ptr, val );
+        m_refSrcLoc += uint64_t( ZigZagDecode( val ) );
+        item.zoneBegin.srcloc = m_refSrcLoc;
+        break;
+    case QueueType::ZoneBeginAllocSrcLoc:
+    case QueueType::ZoneBeginAllocSrcLocCallstack:
+        ptr = ReadVarInt( ptr, val );
+        item.zoneBeginLean.time = ZigZagDecode( val );
+        break;
+    case QueueType::ZoneEnd:
+        ptr = ReadVarInt( ptr, val );
+        item.zoneEnd.time = ZigZagDecode( val );
+        break;
+    case QueueType::ThreadContext:
+        ptr = ReadVarInt( ptr, val );
+        item.threadCtx.thread = uint32_t( val );
+        break;
+    default:
+        assert( false );
+        break;
+    }
+    return ptr;
+}
+
 void Worker::CheckSourceLocation( uint64_t ptr )
 {
     if( m_data.checkSrclocLast != ptr )
@@ -3836,6 +4356,7 @@ void Worker::InsertLockEvent( LockMap& lockmap, LockEvent* lev, uint64_t thread,
         assert( lockmap.threadList.size() < MaxLockThreads );
         it = lockmap.threadMap.emplace( thread, lockmap.threadList.size() ).first;
         lockmap.threadList.emplace_back( thread );
+        lockmap.threadEvents.emplace_back();
     }
     lev->thread = it->second;
     assert( lev->thread == it->second );
@@ -3851,6 +4372,7 @@ void Worker::InsertLockEvent( LockMap& lockmap, LockEvent* lev, uint64_t thread,
         timeline.push_back_non_empty( { lev } );
         UpdateLockCount( lockmap, timeline.size() - 1 );
     }
+    lockmap.threadEvents[it->second].push_back( uint32_t( timeline.size() - 1 ) );
 
     auto& range = lockmap.range[it->second];
     if( range.start > time ) range.start = time;
@@ -3876,7 +4398,7 @@ void Worker::CheckThreadString( uint64_t id )
     m_data.threadNames.emplace( id, "???" );
     m_pendingThreads++;
 
-    if( m_sock.IsValid() ) Query( ServerQueryThreadString, id );
+    if( m_sock.IsValid() || m_rollingDump ) Query( ServerQueryThreadString, id );
 }
 
 void Worker::CheckFiberName( uint64_t id, uint64_t tid )
@@ -3886,7 +4408,7 @@ void Worker::CheckFiberName( uint64_t id, uint64_t tid )
     m_data.threadNames.emplace( tid, "???" );
     m_pendingFibers++;
 
-    if( m_sock.IsValid() ) Query( ServerQueryFiberName, id );
+    if( m_sock.IsValid() || m_rollingDump ) Query( ServerQueryFiberName, id );
 }
 
 void Worker::CheckExternalName( uint64_t id )
@@ -4201,6 +4723,10 @@ void Worker::AddCallstackPayload( uint64_t ptr, const char* _data, size_t _sz )
         m_slab.Unalloc( memsize );
     }
 
+    // The client sends the slot of its callstack cache in place of a pointer.
+    if( m_callstackCache.empty() ) m_callstackCache.resize( CallstackCacheSize );
+    m_callstackCache[ptr & ( CallstackCacheSize - 1 )] = idx;
+
     m_pendingCallstackId = idx;
 }
 
@@ -4344,10 +4870,109 @@ void Worker::InsertPlot( PlotData* plot, int64_t time, double val )
         if( plot->min > val ) plot->min = val;
         else if( plot->max < val ) plot->max = val;
         plot->sum += val;
+        if( plot->data.back().time.Val() >= time && plot->lodInvalid > time ) plot->lodInvalid = time;
         plot->data.push_back( { Int48( time ), val } );
     }
 }
 
+static tracy_force_inline void AddPlotRange( PlotLod& range, double val )
+{
+    if( range.min > val ) range.min = val;
+    if( range.max < val ) range.max = val;
+    range.sum += val;
+}
+
+static tracy_force_inline void AddPlotRange( PlotLod& range, const PlotLod& lod )
+{
+    if( range.min > lod.min ) range.min = lod.min;
+    if( range.max < lod.max ) range.max = lod.max;
+    range.sum += lod.sum;
+}
+
+void Worker::UpdatePlotLod( PlotData& plot )
+{
+    auto& data = plot.data;
+    assert( data.is_sorted() );
+
+    if( plot.lodInvalid != std::numeric_limits<int64_t>::max() )
+    {
+        const auto it = std::lower_bound( data.begin(), data.end(), plot.lodInvalid, [] ( const auto& l, const auto& r ) { return l.time.Val() < r; } );
+        size_t sz = size_t( std::distance( data.begin(), it ) ) >> PlotLodShift;
+        for( auto& lod : plot.lod )
+        {
+            if( lod.size() > sz ) lod.set_size( sz );
+            sz >>= PlotLodShift;
+        }
+        plot.lodInvalid = std::numeric_limits<int64_t>::max();
+    }
+
+    auto& lod0 = plot.lod[0];
+    const auto sz0 = data.size() >> PlotLodShift;
+    for( size_t i=lod0.size(); i<sz0; i++ )
+    {
+        auto ptr = data.data() + ( i << PlotLodShift );
+        PlotLod range { ptr->val, ptr->val, ptr->val };
+        for( int j=1; j<PlotLodSize; j++ ) AddPlotRange( range, ptr[j].val );
+        lod0.push_back( range );
+    }
+    for( int l=1; l<PlotLodLevels; l++ )
+    {
+        const auto& src = plot.lod[l-1];
+        auto& dst = plot.lod[l];
+        const auto sz = src.size() >> PlotLodShift;
+        for( size_t i=dst.size(); i<sz; i++ )
+        {
+            auto ptr = src.data() + ( i << PlotLodShift );
+            PlotLod range = *ptr;
+            for( int j=1; j<PlotLodSize; j++ ) AddPlotRange( range, ptr[j] );
+            dst.push_back( range );
+        }
+    }
+}
+
+PlotLod Worker::GetPlotRange( const PlotData& plot, size_t first, size_t last )
+{
+    assert( first < last );
+    assert( last <= plot.data.size() );
+    const auto& data = plot.data;
+    PlotLod range { std::numeric_limits<double>::max(), std::numeric_limits<double>::lowest(), 0 };
+
+    // Items which do not fill a whole level of detail block on either side are added one by one,
+    // the remaining range moves up to the next level.
+    constexpr size_t mask = PlotLodSize - 1;
+    auto a = ( first + mask ) >> PlotLodShift;
+    auto b = std::min( last >> PlotLodShift, plot.lod[0].size() );
+    if( a >= b )
+    {
+        for( size_t i=first; i<last; i++ ) AddPlotRange( range, data[i].val );
+        return range;
+    }
+    for( size_t i=first; i<( a << PlotLodShift ); i++ ) AddPlotRange( range, data[i].val );
+    for( size_t i=( b << PlotLodShift ); i<last; i++ ) AddPlotRange( range, data[i].val );
+
+    int level = 0;
+    for(;;)
+    {
+        const auto& lod = plot.lod[level];
+        if( level + 1 < PlotLodLevels )
+        {
+            const auto na = ( a + mask ) >> PlotLodShift;
+            const auto nb = std::min( b >> PlotLodShift, plot.lod[level+1].size() );
+            if( na < nb )
+            {
+                for( size_t i=a; i<( na << PlotLodShift ); i++ ) AddPlotRange( range, lod[i] );
+                for( size_t i=( nb << PlotLodShift ); i<b; i++ ) AddPlotRange( range, lod[i] );
+                a = na;
+                b = nb;
+                level++;
+                continue;
+            }
+        }
+        for( size_t i=a; i<b; i++ ) AddPlotRange( range, lod[i] );
+        return range;
+    }
+}
+
 void Worker::HandlePlotName( uint64_t name, const char* str, size_t sz )
 {
     const auto sl = StoreString( str, sz );
@@ -4846,6 +5471,9 @@ bool Worker::Process( const QueueItem& ev )
     case QueueType::CallstackAlloc:
         ProcessCallstack();
         break;
+    case QueueType::CallstackCached:
+        ProcessCallstackCached( ev.callstackCached );
+        break;
     case QueueType::CallstackSample:
         ProcessCallstackSample( ev.callstackSample );
         break;
@@ -4867,6 +5495,9 @@ bool Worker::Process( const QueueItem& ev )
         ProcessCodeInformation( ev.codeInformation );
         m_serverQuerySpaceLeft++;
         break;
+    case QueueType::ImageInfo:
+        ProcessImageInfo( ev.imageInfo );
+        break;
     case QueueType::Terminate:
         m_terminate = true;
         break;
@@ -4933,14 +5564,830 @@ bool Worker::Process( const QueueItem& ev )
         ProcessFiberEnter( ev.fiberEnter );
         break;
     case QueueType::FiberLeave:
-        ProcessFiberLeave( ev.fiberLeave );
-        break;
+        ProcessFiberLeave( ev.fiberLeave );
+        break;
+    default:
+        assert( false );
+        break;
+    }
+
+    return m_failure == Failure::None;
+}
+
+// During a raw capture the data stream is written to disk as it is, so events are only inspected
+// for the data which has to be queried from the client. Replies to queries are processed as usual,
+// as they may cause further queries. The set of queries has to match the one made by Process(),
+// otherwise the replies found in the stream won't be expected when the capture is replayed.
+bool Worker::DispatchRaw( const QueueItem& ev, const char*& ptr )
+{
+    uint16_t sz;
+    switch( ev.hdr.type )
+    {
+    case QueueType::FrameImageData:
+    {
+        ptr += sizeof( QueueHeader ) + sizeof( QueueStringTransfer );
+        uint32_t isz;
+        memcpy( &isz, ptr, sizeof( isz ) );
+        ptr += sizeof( isz ) + isz;
+        return true;
+    }
+    case QueueType::SingleStringData:
+        // Stored only if a query reply needs it.
+        ptr += sizeof( QueueHeader );
+        memcpy( &sz, ptr, sizeof( sz ) );
+        ptr += sizeof( sz );
+        m_rawSingleString.assign( ptr, sz );
+        ptr += sz;
+        return true;
+    case QueueType::SecondStringData:
+        ptr += sizeof( QueueHeader );
+        memcpy( &sz, ptr, sizeof( sz ) );
+        ptr += sizeof( sz );
+        m_rawSecondString.assign( ptr, sz );
+        ptr += sz;
+        return true;
+    case QueueType::ZoneBegin:
+    case QueueType::ZoneBeginCallstack:
+    case QueueType::ZoneBeginAllocSrcLoc:
+    case QueueType::ZoneBeginAllocSrcLocCallstack:
+    case QueueType::ZoneEnd:
+    case QueueType::ThreadContext:
+    {
+        QueueItem item;
+        ptr = DecodeCompact( ptr, item );
+        return ProcessRaw( item );
+    }
+    default:
+        if( ev.hdr.idx >= (int)QueueType::StringData ) return DispatchProcess( ev, ptr );
+        ptr += QueueDataSize[ev.hdr.idx];
+        return ProcessRaw( ev );
+    }
+}
+
+bool Worker::ProcessRaw( const QueueItem& ev )
+{
+    switch( ev.hdr.type )
+    {
+    case QueueType::ThreadContext:
+        m_threadCtx = ev.threadCtx.thread;
+        m_refTimeThread = 0;
+        break;
+    case QueueType::ZoneBegin:
+    case QueueType::ZoneBeginCallstack:
+        CheckSourceLocation( ev.zoneBegin.srcloc );
+        RawNoticeThread( m_threadCtx );
+        RawNoticeTime( m_refTimeThread, ev.zoneBegin.time );
+        m_rawOpenZones++;
+        break;
+    case QueueType::ZoneBeginAllocSrcLoc:
+    case QueueType::ZoneBeginAllocSrcLocCallstack:
+        m_pendingSourceLocationPayload = 0;
+        RawNoticeThread( m_threadCtx );
+        RawNoticeTime( m_refTimeThread, ev.zoneBeginLean.time );
+        m_rawOpenZones++;
+        break;
+    case QueueType::ZoneEnd:
+        RawNoticeThread( m_threadCtx );
+        RawNoticeTime( m_refTimeThread, ev.zoneEnd.time );
+        m_rawOpenZones--;
+        break;
+    case QueueType::ZoneValidation:
+    case QueueType::Message:
+    case QueueType::MessageColor:
+    case QueueType::MessageCallstack:
+    case QueueType::MessageColorCallstack:
+        RawNoticeThread( m_threadCtx );
+        break;
+    case QueueType::MessageLiteral:
+    case QueueType::MessageLiteralCallstack:
+        CheckString( ev.messageLiteral.text );
+        RawNoticeThread( m_threadCtx );
+        break;
+    case QueueType::MessageLiteralColor:
+    case QueueType::MessageLiteralColorCallstack:
+        CheckString( ev.messageColorLiteral.text );
+        RawNoticeThread( m_threadCtx );
+        break;
+    case QueueType::FrameMarkMsg:
+    case QueueType::FrameMarkMsgStart:
+    case QueueType::FrameMarkMsgEnd:
+        RawNoticeFrame( ev.frameMark );
+        break;
+    case QueueType::LockAnnounce:
+        CheckSourceLocation( ev.lockAnnounce.lckloc );
+        break;
+    case QueueType::LockWait:
+    case QueueType::LockSharedWait:
+        RawNoticeThread( ev.lockWait.thread );
+        RawNoticeTime( m_refTimeSerial, ev.lockWait.time );
+        break;
+    case QueueType::LockObtain:
+    case QueueType::LockSharedObtain:
+        RawNoticeThread( ev.lockObtain.thread );
+        RawNoticeTime( m_refTimeSerial, ev.lockObtain.time );
+        break;
+    case QueueType::LockRelease:
+        RawNoticeTime( m_refTimeSerial, ev.lockRelease.time );
+        break;
+    case QueueType::LockSharedRelease:
+        RawNoticeThread( ev.lockReleaseShared.thread );
+        RawNoticeTime( m_refTimeSerial, ev.lockReleaseShared.time );
+        break;
+    case QueueType::LockMark:
+        CheckSourceLocation( ev.lockMark.srcloc );
+        break;
+    case QueueType::PlotDataInt:
+        RawNoticePlot( ev.plotDataInt.name );
+        RawNoticeTime( m_refTimeThread, ev.plotDataInt.time );
+        break;
+    case QueueType::PlotDataFloat:
+        RawNoticePlot( ev.plotDataFloat.name );
+        RawNoticeTime( m_refTimeThread, ev.plotDataFloat.time );
+        break;
+    case QueueType::PlotDataDouble:
+        RawNoticePlot( ev.plotDataDouble.name );
+        RawNoticeTime( m_refTimeThread, ev.plotDataDouble.time );
+        break;
+    case QueueType::PlotConfig:
+        RawNoticePlot( ev.plotConfig.name );
+        break;
+    case QueueType::GpuZoneBegin:
+        CheckSourceLocation( ev.gpuZoneBegin.srcloc );
+        RawNoticeTime( m_refTimeThread, ev.gpuZoneBegin.cpuTime );
+        break;
+    case QueueType::GpuZoneBeginSerial:
+        CheckSourceLocation( ev.gpuZoneBegin.srcloc );
+        RawNoticeTime( m_refTimeSerial, ev.gpuZoneBegin.cpuTime );
+        break;
+    case QueueType::GpuZoneBeginCallstack:
+        CheckSourceLocation( ev.gpuZoneBegin.srcloc );
+        RawNoticeThread( m_threadCtx );
+        RawNoticeTime( m_refTimeThread, ev.gpuZoneBegin.cpuTime );
+        break;
+    case QueueType::GpuZoneBeginCallstackSerial:
+        CheckSourceLocation( ev.gpuZoneBegin.srcloc );
+        RawNoticeThread( m_threadCtx );
+        RawNoticeTime( m_refTimeSerial, ev.gpuZoneBegin.cpuTime );
+        break;
+    case QueueType::GpuZoneBeginAllocSrcLoc:
+        m_pendingSourceLocationPayload = 0;
+        RawNoticeTime( m_refTimeThread, ev.gpuZoneBeginLean.cpuTime );
+        break;
+    case QueueType::GpuZoneBeginAllocSrcLocSerial:
+        m_pendingSourceLocationPayload = 0;
+        RawNoticeTime( m_refTimeSerial, ev.gpuZoneBeginLean.cpuTime );
+        break;
+    case QueueType::GpuZoneBeginAllocSrcLocCallstack:
+        m_pendingSourceLocationPayload = 0;
+        RawNoticeThread( m_threadCtx );
+        RawNoticeTime( m_refTimeThread, ev.gpuZoneBeginLean.cpuTime );
+        break;
+    case QueueType::GpuZoneBeginAllocSrcLocCallstackSerial:
+        m_pendingSourceLocationPayload = 0;
+        RawNoticeThread( m_threadCtx );
+        RawNoticeTime( m_refTimeSerial, ev.gpuZoneBeginLean.cpuTime );
+        break;
+    case QueueType::GpuZoneEnd:
+        RawNoticeTime( m_refTimeThread, ev.gpuZoneEnd.cpuTime );
+        break;
+    case QueueType::GpuZoneEndSerial:
+        RawNoticeTime( m_refTimeSerial, ev.gpuZoneEnd.cpuTime );
+        break;
+    case QueueType::GpuTime:
+        m_refTimeGpu += ev.gpuTime.gpuTime;
+        break;
+    case QueueType::MemAllocNamed:
+    case QueueType::MemAllocCallstackNamed:
+        CheckString( m_memNamePayload );
+        m_memNamePayload = 0;
+        // fallthrough
+    case QueueType::MemAlloc:
+    case QueueType::MemAllocCallstack:
+        RawNoticeThread( ev.memAlloc.thread );
+        RawNoticeTime( m_refTimeSerial, ev.memAlloc.time );
+        break;
+    case QueueType::MemFreeNamed:
+    case QueueType::MemFreeCallstackNamed:
+        CheckString( m_memNamePayload );
+        m_memNamePayload = 0;
+        // fallthrough
+    case QueueType::MemFree:
+    case QueueType::MemFreeCallstack:
+        // The thread of a free of an unknown pointer is queried only if it is a failure.
+        if( ev.memFree.ptr != 0 && !m_ignoreMemFreeFaults ) RawNoticeThread( ev.memFree.thread );
+        RawNoticeTime( m_refTimeSerial, ev.memFree.time );
+        break;
+    case QueueType::CallstackSerial:
+        m_pendingCallstackId = 0;
+        break;
+    case QueueType::Callstack:
+    case QueueType::CallstackAlloc:
+        m_pendingCallstackId = 0;
+        RawNoticeThread( m_threadCtx );
+        break;
+    case QueueType::CallstackSample:
+    case QueueType::CallstackSampleContextSwitch:
+        m_pendingCallstackId = 0;
+        RawNoticeThread( ev.callstackSample.thread );
+        m_refTimeCtx += ev.callstackSample.time;
+        break;
+    case QueueType::CallstackFrame:
+        AddSecondString( m_rawSecondString.data(), m_rawSecondString.size() );
+        // fallthrough
+    case QueueType::CallstackFrameSize:
+    case QueueType::SymbolInformation:
+    case QueueType::CodeInformation:
+        AddSingleString( m_rawSingleString.data(), m_rawSingleString.size() );
+        return Process( ev );
+    case QueueType::CrashReport:
+        CheckString( ev.crashReport.text );
+        RawNoticeThread( m_threadCtx );
+        break;
+    case QueueType::ContextSwitch:
+        if( ev.contextSwitch.newThread != 0 ) CheckExternalName( ev.contextSwitch.newThread );
+        RawNoticeTime( m_refTimeCtx, ev.contextSwitch.time );
+        break;
+    case QueueType::ThreadWakeup:
+        RawNoticeTime( m_refTimeCtx, ev.threadWakeup.time );
+        break;
+    case QueueType::FiberEnter:
+        if( m_data.fiberToThreadMap.find( ev.fiberEnter.fiber ) == m_data.fiberToThreadMap.end() )
+        {
+            const auto tid = ( uint64_t(1) << 32 ) | m_data.fiberToThreadMap.size();
+            m_data.fiberToThreadMap.emplace( ev.fiberEnter.fiber, tid );
+            CheckFiberName( ev.fiberEnter.fiber, tid );
+        }
+        RawNoticeThread( ev.fiberEnter.thread );
+        RawNoticeTime( m_refTimeThread, ev.fiberEnter.time );
+        break;
+    case QueueType::FiberLeave:
+        RawNoticeTime( m_refTimeThread, ev.fiberLeave.time );
+        break;
+    case QueueType::SourceLocation:
+    case QueueType::Terminate:
+    case QueueType::Crash:
+    case QueueType::TidToPid:
+    case QueueType::ParamSetup:
+    case QueueType::AckServerQueryNoop:
+    case QueueType::AckSourceCodeNotAvailable:
+    case QueueType::AckSymbolCodeNotAvailable:
+    case QueueType::CpuTopology:
+    case QueueType::MemNamePayload:
+        return Process( ev );
+    default:
+        break;
+    }
+    return m_failure == Failure::None;
+}
+
+void Worker::RawNoticeThread( uint64_t thread )
+{
+    if( m_rawThreadLast == thread ) return;
+    m_rawThreadLast = thread;
+    CheckThreadString( thread );
+}
+
+void Worker::RawNoticeFrame( const QueueFrameMark& ev )
+{
+    m_data.frames.Retrieve( ev.name, [this] ( uint64_t name ) {
+        auto fd = m_slab.AllocInit<FrameData>();
+        fd->name = name;
+        return fd;
+    }, [this] ( uint64_t name ) {
+        Query( ServerQueryFrameName, name );
+    } );
+    const auto time = TscTime( ev.time );
+    if( m_data.lastTime < time ) m_data.lastTime = time;
+}
+
+void Worker::RawNoticePlot( uint64_t name )
+{
+    m_data.plots.Retrieve( name, [this] ( uint64_t name ) {
+        auto plot = m_slab.AllocInit<PlotData>();
+        plot->name = name;
+        plot->type = PlotType::User;
+        return plot;
+    }, [this]( uint64_t name ) {
+        Query( ServerQueryPlotName, name );
+    } );
+}
+
+void Worker::RawNoticeTime( int64_t& reference, int64_t delta )
+{
+    reference += delta;
+    const auto time = TscTime( reference );
+    if( m_data.lastTime < time ) m_data.lastTime = time;
+}
+
+// Amount of uncompressed data after which a block of the rolling window is sealed.
+enum { RollingBlockSize = 256 * 1024 };
+
+// Events which only provide data for the event following them. A block is never sealed after these.
+static bool IsRollingPrefix( QueueType type )
+{
+    switch( type )
+    {
+    case QueueType::CallstackSerial:
+    case QueueType::Callstack:
+    case QueueType::CallstackAlloc:
+    case QueueType::CallstackPayload:
+    case QueueType::CallstackCached:
+    case QueueType::CallstackAllocPayload:
+    case QueueType::SourceLocationPayload:
+    case QueueType::MemNamePayload:
+    case QueueType::ZoneValidation:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void Worker::RollingLock::Update( QueueType type, uint32_t thread )
+{
+    switch( type )
+    {
+    case QueueType::LockWait:
+    case QueueType::LockSharedWait:
+        waiting.push_back( thread );
+        break;
+    case QueueType::LockObtain:
+    case QueueType::LockSharedObtain:
+    {
+        auto it = std::find( waiting.begin(), waiting.end(), thread );
+        if( it != waiting.end() ) waiting.erase( it );
+        if( type == QueueType::LockObtain ) exclusive++;
+        else shared++;
+        break;
+    }
+    case QueueType::LockRelease:
+        if( exclusive > 0 ) exclusive--;
+        break;
+    case QueueType::LockSharedRelease:
+        if( shared > 0 ) shared--;
+        break;
+    default:
+        assert( false );
+        break;
+    }
+}
+
+std::unique_ptr<Worker> Worker::DumpRollingCapture()
+{
+    assert( IsRollingCapture() );
+    std::unique_ptr<RollingCapture> rolling;
+    {
+        // Sealed blocks are shared, only the current block and the session data are copied.
+        std::lock_guard<std::mutex> lock( m_data.lock );
+        rolling = std::make_unique<RollingCapture>( *m_rolling );
+    }
+    return std::unique_ptr<Worker>( new Worker( std::move( rolling ) ) );
+}
+
+// A rolling capture is processed like a raw capture, with the data stream sorted into the current
+// block of the window, the session prologue and the replies to queries.
+bool Worker::DispatchRolling( const QueueItem& ev, const char*& ptr )
+{
+    const auto start = ptr;
+    uint64_t key = 0;
+    if( ev.hdr.type == QueueType::SourceLocation && !m_sourceLocationQueue.empty() ) key = m_sourceLocationQueue.front();
+    if( !DispatchRaw( ev, ptr ) ) return false;
+    return RecordRolling( ev, start, ptr, key );
+}
+
+bool Worker::RecordRolling( const QueueItem& ev, const char* start, const char* end, uint64_t key )
+{
+    auto& rc = *m_rolling;
+    switch( ev.hdr.type )
+    {
+    case QueueType::SingleStringData:
+    case QueueType::SecondStringData:
+    case QueueType::ExternalThreadName:
+        // Stored together with the event which consumes the string.
+        rc.pending.append( start, end );
+        return true;
+    case QueueType::FrameImage:
+    case QueueType::FrameImageData:
+    case QueueType::SymbolCode:
+    case QueueType::CodeInformation:
+    case QueueType::SourceCode:
+    case QueueType::AckServerQueryNoop:
+    case QueueType::AckSourceCodeNotAvailable:
+    case QueueType::AckSymbolCodeNotAvailable:
+    case QueueType::KeepAlive:
+        rc.pending.clear();
+        return true;
+    case QueueType::StringData:
+        RecordRollingReply( ServerQueryString, ev.stringTransfer.ptr, start, end );
+        if( !rc.triggerStrings.empty() )
+        {
+            auto it = rc.triggerStrings.find( ev.stringTransfer.ptr );
+            if( it != rc.triggerStrings.end() )
+            {
+                rc.triggerStrings.erase( it );
+                CheckRollingTrigger( m_data.strings[ev.stringTransfer.ptr] );
+            }
+        }
+        return true;
+    case QueueType::ThreadName:
+        RecordRollingReply( ServerQueryThreadString, ev.stringTransfer.ptr, start, end );
+        return true;
+    case QueueType::FiberName:
+        RecordRollingReply( ServerQueryFiberName, ev.stringTransfer.ptr, start, end );
+        return true;
+    case QueueType::PlotName:
+        RecordRollingReply( ServerQueryPlotName, ev.stringTransfer.ptr, start, end );
+        return true;
+    case QueueType::FrameName:
+        RecordRollingReply( ServerQueryFrameName, ev.stringTransfer.ptr, start, end );
+        return true;
+    case QueueType::ExternalName:
+        RecordRollingReply( ServerQueryExternalName, ev.stringTransfer.ptr, start, end );
+        return true;
+    case QueueType::SourceLocation:
+        RecordRollingReply( ServerQuerySourceLocation, key, start, end );
+        return true;
+    case QueueType::CallstackFrameSize:
+        rc.frameKey = ev.callstackFrameSize.ptr;
+        rc.replies[ServerQueryCallstackFrame][rc.frameKey].clear();
+        // fallthrough
+    case QueueType::CallstackFrame:
+        RecordRollingReply( ServerQueryCallstackFrame, rc.frameKey, start, end );
+        return true;
+    case QueueType::SymbolInformation:
+        RecordRollingReply( ServerQuerySymbol, ev.symbolInformation.symAddr, start, end );
+        return true;
+    case QueueType::LockAnnounce:
+    case QueueType::LockName:
+    case QueueType::GpuNewContext:
+    case QueueType::GpuContextName:
+    case QueueType::PlotConfig:
+    case QueueType::MessageAppInfo:
+    case QueueType::CpuTopology:
+    case QueueType::ParamSetup:
+    case QueueType::TidToPid:
+    case QueueType::ImageInfo:
+    {
+        // Lock definitions are tagged, so that they can be removed once the lock is terminated.
+        uint32_t tag = 0;
+        if( ev.hdr.type == QueueType::LockAnnounce ) tag = ev.lockAnnounce.id + 1;
+        else if( ev.hdr.type == QueueType::LockName ) tag = ev.lockName.id + 1;
+        std::string data = std::move( rc.pending );
+        data.append( start, end );
+        rc.pending.clear();
+        rc.prologue.emplace_back( tag, std::move( data ) );
+        return true;
+    }
+    case QueueType::CallstackPayload:
+        rc.callstacks[uint32_t( ev.stringTransfer.ptr & ( CallstackCacheSize - 1 ) )].assign( start, end );
+        break;
+    case QueueType::CallstackCached:
+    {
+        // The payload may be in an evicted block, so the callstack is stored in full.
+        auto it = rc.callstacks.find( ev.callstackCached.id );
+        if( it == rc.callstacks.end() )
+        {
+            CallstackCacheMissFailure();
+            return false;
+        }
+        start = it->second.data();
+        end = start + it->second.size();
+        break;
+    }
+    case QueueType::LockTerminate:
+        rc.currentTerminatedLocks.push_back( ev.lockTerminate.id );
+        break;
+    case QueueType::LockWait:
+    case QueueType::LockSharedWait:
+        RecordRollingLock( ev.lockWait.id, ev.hdr.type, ev.lockWait.thread );
+        break;
+    case QueueType::LockObtain:
+    case QueueType::LockSharedObtain:
+        RecordRollingLock( ev.lockObtain.id, ev.hdr.type, ev.lockObtain.thread );
+        break;
+    case QueueType::LockRelease:
+        RecordRollingLock( ev.lockRelease.id, ev.hdr.type, 0 );
+        break;
+    case QueueType::LockSharedRelease:
+        RecordRollingLock( ev.lockReleaseShared.id, ev.hdr.type, ev.lockReleaseShared.thread );
+        break;
+    case QueueType::Message:
+    case QueueType::MessageColor:
+    case QueueType::MessageCallstack:
+    case QueueType::MessageColorCallstack:
+        if( !rc.trigger.empty() ) CheckRollingTrigger( m_rawSingleString.c_str() );
+        break;
+    case QueueType::MessageLiteral:
+    case QueueType::MessageLiteralCallstack:
+    case QueueType::MessageLiteralColor:
+    case QueueType::MessageLiteralColorCallstack:
+        if( !rc.trigger.empty() )
+        {
+            const auto isColor = ev.hdr.type == QueueType::MessageLiteralColor || ev.hdr.type == QueueType::MessageLiteralColorCallstack;
+            const auto text = isColor ? ev.messageColorLiteral.text : ev.messageLiteral.text;
+            // The text of a literal may not have been received yet.
+            if( rc.replies[ServerQueryString].find( text ) != rc.replies[ServerQueryString].end() )
+            {
+                CheckRollingTrigger( m_data.strings[text] );
+            }
+            else
+            {
+                rc.triggerStrings.emplace( text );
+            }
+        }
+        break;
+    default:
+        break;
+    }
+
+    rc.current.append( rc.pending );
+    rc.pending.clear();
+    rc.current.append( start, end );
+    if( rc.current.size() >= RollingBlockSize && !IsRollingPrefix( ev.hdr.type ) ) SealRollingBlock();
+    return true;
+}
+
+void Worker::RecordRollingReply( ServerQuery type, uint64_t key, const char* start, const char* end )
+{
+    auto& rc = *m_rolling;
+    auto& reply = rc.replies[type][key];
+    reply.append( rc.pending );
+    reply.append( start, end );
+    rc.pending.clear();
+}
+
+void Worker::RecordRollingLock( uint32_t id, QueueType type, uint32_t thread )
+{
+    auto& locks = m_rolling->locks;
+    auto it = locks.find( id );
+    if( it == locks.end() ) it = locks.emplace( id, RollingLock {} ).first;
+    it->second.Update( type, thread );
+    if( it->second.Idle() ) locks.erase( it );
+}
+
+void Worker::CheckRollingTrigger( const char* text )
+{
+    if( strstr( text, m_rolling->trigger.c_str() ) ) m_rollingTriggers.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void Worker::SealRollingBlock()
+{
+    auto& rc = *m_rolling;
+    const auto size = int( rc.current.size() );
+
+    auto block = std::make_shared<RollingBlock>();
+    block->time = m_data.lastTime;
+    block->size = uint32_t( size );
+    block->data.resize( LZ4_compressBound( size ) );
+    block->data.resize( LZ4_compress_default( rc.current.data(), block->data.data(), size, int( block->data.size() ) ) );
+    block->data.shrink_to_fit();
+    block->start = std::move( rc.currentStart );
+    block->terminatedLocks = std::move( rc.currentTerminatedLocks );
+    rc.blocks.emplace_back( std::move( block ) );
+    rc.current.clear();
+    rc.currentTerminatedLocks.clear();
+
+    auto& cp = rc.currentStart;
+    cp.threadCtx = m_threadCtx;
+    cp.refSrcLoc = m_refSrcLoc;
+    cp.refTimeThread = m_refTimeThread;
+    cp.refTimeSerial = m_refTimeSerial;
+    cp.refTimeCtx = m_refTimeCtx;
+    cp.refTimeGpu = m_refTimeGpu;
+    cp.locks.clear();
+    for( auto& v : rc.locks ) cp.locks.emplace_back( v.first, v.second );
+
+    while( !rc.blocks.empty() && rc.blocks.front()->time < m_data.lastTime - rc.window )
+    {
+        for( auto id : rc.blocks.front()->terminatedLocks )
+        {
+            rc.prologue.erase( std::remove_if( rc.prologue.begin(), rc.prologue.end(), [id] ( const auto& v ) { return v.first == id + 1; } ), rc.prologue.end() );
+        }
+        rc.blocks.pop_front();
+    }
+}
+
+// Playback stops at the first failure, which is then reported as for a live capture.
+void Worker::PlayRollingCapture()
+{
+    const auto& rc = *m_rolling;
+    for( auto& v : rc.prologue )
+    {
+        if( !PlayRolling( v.second.data(), v.second.size() ) ) return;
+    }
+
+    const auto& start = rc.blocks.empty() ? rc.currentStart : rc.blocks.front()->start;
+    m_threadCtx = start.threadCtx;
+    m_refSrcLoc = start.refSrcLoc;
+    m_refTimeThread = start.refTimeThread;
+    m_refTimeSerial = start.refTimeSerial;
+    m_refTimeCtx = start.refTimeCtx;
+    m_refTimeGpu = start.refTimeGpu;
+    for( auto& v : start.locks ) m_rollingLocks.emplace( v.first, v.second );
+
+    std::unique_ptr<char[]> buf;
+    uint32_t bufSize = 0;
+    for( auto& ptr : rc.blocks )
+    {
+        const auto& block = *ptr;
+        if( bufSize < block.size )
+        {
+            bufSize = block.size;
+            buf = std::make_unique<char[]>( bufSize );
+        }
+        if( LZ4_decompress_safe( block.data.data(), buf.get(), (int)block.data.size(), (int)block.size ) != (int)block.size ) return;
+        if( !PlayRolling( buf.get(), block.size ) ) return;
+    }
+    PlayRolling( rc.current.data(), rc.current.size() );
+}
+
+bool Worker::PlayRolling( const char* ptr, size_t size )
+{
+    const auto end = ptr + size;
+    while( ptr < end )
+    {
+        auto ev = (const QueueItem*)ptr;
+        const auto type = ev->hdr.type;
+        if( !DispatchRollingDump( *ev, ptr ) ) return false;
+        if( !m_rollingQueries.empty() && !IsRollingPrefix( type ) && !m_pendingSingleString.ptr && !m_pendingSecondString.ptr )
+        {
+            if( !InjectRollingReplies() ) return false;
+        }
+    }
+    return true;
+}
+
+bool Worker::DispatchRollingDump( const QueueItem& ev, const char*& ptr )
+{
+    switch( ev.hdr.type )
+    {
+    case QueueType::ZoneBegin:
+    case QueueType::ZoneBeginCallstack:
+    case QueueType::ZoneBeginAllocSrcLoc:
+    case QueueType::ZoneBeginAllocSrcLocCallstack:
+    case QueueType::ZoneEnd:
+    case QueueType::ThreadContext:
+    {
+        QueueItem item;
+        ptr = DecodeCompact( ptr, item );
+        if( SkipRollingEvent( item ) ) return true;
+        return Process( item );
+    }
+    case QueueType::SingleStringData:
+    case QueueType::SecondStringData:
+        return DispatchProcess( ev, ptr );
+    default:
+        if( ev.hdr.idx >= (int)QueueType::StringData ) return DispatchProcess( ev, ptr );
+        ptr += QueueDataSize[ev.hdr.idx];
+        if( SkipRollingEvent( ev ) ) return true;
+        return Process( ev );
+    }
+}
+
+// A dump starts in the middle of the data stream. Events referring to zones, frames, locks or GPU
+// queries which were started before the window are skipped, only the time references are kept up
+// to date. Any other failure is a genuine one and stops the dump.
+bool Worker::SkipRollingEvent( const QueueItem& ev )
+{
+    switch( ev.hdr.type )
+    {
+    case QueueType::ZoneEnd:
+    {
+        auto td = GetCurrentThreadData();
+        if( !td->zoneIdStack.empty() ) return false;
+        m_refTimeThread += ev.zoneEnd.time;
+        td->nextZoneId = 0;
+        return true;
+    }
+    case QueueType::ZoneText:
+    case QueueType::ZoneName:
+    case QueueType::ZoneColor:
+    case QueueType::ZoneValue:
+    {
+        auto td = RetrieveThread( m_threadCtx );
+        if( td )
+        {
+            if( td->fiber ) td = td->fiber;
+            if( !td->stack.empty() && std::find( td->zoneIdStack.begin(), td->zoneIdStack.end(), td->nextZoneId ) != td->zoneIdStack.end() ) return false;
+            td->nextZoneId = 0;
+        }
+        m_pendingSingleString = {};
+        return true;
+    }
+    case QueueType::FrameMarkMsgEnd:
+    {
+        auto fd = m_data.frames.Find( ev.frameMark.name );
+        return !fd || fd->frames.empty();
+    }
+    case QueueType::ZoneBeginCallstack:
+    case QueueType::ZoneBeginAllocSrcLocCallstack:
+    case QueueType::MessageCallstack:
+    case QueueType::MessageColorCallstack:
+    case QueueType::MessageLiteralCallstack:
+    case QueueType::MessageLiteralColorCallstack:
+    case QueueType::GpuZoneBeginCallstack:
+    case QueueType::GpuZoneBeginAllocSrcLocCallstack:
+        m_nextCallstack.emplace( GetCurrentThreadData()->id, 0 );
+        return false;
+    case QueueType::LockWait:
+    case QueueType::LockSharedWait:
+        if( !SkipRollingLock( ev.lockWait.id, ev.hdr.type, ev.lockWait.thread ) ) return false;
+        m_refTimeSerial += ev.lockWait.time;
+        return true;
+    case QueueType::LockObtain:
+    case QueueType::LockSharedObtain:
+        if( !SkipRollingLock( ev.lockObtain.id, ev.hdr.type, ev.lockObtain.thread ) ) return false;
+        m_refTimeSerial += ev.lockObtain.time;
+        return true;
+    case QueueType::LockRelease:
+        if( !SkipRollingLock( ev.lockRelease.id, ev.hdr.type, 0 ) ) return false;
+        m_refTimeSerial += ev.lockRelease.time;
+        return true;
+    case QueueType::LockSharedRelease:
+        if( !SkipRollingLock( ev.lockReleaseShared.id, ev.hdr.type, ev.lockReleaseShared.thread ) ) return false;
+        m_refTimeSerial += ev.lockReleaseShared.time;
+        return true;
+    case QueueType::LockMark:
+    {
+        if( m_rollingLocks.find( ev.lockMark.id ) != m_rollingLocks.end() ) return true;
+        auto it = m_data.lockMap.find( ev.lockMark.id );
+        return it == m_data.lockMap.end() || it->second->threadMap.find( ev.lockMark.thread ) == it->second->threadMap.end();
+    }
+    case QueueType::LockTerminate:
+        return m_data.lockMap.find( ev.lockTerminate.id ) == m_data.lockMap.end();
+    case QueueType::GpuZoneEnd:
+    case QueueType::GpuZoneEndSerial:
+    {
+        auto ctx = m_gpuCtxMap[ev.gpuZoneEnd.context].get();
+        if( ctx )
+        {
+            auto td = ctx->threadData.find( ev.gpuZoneEnd.thread );
+            if( td != ctx->threadData.end() && !td->second.stack.empty() ) return false;
+        }
+        if( ev.hdr.type == QueueType::GpuZoneEndSerial )
+        {
+            m_refTimeSerial += ev.gpuZoneEnd.cpuTime;
+        }
+        else
+        {
+            m_refTimeThread += ev.gpuZoneEnd.cpuTime;
+        }
+        return true;
+    }
+    case QueueType::GpuTime:
+    {
+        auto ctx = m_gpuCtxMap[ev.gpuTime.context].get();
+        if( ctx && ctx->query[ev.gpuTime.queryId] ) return false;
+        m_refTimeGpu += ev.gpuTime.gpuTime;
+        return true;
+    }
+    case QueueType::FiberLeave:
+    {
+        auto td = RetrieveThread( ev.fiberLeave.thread );
+        if( td && td->fiber ) return false;
+        m_refTimeThread += ev.fiberLeave.time;
+        return true;
+    }
     default:
-        assert( false );
-        break;
+        return false;
     }
+}
 
-    return m_failure == Failure::None;
+bool Worker::SkipRollingLock( uint32_t id, QueueType type, uint32_t thread )
+{
+    auto it = m_rollingLocks.find( id );
+    if( it == m_rollingLocks.end() ) return m_data.lockMap.find( id ) == m_data.lockMap.end();
+    it->second.Update( type, thread );
+    if( it->second.Idle() ) m_rollingLocks.erase( it );
+    return true;
+}
+
+bool Worker::InjectRollingReplies()
+{
+    // Replies may issue further queries, which are appended and answered in the same pass.
+    for( size_t i=0; i<m_rollingQueries.size(); i++ )
+    {
+        const auto query = m_rollingQueries[i];
+        auto& replies = m_rolling->replies[query.first];
+        auto it = replies.find( query.second );
+        if( it == replies.end() )
+        {
+            if( query.first == ServerQuerySourceLocation )
+            {
+                auto sit = std::find( m_sourceLocationQueue.begin(), m_sourceLocationQueue.end(), query.second );
+                if( sit != m_sourceLocationQueue.end() ) m_sourceLocationQueue.erase( sit );
+            }
+            continue;
+        }
+        const char* ptr = it->second.data();
+        const char* end = ptr + it->second.size();
+        while( ptr < end )
+        {
+            auto ev = (const QueueItem*)ptr;
+            if( !DispatchProcess( *ev, ptr ) ) return false;
+        }
+    }
+    m_rollingQueries.clear();
+    return true;
 }
 
 void Worker::ProcessThreadContext( const QueueThreadContext& ev )
@@ -5222,6 +6669,11 @@ void Worker::FiberLeaveFailure()
     m_failure = Failure::FiberLeave;
 }
 
+void Worker::CallstackCacheMissFailure()
+{
+    m_failure = Failure::CallstackCacheMiss;
+}
+
 void Worker::ProcessZoneValidation( const QueueZoneValidation& ev )
 {
     auto td = GetCurrentThreadData();
@@ -5662,24 +7114,22 @@ void Worker::ProcessLockMark( const QueueLockMark& ev )
     auto& lockmap = *lit->second;
     auto tid = lockmap.threadMap.find( ev.thread );
     assert( tid != lockmap.threadMap.end() );
-    const auto thread = tid->second;
-    auto it = lockmap.timeline.end();
+    const auto& events = lockmap.threadEvents[tid->second];
+    auto it = events.end();
     for(;;)
     {
         --it;
-        if( it->ptr->thread == thread )
+        auto lev = lockmap.timeline[*it].ptr;
+        switch( lev->type )
         {
-            switch( it->ptr->type )
-            {
-            case LockEvent::Type::Obtain:
-            case LockEvent::Type::ObtainShared:
-            case LockEvent::Type::Wait:
-            case LockEvent::Type::WaitShared:
-                it->ptr->SetSrcLoc( ShrinkSourceLocation( ev.srcloc ) );
-                return;
-            default:
-                break;
-            }
+        case LockEvent::Type::Obtain:
+        case LockEvent::Type::ObtainShared:
+        case LockEvent::Type::Wait:
+        case LockEvent::Type::WaitShared:
+            lev->SetSrcLoc( ShrinkSourceLocation( ev.srcloc ) );
+            return;
+        default:
+            break;
         }
     }
 }
@@ -6185,6 +7635,7 @@ MemEvent* Worker::ProcessMemAllocImpl( uint64_t memname, MemData& memdata, const
     mem.SetTimeThreadFree( -1, 0 );
     mem.SetCsAlloc( 0 );
     mem.csFree.SetVal( 0 );
+    UpdateMemFreeIndexAlloc( memdata );
 
     const auto low = memdata.low;
     const auto high = memdata.high;
@@ -6222,6 +7673,7 @@ MemEvent* Worker::ProcessMemFreeImpl( uint64_t memname, MemData& memdata, const
     memdata.frees.push_back( it->second );
     auto& mem = memdata.data[it->second];
     mem.SetTimeThreadFree( time, CompressThread( ev.thread ) );
+    UpdateMemFreeIndexFree( memdata, it->second, time );
     memdata.usage -= mem.Size();
     memdata.active.erase( it );
 
@@ -6342,6 +7794,17 @@ void Worker::ProcessCallstack()
     m_pendingCallstackId = 0;
 }
 
+void Worker::ProcessCallstackCached( const QueueCallstackCached& ev )
+{
+    assert( m_pendingCallstackId == 0 );
+    if( ev.id >= m_callstackCache.size() || m_callstackCache[ev.id] == 0 )
+    {
+        CallstackCacheMissFailure();
+        return;
+    }
+    m_pendingCallstackId = m_callstackCache[ev.id];
+}
+
 void Worker::ProcessCallstackSampleInsertSample( const SampleData& sd, ThreadData& td )
 {
     const auto t = sd.time.Val();
@@ -6616,6 +8079,21 @@ void Worker::ProcessCallstackFrameSize( const QueueCallstackFrameSize& ev )
     }
 }
 
+// Inlined frames of the profiler's own code, which are hidden.
+static bool IsSkippedSubframe( const char* file )
+{
+    auto flen = strlen( file );
+    if( flen < s_tracySkipSubframesMinLen ) return false;
+    auto ptr = s_tracySkipSubframes;
+    do
+    {
+        if( flen >= ptr->len && memcmp( file + flen - ptr->len, ptr->str, ptr->len ) == 0 ) return true;
+        ptr++;
+    }
+    while( ptr->str );
+    return false;
+}
+
 void Worker::ProcessCallstackFrame( const QueueCallstackFrame& ev, bool querySymbols )
 {
     assert( m_pendingCallstackSubframes > 0 );
@@ -6628,25 +8106,11 @@ void Worker::ProcessCallstackFrame( const QueueCallstackFrame& ev, bool querySym
         const auto idx = m_callstackFrameStaging->size - m_pendingCallstackSubframes;
         const auto file = StringIdx( fitidx );
 
-        if( m_pendingCallstackSubframes > 1 && idx == 0 )
+        if( m_pendingCallstackSubframes > 1 && idx == 0 && IsSkippedSubframe( GetString( file ) ) )
         {
-            auto fstr = GetString( file );
-            auto flen = strlen( fstr );
-            if( flen >= s_tracySkipSubframesMinLen )
-            {
-                auto ptr = s_tracySkipSubframes;
-                do
-                {
-                    if( flen >= ptr->len && memcmp( fstr + flen - ptr->len, ptr->str, ptr->len ) == 0 )
-                    {
-                        m_pendingCallstackSubframes--;
-                        m_callstackFrameStaging->size--;
-                        return;
-                    }
-                    ptr++;
-                }
-                while( ptr->str );
-            }
+            m_pendingCallstackSubframes--;
+            m_callstackFrameStaging->size--;
+            return;
         }
 
         const auto name = StringIdx( nitidx );
@@ -6832,6 +8296,24 @@ void Worker::ProcessCodeInformation( const QueueCodeInformation& ev )
     }
 }
 
+void Worker::ProcessImageInfo( const QueueImageInfo& ev )
+{
+    const auto path = StringIdx( GetSingleStringIdx() );
+    const auto buildId = StringIdx( GetSecondStringIdx() );
+
+    // Images are announced again on each connection.
+    for( auto& v : m_data.images )
+    {
+        if( v.path.Idx() == path.Idx() )
+        {
+            v.base = ev.base;
+            v.buildId = buildId;
+            return;
+        }
+    }
+    m_data.images.push_back( ImageData { ev.base, path, buildId } );
+}
+
 void Worker::ProcessCrashReport( const QueueCrashReport& ev )
 {
     CheckString( ev.text );
@@ -7190,13 +8672,16 @@ void Worker::CreateMemAllocPlot( MemData& memdata )
     m_data.plots.Data().push_back( memdata.plot );
 }
 
-void Worker::ReconstructMemAllocPlot( MemData& mem )
+void Worker::ReconstructMemAllocPlot( MemData& mem, bool sortFrees )
 {
+    if( sortFrees )
+    {
 #ifdef NO_PARALLEL_SORT
-    pdqsort_branchless( mem.frees.begin(), mem.frees.end(), [&mem] ( const auto& lhs, const auto& rhs ) { return mem.data[lhs].TimeFree() < mem.data[rhs].TimeFree(); } );
+        pdqsort_branchless( mem.frees.begin(), mem.frees.end(), [&mem] ( const auto& lhs, const auto& rhs ) { return mem.data[lhs].TimeFree() < mem.data[rhs].TimeFree(); } );
 #else
-    std::sort( std::execution::par_unseq, mem.frees.begin(), mem.frees.end(), [&mem] ( const auto& lhs, const auto& rhs ) { return mem.data[lhs].TimeFree() < mem.data[rhs].TimeFree(); } );
+        std::sort( std::execution::par_unseq, mem.frees.begin(), mem.frees.end(), [&mem] ( const auto& lhs, const auto& rhs ) { return mem.data[lhs].TimeFree() < mem.data[rhs].TimeFree(); } );
 #endif
+    }
 
     const auto psz = mem.data.size() + mem.frees.size() + 1;
 
@@ -7294,12 +8779,137 @@ void Worker::ReconstructMemAllocPlot( MemData& mem )
     plot->min = 0;
     plot->max = max;
     plot->sum = sum;
+    UpdatePlotLod( *plot );
 
     std::lock_guard<std::mutex> lock( m_data.lock );
     m_data.plots.Data().insert( m_data.plots.Data().begin(), plot );
     mem.plot = plot;
 }
 
+void Worker::BuildMemFreeIndex( MemData& mem )
+{
+    const auto sz = mem.data.size();
+    const auto nb = ( sz + MemIndexSize - 1 ) >> MemIndexShift;
+    for( auto& v : mem.freeIdx ) v.clear();
+    mem.freeMax.clear();
+    mem.activeCnt.clear();
+    mem.freeMax.reserve( nb );
+    mem.activeCnt.reserve( nb );
+    mem.freeIdx[0].reserve( nb );
+
+    auto ptr = mem.data.data();
+    for( size_t i=0; i<nb; i++ )
+    {
+        const auto end = std::min( sz, ( i + 1 ) << MemIndexShift );
+        int64_t fmax = -1;
+        uint8_t cnt = 0;
+        for( size_t j=( i << MemIndexShift ); j<end; j++ )
+        {
+            const auto tf = ptr[j].TimeFree();
+            if( tf < 0 ) cnt++;
+            else if( fmax < tf ) fmax = tf;
+        }
+        mem.freeMax.push_back( fmax );
+        mem.activeCnt.push_back( cnt );
+        mem.freeIdx[0].push_back( cnt != 0 ? std::numeric_limits<int64_t>::max() : fmax );
+    }
+    for( int l=1; l<MemIndexLevels; l++ )
+    {
+        const auto& src = mem.freeIdx[l-1];
+        auto& dst = mem.freeIdx[l];
+        const auto ssz = src.size();
+        for( size_t i=0; i<ssz; i+=MemIndexSize )
+        {
+            const auto end = std::min( ssz, i + MemIndexSize );
+            int64_t v = src[i];
+            for( size_t j=i+1; j<end; j++ ) if( v < src[j] ) v = src[j];
+            dst.push_back( v );
+        }
+    }
+}
+
+void Worker::UpdateMemFreeIndexAlloc( MemData& mem )
+{
+    const auto idx = mem.data.size() - 1;
+    if( ( idx & ( MemIndexSize - 1 ) ) == 0 )
+    {
+        mem.freeMax.push_back( -1 );
+        mem.activeCnt.push_back( 1 );
+    }
+    else
+    {
+        mem.activeCnt.back()++;
+    }
+    auto i = idx;
+    for( auto& v : mem.freeIdx )
+    {
+        i >>= MemIndexShift;
+        if( i == v.size() )
+        {
+            v.push_back( std::numeric_limits<int64_t>::max() );
+        }
+        else
+        {
+            v[i] = std::numeric_limits<int64_t>::max();
+        }
+    }
+}
+
+void Worker::UpdateMemFreeIndexFree( MemData& mem, size_t idx, int64_t time )
+{
+    auto i = idx >> MemIndexShift;
+    if( mem.freeMax[i] < time ) mem.freeMax[i] = time;
+    if( --mem.activeCnt[i] != 0 ) return;
+
+    // The last active allocation in the item is gone. Parent items may drop to a finite free time.
+    mem.freeIdx[0][i] = mem.freeMax[i];
+    for( int l=1; l<MemIndexLevels; l++ )
+    {
+        const auto& src = mem.freeIdx[l-1];
+        i >>= MemIndexShift;
+        const auto c0 = i << MemIndexShift;
+        const auto c1 = std::min<size_t>( src.size(), c0 + MemIndexSize );
+        int64_t v = src[c0];
+        for( size_t j=c0+1; j<c1; j++ ) if( v < src[j] ) v = src[j];
+        if( mem.freeIdx[l][i] == v ) return;
+        mem.freeIdx[l][i] = v;
+    }
+}
+
+static void GetMemActiveAtLevel( const MemData& mem, int level, size_t item, size_t first, size_t last, int64_t time, std::vector<const MemEvent*>& out )
+{
+    if( mem.freeIdx[level][item] < time ) return;
+    const auto c0 = item << MemIndexShift;
+    if( level == 0 )
+    {
+        const auto i0 = std::max( first, c0 );
+        const auto i1 = std::min( last, c0 + MemIndexSize );
+        auto ptr = mem.data.data();
+        for( size_t i=i0; i<i1; i++ )
+        {
+            const auto tf = ptr[i].TimeFree();
+            if( tf < 0 || tf >= time ) out.emplace_back( ptr + i );
+        }
+    }
+    else
+    {
+        const auto shift = MemIndexShift * level;
+        const auto i0 = std::max( first >> shift, c0 );
+        const auto i1 = std::min( ( ( last - 1 ) >> shift ) + 1, c0 + MemIndexSize );
+        for( size_t i=i0; i<i1; i++ ) GetMemActiveAtLevel( mem, level-1, i, first, last, time, out );
+    }
+}
+
+void Worker::GetMemActiveAt( const MemData& mem, size_t first, size_t last, int64_t time, std::vector<const MemEvent*>& out )
+{
+    assert( last <= mem.data.size() );
+    if( first >= last ) return;
+    constexpr int level = MemIndexLevels - 1;
+    const auto shift = MemIndexShift * MemIndexLevels;
+    const auto i1 = ( ( last - 1 ) >> shift ) + 1;
+    for( size_t i=( first >> shift ); i<i1; i++ ) GetMemActiveAtLevel( mem, level, i, first, last, time, out );
+}
+
 #ifndef TRACY_NO_STATISTICS
 void Worker::ReconstructContextSwitchUsage()
 {
@@ -7636,7 +9246,11 @@ int64_t Worker::ReadTimelineHaveSize( FileRead& f, ZoneEvent* zone, int64_t refT
         const auto idx = childIdx;
         childIdx++;
         zone->SetChild( idx );
-        return ReadTimeline( f, m_data.zoneChildren[idx], sz, refTime, childIdx );
+        refTime = ReadTimeline( f, m_data.zoneChildren[idx], sz, refTime, childIdx );
+#ifndef TRACY_NO_STATISTICS
+        m_data.zoneParentIndex.push_back( ZoneParentRange { ((Vector<ZoneEvent>*)&m_data.zoneChildren[idx])->data(), zone, sz } );
+#endif
+        return refTime;
     }
 }
 
@@ -7726,6 +9340,183 @@ void Worker::ReconstructZoneStatistics( GpuEvent& zone, uint16_t thread )
         slz.sumSq += double( timeSpan ) * timeSpan;
     }
 }
+
+void Worker::ReconstructZoneLists( Vector<short_ptr<ZoneEvent>>& _vec, uint16_t thread )
+{
+    if( m_shutdown.load( std::memory_order_relaxed ) ) return;
+    assert( _vec.is_magic() );
+    auto& vec = *(Vector<ZoneEvent>*)( &_vec );
+    for( auto& zone : vec )
+    {
+        if( zone.IsEndValid() && zone.End() > zone.Start() )
+        {
+            auto it = m_data.sourceLocationZones.find( zone.SrcLoc() );
+            assert( it != m_data.sourceLocationZones.end() );
+            ZoneThreadData ztd;
+            ztd.SetZone( &zone );
+            ztd.SetThread( thread );
+            it->second.zones.push_back( ztd );
+        }
+        if( zone.HasChildren() ) ReconstructZoneLists( GetZoneChildrenMutable( zone.Child() ), thread );
+    }
+}
+
+void Worker::ReconstructZoneLists( Vector<short_ptr<GpuEvent>>& _vec, uint16_t thread )
+{
+    if( m_shutdown.load( std::memory_order_relaxed ) ) return;
+    assert( _vec.is_magic() );
+    auto& vec = *(Vector<GpuEvent>*)( &_vec );
+    for( auto& zone : vec )
+    {
+        if( zone.GpuEnd() >= 0 && zone.GpuEnd() > zone.GpuStart() )
+        {
+            auto it = m_data.gpuSourceLocationZones.find( zone.SrcLoc() );
+            if( it == m_data.gpuSourceLocationZones.end() )
+            {
+                it = m_data.gpuSourceLocationZones.emplace( zone.SrcLoc(), GpuSourceLocationZones {} ).first;
+            }
+            GpuZoneThreadData ztd;
+            ztd.SetZone( &zone );
+            ztd.SetThread( thread );
+            it->second.zones.push_back( ztd );
+        }
+        if( zone.Child() >= 0 ) ReconstructZoneLists( GetGpuChildrenMutable( zone.Child() ), thread );
+    }
+}
+
+// The statistics section contains the per source location aggregates, which can't be cheaply
+// derived, context switch usage and memory frees in time order. Zone lists are not stored, as
+// mapping stored references to zones would cost as much as collecting the lists from the loaded
+// timelines. This is done by the background thread, which then has no aggregates to compute.
+// The section is written only by builds with statistics enabled, so update drops it.
+void Worker::ReadStatistics( FileRead& f, EventType::Type eventMask )
+{
+    uint64_t sz;
+    f.Read( sz );
+    for( uint64_t i=0; i<sz; i++ )
+    {
+        int16_t id;
+        f.Read( id );
+        auto it = m_data.sourceLocationZones.find( id );
+        if( it == m_data.sourceLocationZones.end() )
+        {
+            // No zones with this source location were loaded, so there's nothing to apply the entry to.
+            f.Skip( sizeof( uint64_t ) * 10 + sizeof( double ) );
+            continue;
+        }
+        auto& slz = it->second;
+        uint64_t nonReentrantCount;
+        f.Read4( slz.min, slz.max, slz.total, slz.sumSq );
+        f.Read3( slz.selfMin, slz.selfMax, slz.selfTotal );
+        f.Read4( nonReentrantCount, slz.nonReentrantMin, slz.nonReentrantMax, slz.nonReentrantTotal );
+        slz.nonReentrantCount = nonReentrantCount;
+    }
+    m_data.sourceLocationZonesLoaded = true;
+
+    f.Read( sz );
+    for( uint64_t i=0; i<sz; i++ )
+    {
+        int16_t id;
+        f.Read( id );
+        auto it = m_data.gpuSourceLocationZones.find( id );
+        if( it == m_data.gpuSourceLocationZones.end() )
+        {
+            it = m_data.gpuSourceLocationZones.emplace( id, GpuSourceLocationZones {} ).first;
+        }
+        auto& slz = it->second;
+        f.Read4( slz.min, slz.max, slz.total, slz.sumSq );
+    }
+    m_data.gpuSourceLocationZonesLoaded = true;
+
+    f.Read( sz );
+    if( sz != 0 && ( eventMask & EventType::ContextSwitches ) && !m_data.ctxSwitch.empty() && m_data.cpuDataCount != 0 )
+    {
+        m_data.ctxUsage.reserve_exact( sz, m_slab );
+        f.Read( m_data.ctxUsage.data(), sz * sizeof( ContextSwitchUsage ) );
+        m_data.ctxUsageReady = true;
+    }
+    else
+    {
+        f.Skip( sz * sizeof( ContextSwitchUsage ) );
+    }
+
+    f.Read( sz );
+    for( uint64_t i=0; i<sz; i++ )
+    {
+        uint64_t name, fsz;
+        f.Read2( name, fsz );
+        auto it = m_data.memNameMap.find( name );
+        if( it != m_data.memNameMap.end() && it->second->reconstruct && it->second->frees.size() == fsz )
+        {
+            auto& mem = *it->second;
+            f.Read( mem.frees.data(), fsz * sizeof( uint32_t ) );
+            ReconstructMemAllocPlot( mem, false );
+            mem.reconstruct = false;
+        }
+        else
+        {
+            f.Skip( fsz * sizeof( uint32_t ) );
+        }
+    }
+}
+
+void Worker::WriteStatistics( FileWrite& f )
+{
+    uint64_t sz = m_data.sourceLocationZones.size();
+    f.Write( &sz, sizeof( sz ) );
+    for( auto& v : m_data.sourceLocationZones )
+    {
+        int16_t id = v.first;
+        auto& slz = v.second;
+        uint64_t nonReentrantCount = slz.nonReentrantCount;
+        f.Write( &id, sizeof( id ) );
+        f.Write( &slz.min, sizeof( slz.min ) );
+        f.Write( &slz.max, sizeof( slz.max ) );
+        f.Write( &slz.total, sizeof( slz.total ) );
+        f.Write( &slz.sumSq, sizeof( slz.sumSq ) );
+        f.Write( &slz.selfMin, sizeof( slz.selfMin ) );
+        f.Write( &slz.selfMax, sizeof( slz.selfMax ) );
+        f.Write( &slz.selfTotal, sizeof( slz.selfTotal ) );
+        f.Write( &nonReentrantCount, sizeof( nonReentrantCount ) );
+        f.Write( &slz.nonReentrantMin, sizeof( slz.nonReentrantMin ) );
+        f.Write( &slz.nonReentrantMax, sizeof( slz.nonReentrantMax ) );
+        f.Write( &slz.nonReentrantTotal, sizeof( slz.nonReentrantTotal ) );
+    }
+
+    sz = m_data.gpuSourceLocationZones.size();
+    f.Write( &sz, sizeof( sz ) );
+    for( auto& v : m_data.gpuSourceLocationZones )
+    {
+        int16_t id = v.first;
+        auto& slz = v.second;
+        f.Write( &id, sizeof( id ) );
+        f.Write( &slz.min, sizeof( slz.min ) );
+        f.Write( &slz.max, sizeof( slz.max ) );
+        f.Write( &slz.total, sizeof( slz.total ) );
+        f.Write( &slz.sumSq, sizeof( slz.sumSq ) );
+    }
+
+    sz = m_data.ctxUsage.size();
+    f.Write( &sz, sizeof( sz ) );
+    if( sz != 0 ) f.Write( m_data.ctxUsage.data(), sz * sizeof( ContextSwitchUsage ) );
+
+    sz = 0;
+    for( auto& memory : m_data.memNameMap )
+    {
+        if( memory.second->plot ) sz++;
+    }
+    f.Write( &sz, sizeof( sz ) );
+    for( auto& memory : m_data.memNameMap )
+    {
+        auto& mem = *memory.second;
+        if( !mem.plot ) continue;
+        uint64_t name = memory.first;
+        uint64_t fsz = mem.frees.size();
+        f.Write( &name, sizeof( name ) );
+        f.Write( &fsz, sizeof( fsz ) );
+        if( fsz != 0 ) f.Write( mem.frees.data(), fsz * sizeof( uint32_t ) );
+    }
+}
 #else
 void Worker::CountZoneStatistics( ZoneEvent* zone )
 {
@@ -8032,6 +9823,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
 
     sz = m_data.lockMap.size();
     f.Write( &sz, sizeof( sz ) );
+    f.BeginSection( FileSection::Locks );
     for( auto& v : m_data.lockMap )
     {
         f.Write( &v.first, sizeof( v.first ) );
@@ -8059,11 +9851,13 @@ void Worker::Write( FileWrite& f, bool fiDict )
             f.Write( &lev.ptr->type, sizeof( lev.ptr->type ) );
         }
     }
+    f.EndSection();
 
     {
         int64_t refTime = 0;
         sz = m_data.messages.size();
         f.Write( &sz, sizeof( sz ) );
+        f.BeginSection( FileSection::Messages );
         for( auto& v : m_data.messages )
         {
             const auto ptr = (uint64_t)(MessageData*)v;
@@ -8073,6 +9867,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
             f.Write( &v->color, sizeof( v->color ) );
             f.Write( &v->callstack, sizeof( v->callstack ) );
         }
+        f.EndSection();
     }
 
     sz = m_data.zoneExtra.size();
@@ -8159,6 +9954,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
     sz = m_data.plots.Data().size();
     for( auto& plot : m_data.plots.Data() ) { if( plot->type == PlotType::Memory ) sz--; }
     f.Write( &sz, sizeof( sz ) );
+    f.BeginSection( FileSection::Plots );
     for( auto& plot : m_data.plots.Data() )
     {
         if( plot->type == PlotType::Memory ) continue;
@@ -8180,6 +9976,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
             f.Write( &v.val, sizeof( v.val ) );
         }
     }
+    f.EndSection();
 
     sz = m_data.memNameMap.size();
     f.Write( &sz, sizeof( sz ) );
@@ -8189,6 +9986,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
         sz += memory.second->data.size();
     }
     f.Write( &sz, sizeof( sz ) );
+    f.BeginSection( FileSection::Memory );
     for( auto& memory : m_data.memNameMap )
     {
         uint64_t name = memory.first;
@@ -8227,6 +10025,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
         f.Write( &memdata.usage, sizeof( memdata.usage ) );
         f.Write( &memdata.name, sizeof( memdata.name ) );
     }
+    f.EndSection();
 
     sz = m_data.callstackPayload.size() - 1;
     f.Write( &sz, sizeof( sz ) );
@@ -8253,6 +10052,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
     if( sz != 0 ) f.Write( m_data.appInfo.data(), sizeof( m_data.appInfo[0] ) * sz );
 
     {
+        f.BeginSection( FileSection::FrameImages );
         sz = m_data.frameImage.size();
         if( fiDict )
         {
@@ -8325,6 +10125,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
             const auto image = m_texcomp.Unpack( *fi );
             f.Write( image, fi->w * fi->h / 2 );
         }
+        f.EndSection();
     }
 
     // Only save context switches relevant to active threads.
@@ -8338,6 +10139,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
             ctxValid.emplace_back( it );
         }
     }
+    f.BeginSection( FileSection::ContextSwitches );
     sz = ctxValid.size();
     f.Write( &sz, sizeof( sz ) );
     for( auto& ctx : ctxValid )
@@ -8361,9 +10163,11 @@ void Worker::Write( FileWrite& f, bool fiDict )
             f.Write( &thread, sizeof( thread ) );
         }
     }
+    f.EndSection();
 
     sz = GetContextSwitchPerCpuCount();
     f.Write( &sz, sizeof( sz ) );
+    f.BeginSection( FileSection::ContextSwitchesPerCpu );
     for( int i=0; i<256; i++ )
     {
         sz = m_data.cpuData[i].cs.size();
@@ -8377,6 +10181,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
             f.Write( &thread, sizeof( thread ) );
         }
     }
+    f.EndSection();
 
     sz = m_data.tidToPid.size();
     f.Write( &sz, sizeof( sz ) );
@@ -8408,15 +10213,18 @@ void Worker::Write( FileWrite& f, bool fiDict )
 
     sz = m_data.symbolCode.size();
     f.Write( &sz, sizeof( sz ) );
+    f.BeginSection( FileSection::SymbolCode );
     for( auto& v : m_data.symbolCode )
     {
         f.Write( &v.first, sizeof( v.first ) );
         f.Write( &v.second.len, sizeof( v.second.len ) );
         f.Write( v.second.data, v.second.len );
     }
+    f.EndSection();
 
     sz = m_data.locationCodeAddressList.size();
     f.Write( &sz, sizeof( sz ) );
+    f.BeginSection( FileSection::CodeLocations );
     for( auto& v : m_data.locationCodeAddressList )
     {
         f.Write( &v.first, sizeof( v.first ) );
@@ -8431,6 +10239,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
             f.Write( &diff, sizeof( diff ) );
         }
     }
+    f.EndSection();
 
     sz = m_data.codeSymbolMap.size();
     f.Write( &sz, sizeof( sz ) );
@@ -8455,6 +10264,7 @@ void Worker::Write( FileWrite& f, bool fiDict )
 
     sz = m_data.sourceFileCache.size();
     f.Write( &sz, sizeof( sz ) );
+    f.BeginSection( FileSection::SourceCache );
     for( auto& v : m_data.sourceFileCache )
     {
         uint32_t s32 = strlen( v.first );
@@ -8463,6 +10273,25 @@ void Worker::Write( FileWrite& f, bool fiDict )
         f.Write( &v.second.len, sizeof( v.second.len ) );
         f.Write( v.second.data, v.second.len );
     }
+    f.EndSection();
+
+    if( !m_data.images.empty() )
+    {
+        f.BeginSection( FileSection::Images );
+        sz = m_data.images.size();
+        f.Write( &sz, sizeof( sz ) );
+        f.Write( m_data.images.data(), sizeof( ImageData ) * sz );
+        f.EndSection();
+    }
+
+#ifndef TRACY_NO_STATISTICS
+    if( IsBackgroundDone() && m_data.sourceLocationZonesReady && m_data.gpuSourceLocationZonesReady )
+    {
+        f.BeginSection( FileSection::Statistics );
+        WriteStatistics( f );
+        f.EndSection();
+    }
+#endif
 }
 
 void Worker::WriteTimeline( FileWrite& f, const Vector<short_ptr<ZoneEvent>>& vec, int64_t& refTime )
@@ -8562,6 +10391,7 @@ static const char* s_failureReasons[] = {
     "Frame image offset is invalid.",
     "Multiple frame images were sent for a single frame.",
     "Fiber execution stopped on a thread which is not executing a fiber.",
+    "Cached callstack refers to a callstack that was never sent.",
 };
 
 static_assert( sizeof( s_failureReasons ) / sizeof( *s_failureReasons ) == (int)Worker::Failure::NUM_FAILURES, "Missing failure reason description." );
@@ -8610,6 +10440,8 @@ ZoneExtra& Worker::RequestZoneExtra( ZoneEvent& ev )
 
 void Worker::CacheSource( const StringRef& str, const StringIdx& image )
 {
+    // Source files are cached when a raw capture is replayed, or from disk when a rolling window is dumped.
+    if( m_rawCapture || IsRollingCapture() ) return;
     assert( str.active );
     assert( m_checkedFileStrings.find( str ) == m_checkedFileStrings.end() );
     m_checkedFileStrings.emplace( str );
@@ -8621,7 +10453,7 @@ void Worker::CacheSource( const StringRef& str, const StringIdx& image )
     {
         CacheSourceFromFile( file );
     }
-    else if( execTime != 0 )
+    else if( execTime != 0 && !m_rawReplay && !m_rollingDump )
     {
         m_sourceCodeQuery.emplace_back( file );
         QuerySourceFile( file, image.Active() ? GetString( image ) : nullptr );
@@ -8711,4 +10543,97 @@ void Worker::CacheSourceFiles()
     }
 }
 
+// Vectors read from a trace file live in the slab and cannot grow.
+template<typename T>
+static void MakeGrowable( Vector<T>& vec )
+{
+    Vector<T> tmp;
+    tmp.reserve( vec.size() );
+    if( !vec.empty() ) memcpy( tmp.data(), vec.data(), vec.size() * sizeof( T ) );
+    tmp.set_size( vec.size() );
+    vec = std::move( tmp );
+}
+
+size_t Worker::ResolveImageFrames( const SymbolResolver& resolver )
+{
+    if( m_data.images.empty() ) return 0;
+
+    MakeGrowable( m_data.stringData );
+    MakeGrowable( m_data.symbolLoc );
+    MakeGrowable( m_data.symbolLocInline );
+
+    unordered_flat_map<uint32_t, const ImageData*> images;
+    for( auto& v : m_data.images ) images.emplace( v.path.Idx(), &v );
+
+    const auto unknown = StringIdx( StoreString( "[unknown]", 9 ).idx );
+    size_t cnt = 0;
+    for( auto& v : m_data.callstackFrameMap )
+    {
+        if( v.first.sel != 0 ) continue;
+        auto& data = *v.second;
+        // Frames which are already resolved are kept, so that the trace is only symbolized once.
+        if( data.size != 1 ) continue;
+        // The image may have been loaded at a different base in another connection, so the offset
+        // recorded by the client is used instead of the current base of the image.
+        uint64_t offset;
+        if( sscanf( GetString( data.data[0].name ), "[unresolved] +0x%" SCNx64, &offset ) != 1 ) continue;
+        auto iit = images.find( data.imageName.Idx() );
+        if( iit == images.end() ) continue;
+        const auto& image = *iit->second;
+        const auto imagePath = GetString( image.path );
+        const auto buildId = GetString( image.buildId );
+        const auto base = GetCanonicalPointer( v.first ) - offset;
+
+        const auto frames = resolver( imagePath, buildId, offset );
+        if( !frames || frames->empty() ) continue;
+        const size_t skip = frames->size() > 1 && IsSkippedSubframe( frames->front().file.c_str() ) ? 1 : 0;
+        const auto sz = std::min<size_t>( frames->size() - skip, std::numeric_limits<uint8_t>::max() );
+
+        auto frame = m_slab.Alloc<CallstackFrame>( sz );
+        for( size_t i=0; i<sz; i++ )
+        {
+            const auto& rf = (*frames)[i+skip];
+            auto& cf = frame[i];
+            cf.name = StringIdx( StoreString( rf.name.c_str(), rf.name.size() ).idx );
+            cf.file = StringIdx( StoreString( rf.file.c_str(), rf.file.size() ).idx );
+            cf.line = rf.line;
+            cf.symAddr = rf.symAddr != 0 ? rf.symAddr + base : 0;
+
+            if( cf.symAddr != 0 && m_data.symbolMap.find( cf.symAddr ) == m_data.symbolMap.end() )
+            {
+                // Same as what the client reports for a symbol query, the location of the symbol's first instruction.
+                const auto sym = resolver( imagePath, buildId, rf.symAddr );
+                const bool isInline = i < sz - 1;
+                SymbolData sd;
+                sd.name = cf.name;
+                sd.file = sym && !sym->empty() ? StringIdx( StoreString( sym->front().file.c_str(), sym->front().file.size() ).idx ) : unknown;
+                sd.line = sym && !sym->empty() ? sym->front().line : 0;
+                sd.imageName = data.imageName;
+                sd.callFile = cf.file;
+                sd.callLine = cf.line;
+                sd.isInline = isInline;
+                sd.size.SetVal( rf.symLen );
+                m_data.symbolMap.emplace( cf.symAddr, std::move( sd ) );
+
+                if( !isInline )
+                {
+                    if( m_data.newSymbolsIndex < 0 ) m_data.newSymbolsIndex = int64_t( m_data.symbolLoc.size() );
+                    m_data.symbolLoc.push_back( SymbolLocation { cf.symAddr, rf.symLen } );
+                }
+                else
+                {
+                    if( m_data.newInlineSymbolsIndex < 0 ) m_data.newInlineSymbolsIndex = int64_t( m_data.symbolLocInline.size() );
+                    m_data.symbolLocInline.push_back( cf.symAddr );
+                }
+            }
+        }
+        data.data = frame;
+        data.size = uint8_t( sz );
+        cnt++;
+    }
+    DoPostponedSymbols();
+    DoPostponedInlineSymbols();
+    return cnt;
+}
+
 }
@@ -3,10 +3,14 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <deque>
+#include <functional>
 #include <limits>
+#include <memory>
 #include <mutex>
 #include <shared_mutex>
 #include <stdexcept>
+#include <stdio.h>
 #include <string>
 #include <string.h>
 #include <thread>
@@ -32,6 +36,7 @@ namespace tracy
 
 class FileRead;
 class FileWrite;
+class TaskDispatch;
 
 namespace EventType
 {
@@ -139,6 +144,16 @@ public:
     };
     enum { GpuZoneThreadDataSize = sizeof( GpuZoneThreadData ) };
 
+#pragma pack( push, 1 )
+    // Address range of a contiguous vector of sibling zones, and their common parent.
+    struct ZoneParentRange
+    {
+        short_ptr<ZoneEvent> begin;
+        short_ptr<ZoneEvent> parent;
+        uint32_t size;
+    };
+#pragma pack( pop )
+
     struct CpuThreadTopology
     {
         uint32_t package;
@@ -199,6 +214,7 @@ private:
         int64_t nonReentrantMin = std::numeric_limits<int64_t>::max();
         int64_t nonReentrantMax = std::numeric_limits<int64_t>::min();
         int64_t nonReentrantTotal = 0;
+        uint64_t loadedCount = 0;   // zone count stored in the trace file, known before the zone list is collected
     };
 
     struct GpuSourceLocationZones
@@ -210,6 +226,7 @@ private:
         int64_t max = std::numeric_limits<int64_t>::min();
         int64_t total = 0;
         double sumSq = 0;
+        uint64_t loadedCount = 0;
     };
 
     struct CallstackFrameIdHash
@@ -297,8 +314,10 @@ private:
 #ifndef TRACY_NO_STATISTICS
         unordered_flat_map<int16_t, SourceLocationZones> sourceLocationZones;
         bool sourceLocationZonesReady = false;
+        bool sourceLocationZonesLoaded = false;     // aggregates were read from file, only zone lists are missing
         unordered_flat_map<int16_t, GpuSourceLocationZones> gpuSourceLocationZones;
         bool gpuSourceLocationZonesReady = false;
+        bool gpuSourceLocationZonesLoaded = false;
 #else
         unordered_flat_map<int16_t, uint64_t> sourceLocationZonesCnt;
         unordered_flat_map<int16_t, uint64_t> gpuSourceLocationZonesCnt;
@@ -315,6 +334,7 @@ private:
         int64_t newSymbolsIndex = -1;
         int64_t newInlineSymbolsIndex = -1;
         unordered_flat_map<uint64_t, uint64_t> codeSymbolMap;
+        Vector<ImageData> images;
 
 #ifndef TRACY_NO_STATISTICS
         unordered_flat_map<VarArray<CallstackFrameId>*, uint32_t, VarArrayHasher<CallstackFrameId>, VarArrayComparator<CallstackFrameId>> parentCallstackMap;
@@ -343,6 +363,7 @@ private:
         Vector<Vector<short_ptr<ZoneEvent>>> zoneChildren;
         Vector<Vector<short_ptr<GpuEvent>>> gpuChildren;
 #ifndef TRACY_NO_STATISTICS
+        Vector<ZoneParentRange> zoneParentIndex;    // sorted by address, loaded traces only
         Vector<Vector<GhostZone>> ghostChildren;
         Vector<GhostKey> ghostFrames;
         unordered_flat_map<GhostKey, uint32_t, GhostKeyHasher, GhostKeyComparator> ghostFramesMap;
@@ -421,6 +442,63 @@ private:
         uint32_t csz;
     };
 
+    struct RollingLock
+    {
+        uint32_t exclusive = 0;
+        uint32_t shared = 0;
+        std::vector<uint32_t> waiting;
+
+        void Update( QueueType type, uint32_t thread );
+        bool Idle() const { return exclusive == 0 && shared == 0 && waiting.empty(); }
+    };
+
+    // Decoding state at the start of a block of the rolling window.
+    struct RollingCheckpoint
+    {
+        uint64_t threadCtx = 0;
+        uint64_t refSrcLoc = 0;
+        int64_t refTimeThread = 0;
+        int64_t refTimeSerial = 0;
+        int64_t refTimeCtx = 0;
+        int64_t refTimeGpu = 0;
+        std::vector<std::pair<uint32_t, RollingLock>> locks;
+    };
+
+    struct RollingBlock
+    {
+        int64_t time;
+        uint32_t size;
+        std::vector<char> data;
+        RollingCheckpoint start;
+        std::vector<uint32_t> terminatedLocks;
+    };
+
+    // The event stream of a rolling capture is kept in compressed blocks, which are dropped once
+    // they fall out of the time window. Session wide definitions and the replies to queries are
+    // kept separately, as a dump needs them regardless of where the window starts. These are never
+    // pruned, apart from the definitions of terminated locks, so they grow with the number of
+    // distinct strings, source locations and symbols of the session rather than with its length.
+    struct RollingCapture
+    {
+        int64_t window;
+        std::string trigger;
+        WelcomeMessage welcome;
+        OnDemandPayloadMessage onDemand;
+        bool hasOnDemand = false;
+        std::vector<std::pair<uint32_t, std::string>> prologue;
+        unordered_flat_map<uint64_t, std::string> replies[ServerQueryDataTransferPart+1];
+        // Sealed blocks are not modified anymore and are shared with dumps.
+        std::deque<std::shared_ptr<const RollingBlock>> blocks;
+        std::string current;
+        RollingCheckpoint currentStart;
+        std::vector<uint32_t> currentTerminatedLocks;
+        std::string pending;
+        uint64_t frameKey = 0;
+        unordered_flat_map<uint32_t, RollingLock> locks;
+        unordered_flat_set<uint64_t> triggerStrings;
+        unordered_flat_map<uint32_t, std::string> callstacks;
+    };
+
 public:
     enum class Failure
     {
@@ -437,11 +515,19 @@ public:
         FrameImageIndex,
         FrameImageTwice,
         FiberLeave,
+        CallstackCacheMiss,
 
         NUM_FAILURES
     };
 
-    Worker( const char* addr, uint16_t port );
+    // A raw capture file receives the compressed data stream as it arrives. Events are then only
+    // inspected for the queries they require, so memory use does not grow with the capture length.
+    Worker( const char* addr, uint16_t port, FILE* rawCapture = nullptr );
+    // Replays a raw capture file as if it was received from a client. Takes ownership of the file.
+    Worker( FILE* rawCapture );
+    // A rolling capture keeps only the last rollingWindow nanoseconds of the profiled program's
+    // activity in memory. Messages containing the trigger text are counted.
+    Worker( const char* addr, uint16_t port, int64_t rollingWindow, const char* rollingTrigger = nullptr );
     Worker( const char* name, const char* program, const std::vector<ImportEventTimeline>& timeline, const std::vector<ImportEventMessages>& messages, const std::vector<ImportEventPlots>& plots, const std::unordered_map<uint64_t, std::string>& threadNames );
     Worker( FileRead& f, EventType::Type eventMask = EventType::All, bool bgTasks = true );
     ~Worker();
@@ -566,6 +652,15 @@ public:
     static tracy_force_inline int64_t GetZoneEndDirect( const ZoneEvent& ev ) { return ev.IsEndValid() ? ev.End() : ev.Start(); }
     static tracy_force_inline int64_t GetZoneEndDirect( const GpuEvent& ev ) { return ev.GpuEnd() >= 0 ? ev.GpuEnd() : ev.GpuStart(); }
 
+    // Plot data must be sorted before the level of detail data is updated. Range queries on
+    // plot data items [first, last) only need to touch a few items on each level.
+    static void UpdatePlotLod( PlotData& plot );
+    static PlotLod GetPlotRange( const PlotData& plot, size_t first, size_t last );
+
+    // Appends memory events [first, last) which were not freed before time. Only subtrees of the
+    // free time index which contain such events are visited.
+    static void GetMemActiveAt( const MemData& mem, size_t first, size_t last, int64_t time, std::vector<const MemEvent*>& out );
+
     uint32_t FindStringIdx( const char* str ) const;
     const char* GetString( uint64_t ptr ) const;
     const char* GetString( const StringRef& ref ) const;
@@ -583,6 +678,10 @@ public:
     const char* GetZoneName( const GpuEvent& ev, const SourceLocation& srcloc ) const;
 
     tracy_force_inline const Vector<short_ptr<ZoneEvent>>& GetZoneChildren( int32_t idx ) const { return m_data.zoneChildren[idx]; }
+#ifndef TRACY_NO_STATISTICS
+    // Returns false if the zone is not covered by the parent index. Top level zones have no parent.
+    bool GetZoneParent( const ZoneEvent& zone, const ZoneEvent*& parent ) const;
+#endif
     tracy_force_inline const Vector<short_ptr<GpuEvent>>& GetGpuChildren( int32_t idx ) const { return m_data.gpuChildren[idx]; }
 #ifndef TRACY_NO_STATISTICS
     tracy_force_inline const Vector<GhostZone>& GetGhostChildren( int32_t idx ) const { return m_data.ghostChildren[idx]; }
@@ -603,6 +702,11 @@ public:
     const unordered_flat_map<int16_t, GpuSourceLocationZones>& GetGpuSourceLocationZones() const { return m_data.gpuSourceLocationZones; }
     bool AreSourceLocationZonesReady() const { return m_data.sourceLocationZonesReady; }
     bool AreGpuSourceLocationZonesReady() const { return m_data.gpuSourceLocationZonesReady; }
+    // Aggregates read from the statistics section are usable before the zone lists are collected.
+    bool AreSourceLocationStatisticsReady() const { return m_data.sourceLocationZonesReady || m_data.sourceLocationZonesLoaded; }
+    bool AreGpuSourceLocationStatisticsReady() const { return m_data.gpuSourceLocationZonesReady || m_data.gpuSourceLocationZonesLoaded; }
+    uint64_t GetZoneCount( const SourceLocationZones& slz ) const { return m_data.sourceLocationZonesReady ? slz.zones.size() : slz.loadedCount; }
+    uint64_t GetZoneCount( const GpuSourceLocationZones& slz ) const { return m_data.gpuSourceLocationZonesReady ? slz.zones.size() : slz.loadedCount; }
     bool IsCpuUsageReady() const { return m_data.ctxUsageReady; }
 
     const unordered_flat_map<uint64_t, SymbolStats>& GetSymbolStats() const { return m_data.symbolStats; }
@@ -620,12 +724,18 @@ public:
     std::shared_mutex& GetMbpsDataLock() { return m_mbpsData.lock; }
     const std::vector<float>& GetMbpsData() const { return m_mbpsData.mbps; }
     float GetCompRatio() const { return m_mbpsData.compRatio; }
+    bool HasZstdFrames() const { return m_zstdFrames; }
     size_t GetSendQueueSize() const { return m_mbpsData.queue; }
     size_t GetSendInFlight() const { return m_serverQuerySpaceBase - m_serverQuerySpaceLeft; }
     uint64_t GetDataTransferred() const { return m_mbpsData.transferred; }
 
     bool HasData() const { return m_hasData.load( std::memory_order_acquire ); }
     bool IsConnected() const { return m_connected.load( std::memory_order_relaxed ); }
+    bool IsRawCapture() const { return m_rawCapture != nullptr; }
+    bool IsRollingCapture() const { return m_rolling && !m_rollingDump; }
+    uint32_t GetRollingTriggerCount() const { return m_rollingTriggers.load( std::memory_order_relaxed ); }
+    // Builds a static trace from the current contents of the rolling window.
+    std::unique_ptr<Worker> DumpRollingCapture();
     bool IsDataStatic() const { return !m_thread.joinable(); }
     bool IsBackgroundDone() const { return m_backgroundDone.load( std::memory_order_relaxed ); }
     void Shutdown() { m_shutdown.store( true, std::memory_order_relaxed ); }
@@ -663,16 +773,58 @@ public:
 
     void CacheSourceFiles();
 
+    // Frame of an image resolved from a local copy of the image. The symbol address is relative to the image.
+    struct ResolvedFrame
+    {
+        std::string name;
+        std::string file;
+        uint32_t line;
+        uint64_t symAddr;
+        uint32_t symLen;
+    };
+
+    // Returns the frames at the given offset in the image, the innermost inlined one first, or nullptr if the
+    // address can't be resolved. The returned data must stay valid until ResolveImageFrames() returns.
+    using SymbolResolver = std::function<const std::vector<ResolvedFrame>*( const char* image, const char* buildId, uint64_t offset )>;
+
+    const Vector<ImageData>& GetImages() const { return m_data.images; }
+    size_t ResolveImageFrames( const SymbolResolver& resolver );
+
 private:
+    Worker( std::unique_ptr<RollingCapture>&& rolling );
+
     void Network();
+    bool NetworkIndependentFrames();
     void Exec();
+    void Replay();
+    void SetupSession( const WelcomeMessage& welcome, const OnDemandPayloadMessage* onDemand );
+    void WriteRawFrame( const char* data, lz4sz_t sz );
     void Query( ServerQuery type, uint64_t data, uint32_t extra = 0 );
     void QueryTerminate();
     void QuerySourceFile( const char* fn, const char* image );
     void QueryDataTransfer( const void* ptr, size_t size );
 
     tracy_force_inline bool DispatchProcess( const QueueItem& ev, const char*& ptr );
+    tracy_force_inline const char* DecodeCompact( const char* ptr, QueueItem& item );
     tracy_force_inline bool Process( const QueueItem& ev );
+    tracy_force_inline bool DispatchRaw( const QueueItem& ev, const char*& ptr );
+    tracy_force_inline bool ProcessRaw( const QueueItem& ev );
+    tracy_force_inline void RawNoticeThread( uint64_t thread );
+    tracy_force_inline void RawNoticeFrame( const QueueFrameMark& ev );
+    tracy_force_inline void RawNoticePlot( uint64_t name );
+    tracy_force_inline void RawNoticeTime( int64_t& reference, int64_t delta );
+    tracy_force_inline bool DispatchRolling( const QueueItem& ev, const char*& ptr );
+    bool RecordRolling( const QueueItem& ev, const char* start, const char* end, uint64_t key );
+    void RecordRollingReply( ServerQuery type, uint64_t key, const char* start, const char* end );
+    void RecordRollingLock( uint32_t id, QueueType type, uint32_t thread );
+    void CheckRollingTrigger( const char* text );
+    void SealRollingBlock();
+    void PlayRollingCapture();
+    bool PlayRolling( const char* ptr, size_t size );
+    bool DispatchRollingDump( const QueueItem& ev, const char*& ptr );
+    bool SkipRollingEvent( const QueueItem& ev );
+    bool SkipRollingLock( uint32_t id, QueueType type, uint32_t thread );
+    bool InjectRollingReplies();
     tracy_force_inline void ProcessThreadContext( const QueueThreadContext& ev );
     tracy_force_inline void ProcessZoneBegin( const QueueZoneBegin& ev );
     tracy_force_inline void ProcessZoneBeginCallstack( const QueueZoneBegin& ev );
@@ -731,12 +883,14 @@ private:
     tracy_force_inline void ProcessMemFreeCallstackNamed( const QueueMemFree& ev );
     tracy_force_inline void ProcessCallstackSerial();
     tracy_force_inline void ProcessCallstack();
+    tracy_force_inline void ProcessCallstackCached( const QueueCallstackCached& ev );
     tracy_force_inline void ProcessCallstackSample( const QueueCallstackSample& ev );
     tracy_force_inline void ProcessCallstackSampleContextSwitch( const QueueCallstackSample& ev );
     tracy_force_inline void ProcessCallstackFrameSize( const QueueCallstackFrameSize& ev );
     tracy_force_inline void ProcessCallstackFrame( const QueueCallstackFrame& ev, bool querySymbols );
     tracy_force_inline void ProcessSymbolInformation( const QueueSymbolInformation& ev );
     tracy_force_inline void ProcessCodeInformation( const QueueCodeInformation& ev );
+    tracy_force_inline void ProcessImageInfo( const QueueImageInfo& ev );
     tracy_force_inline void ProcessCrashReport( const QueueCrashReport& ev );
     tracy_force_inline void ProcessSysTime( const QueueSysTime& ev );
     tracy_force_inline void ProcessContextSwitch( const QueueContextSwitch& ev );
@@ -781,6 +935,7 @@ private:
     void FrameImageIndexFailure();
     void FrameImageTwiceFailure();
     void FiberLeaveFailure();
+    void CallstackCacheMissFailure();
 
     tracy_force_inline void CheckSourceLocation( uint64_t ptr );
     void NewSourceLocation( uint64_t ptr );
@@ -794,7 +949,10 @@ private:
 
     tracy_force_inline void MemAllocChanged( uint64_t memname, MemData& memdata, int64_t time );
     void CreateMemAllocPlot( MemData& memdata );
-    void ReconstructMemAllocPlot( MemData& memdata );
+    void ReconstructMemAllocPlot( MemData& memdata, bool sortFrees );
+    static void BuildMemFreeIndex( MemData& memdata );
+    static void UpdateMemFreeIndexAlloc( MemData& memdata );
+    static void UpdateMemFreeIndexFree( MemData& memdata, size_t idx, int64_t time );
 
     void InsertMessageData( MessageData* msg );
 
@@ -917,6 +1075,10 @@ private:
 #ifndef TRACY_NO_STATISTICS
     tracy_force_inline void ReconstructZoneStatistics( uint8_t* countMap, ZoneEvent& zone, uint16_t thread );
     tracy_force_inline void ReconstructZoneStatistics( GpuEvent& zone, uint16_t thread );
+    void ReconstructZoneLists( Vector<short_ptr<ZoneEvent>>& vec, uint16_t thread );
+    void ReconstructZoneLists( Vector<short_ptr<GpuEvent>>& vec, uint16_t thread );
+    void ReadStatistics( FileRead& f, EventType::Type eventMask );
+    void WriteStatistics( FileWrite& f );
 #else
     tracy_force_inline void CountZoneStatistics( ZoneEvent* zone );
     tracy_force_inline void CountZoneStatistics( GpuEvent* zone );
@@ -969,6 +1131,7 @@ private:
     bool m_crashed = false;
     bool m_disconnect = false;
     void* m_stream;     // LZ4_streamDecode_t*
+    void* m_streamZstd = nullptr;   // ZSTD_DStream*
     char* m_buffer;
     int m_bufferOffset;
     bool m_onDemand;
@@ -976,10 +1139,13 @@ private:
     bool m_codeTransfer;
     bool m_combineSamples;
     bool m_identifySamples;
+    bool m_independentFrames = false;
+    bool m_zstdFrames = false;
     bool m_inconsistentSamples;
 
     short_ptr<GpuCtxData> m_gpuCtxMap[256];
     uint32_t m_pendingCallstackId = 0;
+    std::vector<uint32_t> m_callstackCache;
     int16_t m_pendingSourceLocationPayload = 0;
     Vector<uint64_t> m_sourceLocationQueue;
     unordered_flat_map<uint64_t, int16_t> m_sourceLocationShrink;
@@ -1034,12 +1200,25 @@ private:
     size_t m_frameImageBufferSize = 0;
     TextureCompression m_texcomp;
 
+    FILE* m_rawCapture = nullptr;
+    FILE* m_rawReplay = nullptr;
+    std::string m_rawSingleString, m_rawSecondString;
+    uint64_t m_rawThreadLast = std::numeric_limits<uint64_t>::max();
+    int64_t m_rawOpenZones = 0;
+
+    std::unique_ptr<RollingCapture> m_rolling;
+    std::atomic<uint32_t> m_rollingTriggers { 0 };
+    bool m_rollingDump = false;
+    std::vector<std::pair<ServerQuery, uint64_t>> m_rollingQueries;
+    unordered_flat_map<uint32_t, RollingLock> m_rollingLocks;
+
     uint64_t m_threadCtx = 0;
     ThreadData* m_threadCtxData = nullptr;
     int64_t m_refTimeThread = 0;
     int64_t m_refTimeSerial = 0;
     int64_t m_refTimeCtx = 0;
     int64_t m_refTimeGpu = 0;
+    uint64_t m_refSrcLoc = 0;
 
     std::atomic<uint64_t> m_bytes { 0 };
     std::atomic<uint64_t> m_decBytes { 0 };
@@ -1050,10 +1229,16 @@ private:
         int size;
     };
 
+    // Maximum number of in-flight frames when the client compresses each frame independently.
+    enum { NetFrameSlots = 8 };
+
     std::vector<NetBuffer> m_netRead;
     std::mutex m_netReadLock;
     std::condition_variable m_netReadCv;
 
+    std::unique_ptr<char[]> m_netLz4Buf;
+    std::unique_ptr<TaskDispatch> m_netDispatch;
+
     int m_netWriteCnt = 0;
     std::mutex m_netWriteLock;
     std::condition_variable m_netWriteCv;
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <assert.h>
+#include <mutex>
+#include <string>
+
+#include "TracySort.hpp"
+#include "TracyTaskDispatch.hpp"
+#include "TracyWorker.hpp"
+#include "TracyZoneCompare.hpp"
+
+namespace tracy
+{
+
+ZoneCompare::~ZoneCompare()
+{
+    m_cancel.store( true, std::memory_order_relaxed );
+    if( m_thread.joinable() ) m_thread.join();
+}
+
+void ZoneCompare::Start( Worker& w0, Worker& w1 )
+{
+    assert( !m_thread.joinable() );
+    m_done.store( false, std::memory_order_relaxed );
+    m_cancel.store( false, std::memory_order_relaxed );
+    m_thread = std::thread( [this, &w0, &w1] {
+        m_next = Run( w0, w1 );
+        m_done.store( true, std::memory_order_release );
+    } );
+}
+
+bool ZoneCompare::Update()
+{
+    if( !m_thread.joinable() || !m_done.load( std::memory_order_acquire ) ) return false;
+    m_thread.join();
+    if( m_cancel.load( std::memory_order_relaxed ) )
+    {
+        m_next.clear();
+        return false;
+    }
+    m_result = std::move( m_next );
+    m_next = std::vector<ZoneCompareEntry>();
+    return true;
+}
+
+#ifndef TRACY_NO_STATISTICS
+static std::string GetSourceLocationKey( const Worker& worker, int16_t id )
+{
+    const auto& srcloc = worker.GetSourceLocation( id );
+    std::string key = worker.GetString( srcloc.name.active ? srcloc.name : srcloc.function );
+    key += '\0';
+    key += worker.GetString( srcloc.file );
+    key += '\0';
+    key += std::to_string( srcloc.line );
+    return key;
+}
+
+// Times of completed zones, copied in batches so that the data lock is not held for long.
+static int64_t GetZoneTimes( Worker& worker, int16_t srcloc, std::vector<int64_t>& out, size_t batch, const std::atomic<bool>& cancel )
+{
+    int64_t total = 0;
+    size_t pos = 0;
+    out.clear();
+    for(;;)
+    {
+        if( cancel.load( std::memory_order_relaxed ) ) return 0;
+        std::lock_guard<std::mutex> lock( worker.GetDataLock() );
+        const auto& zones = ( (const Worker&)worker ).GetZonesForSourceLocation( srcloc ).zones;
+        const auto end = std::min( zones.size(), pos + batch );
+        for( ; pos<end; pos++ )
+        {
+            const auto& zone = *zones[pos].Zone();
+            if( !zone.IsEndValid() ) continue;
+            const auto t = zone.End() - zone.Start();
+            out.push_back( t );
+            total += t;
+        }
+        if( pos == zones.size() ) return total;
+    }
+}
+#endif
+
+std::vector<ZoneCompareEntry> ZoneCompare::Run( Worker& w0, Worker& w1, const std::function<bool(const char*)>& filter )
+{
+    std::vector<ZoneCompareEntry> ret;
+#ifndef TRACY_NO_STATISTICS
+    m_progress.store( 0, std::memory_order_relaxed );
+    m_total.store( 0, std::memory_order_relaxed );
+
+    unordered_flat_map<std::string, int16_t> keys;
+    {
+        std::lock_guard<std::mutex> lock( w1.GetDataLock() );
+        for( auto& v : w1.GetSourceLocationZones() )
+        {
+            if( !v.second.zones.empty() ) keys.emplace( GetSourceLocationKey( w1, v.first ), v.first );
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock( w0.GetDataLock() );
+        for( auto& v : w0.GetSourceLocationZones() )
+        {
+            if( v.second.zones.empty() ) continue;
+            if( filter && !filter( w0.GetZoneName( w0.GetSourceLocation( v.first ) ) ) ) continue;
+            auto it = keys.find( GetSourceLocationKey( w0, v.first ) );
+            if( it == keys.end() ) continue;
+            ZoneCompareEntry entry = {};
+            entry.srcloc[0] = v.first;
+            entry.srcloc[1] = it->second;
+            entry.count[0] = v.second.zones.size();
+            ret.emplace_back( entry );
+        }
+    }
+    keys = unordered_flat_map<std::string, int16_t>();
+    m_total.store( ret.size(), std::memory_order_relaxed );
+
+    // The task queue is processed from its back, so the largest source locations go first.
+    pdqsort_branchless( ret.begin(), ret.end(), []( const auto& lhs, const auto& rhs ) { return lhs.count[0] < rhs.count[0]; } );
+
+    Worker* workers[2] = { &w0, &w1 };
+    TaskDispatch td( std::max<int>( std::thread::hardware_concurrency() - 1, 1 ) );
+    for( auto& v : ret )
+    {
+        td.Queue( [this, &v, &workers] {
+            std::vector<int64_t> times;
+            for( int k=0; k<2; k++ )
+            {
+                v.total[k] = GetZoneTimes( *workers[k], v.srcloc[k], times, BatchSize, m_cancel );
+                v.count[k] = times.size();
+                if( times.empty() ) continue;
+                const auto median = times.begin() + times.size() / 2;
+                std::nth_element( times.begin(), median, times.end() );
+                v.median[k] = *median;
+                const auto p90 = times.begin() + times.size() * 9 / 10;
+                std::nth_element( median, p90, times.end() );
+                v.p90[k] = *p90;
+                const auto p99 = times.begin() + times.size() * 99 / 100;
+                std::nth_element( p90, p99, times.end() );
+                v.p99[k] = *p99;
+            }
+            m_progress.fetch_add( 1, std::memory_order_relaxed );
+        } );
+    }
+    td.Sync();
+
+    if( m_cancel.load( std::memory_order_relaxed ) ) return {};
+    ret.erase( std::remove_if( ret.begin(), ret.end(), []( const auto& v ) { return v.count[0] == 0 || v.count[1] == 0; } ), ret.end() );
+#endif
+    return ret;
+}
+
+}
@@ -0,0 +1,66 @@
+#ifndef __TRACYZONECOMPARE_HPP__
+#define __TRACYZONECOMPARE_HPP__
+
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace tracy
+{
+
+class Worker;
+
+struct ZoneCompareEntry
+{
+    int16_t srcloc[2];
+    uint64_t count[2];
+    int64_t total[2];
+    int64_t median[2];
+    int64_t p90[2];
+    int64_t p99[2];
+};
+
+// Compares the zone times of all source locations present in both traces. Source locations are
+// matched by name, file and line. Each matched pair is processed by a job on a task pool. A job
+// takes the data lock of a worker only while copying zone times, in batches, and selects the
+// percentiles outside of the lock.
+class ZoneCompare
+{
+    enum { BatchSize = 1024 * 1024 };
+
+public:
+    ZoneCompare() = default;
+    ~ZoneCompare();
+
+    // Compares the traces on the calling thread. Neither data lock may be held by the caller.
+    // The optional filter is called with zone names and selects the source locations to compare.
+    std::vector<ZoneCompareEntry> Run( Worker& w0, Worker& w1, const std::function<bool(const char*)>& filter = nullptr );
+
+    // Runs the comparison on a background thread. Update() returns true when new results have
+    // been made available.
+    void Start( Worker& w0, Worker& w1 );
+    bool Update();
+    void Cancel() { m_cancel.store( true, std::memory_order_relaxed ); }
+
+    bool IsRunning() const { return m_thread.joinable(); }
+    size_t GetProgress() const { return m_progress.load( std::memory_order_relaxed ); }
+    size_t GetTotal() const { return m_total.load( std::memory_order_relaxed ); }
+    std::vector<ZoneCompareEntry>& GetResult() { return m_result; }
+    void ClearResult() { m_result.clear(); }
+
+private:
+    std::vector<ZoneCompareEntry> m_result;
+    std::vector<ZoneCompareEntry> m_next;
+
+    std::thread m_thread;
+    std::atomic<bool> m_done { false };
+    std::atomic<bool> m_cancel { false };
+    std::atomic<size_t> m_progress { 0 };
+    std::atomic<size_t> m_total { 0 };
+};
+
+}
+
+#endif
@@ -0,0 +1,105 @@
+// Measures the cost of a call stack capture with the default unwinder of the platform and with the
+// frame pointer walk (see TRACY_FRAME_POINTER_UNWIND). Build with "make bench", which compiles the
+// benchmark with -fno-omit-frame-pointer.
+
+#include <algorithm>
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include "../client/TracyCallstack.hpp"
+#include "../common/TracyAlloc.hpp"
+
+#ifndef TRACY_HAS_FRAME_POINTER_CALLSTACK
+
+int main()
+{
+    fprintf( stderr, "Frame pointer call stacks are not available on this platform.\n" );
+    return 1;
+}
+
+#else
+
+enum { StackDepth = 64 };
+enum { Iterations = 100000 };
+enum { Runs = 5 };
+
+typedef void*(*CaptureFn)( int depth );
+
+static __attribute__((noinline)) void* CaptureDefault( int depth )
+{
+    return tracy::Callstack( depth );
+}
+
+static __attribute__((noinline)) void* CaptureFramePointer( int depth )
+{
+    return tracy::FramePointerCallstack( depth );
+}
+
+struct Result
+{
+    double ns[2];
+    uintptr_t frames[2];
+    bool match;
+};
+
+static __attribute__((noinline)) void Measure( int depth, Result& res )
+{
+    const CaptureFn fn[2] = { CaptureDefault, CaptureFramePointer };
+    uintptr_t* trace[2];
+    for( int i=0; i<2; i++ )
+    {
+        double best = 0;
+        for( int r=0; r<Runs; r++ )
+        {
+            const auto t0 = std::chrono::high_resolution_clock::now();
+            for( int j=0; j<Iterations; j++ )
+            {
+                tracy::tracy_free( fn[i]( depth ) );
+            }
+            const auto t1 = std::chrono::high_resolution_clock::now();
+            const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count() / double( Iterations );
+            if( r == 0 || ns < best ) best = ns;
+        }
+        res.ns[i] = best;
+        trace[i] = (uintptr_t*)fn[i]( depth );
+        res.frames[i] = *trace[i];
+    }
+
+    // The first frame is in the capture function itself, the rest must be the same.
+    res.match = trace[0][0] == trace[1][0];
+    for( uintptr_t i=2; res.match && i<=trace[0][0]; i++ )
+    {
+        if( trace[0][i] != trace[1][i] ) res.match = false;
+    }
+    tracy::tracy_free( trace[0] );
+    tracy::tracy_free( trace[1] );
+}
+
+static __attribute__((noinline)) int Recurse( int level, int depth, Result& res )
+{
+    if( level == 0 )
+    {
+        Measure( depth, res );
+        return 0;
+    }
+    const auto ret = Recurse( level - 1, depth, res );
+    asm volatile( "" ::: "memory" );
+    return ret + 1;
+}
+
+int main()
+{
+    const int depths[] = { 1, 2, 4, 8, 16, 32, 62 };
+
+    printf( "depth  default (ns)  frame pointer (ns)  speedup  frames\n" );
+    for( auto depth : depths )
+    {
+        Result res;
+        Recurse( StackDepth, depth, res );
+        printf( "%5i  %12.1f  %18.1f  %6.1fx  %zu/%zu%s\n", depth, res.ns[0], res.ns[1], res.ns[0] / res.ns[1],
+            size_t( res.frames[0] ), size_t( res.frames[1] ), res.match ? "" : " (mismatch)" );
+    }
+    return 0;
+}
+
+#endif
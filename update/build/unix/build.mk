@@ -9,4 +9,11 @@ IMAGE := $(PROJECT)-$(BUILD)
 FILTER :=
 include ../../../common/src-from-vcxproj.mk
 
+# The offline symbol resolution uses libbacktrace, which only reads ELF files here.
+ifeq ($(shell uname -s),Linux)
+	LIBBACKTRACE := ../../../public/libbacktrace
+	SRC += $(LIBBACKTRACE)/alloc.cpp $(LIBBACKTRACE)/dwarf.cpp $(LIBBACKTRACE)/elf.cpp $(LIBBACKTRACE)/fileline.cpp \
+		$(LIBBACKTRACE)/mmapio.cpp $(LIBBACKTRACE)/posix.cpp $(LIBBACKTRACE)/sort.cpp $(LIBBACKTRACE)/state.cpp
+endif
+
 include ../../../common/unix.mk
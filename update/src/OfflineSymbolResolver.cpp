@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#  include <cxxabi.h>
+#  include <elf.h>
+#  include "../../public/libbacktrace/backtrace.hpp"
+#endif
+
+#include "OfflineSymbolResolver.hpp"
+
+#ifdef __linux__
+
+// Same as the number of inlined frames reported by the client.
+enum { MaxFrames = 16 };
+
+template<typename Ehdr, typename Phdr, typename Nhdr>
+static bool ReadBuildId( FILE* f, std::string& buildId )
+{
+    Ehdr ehdr;
+    if( fseek( f, 0, SEEK_SET ) != 0 || fread( &ehdr, 1, sizeof( ehdr ), f ) != sizeof( ehdr ) ) return false;
+    for( int i=0; i<ehdr.e_phnum; i++ )
+    {
+        Phdr phdr;
+        if( fseek( f, ehdr.e_phoff + i * ehdr.e_phentsize, SEEK_SET ) != 0 || fread( &phdr, 1, sizeof( phdr ), f ) != sizeof( phdr ) ) return false;
+        if( phdr.p_type != PT_NOTE ) continue;
+
+        std::vector<char> notes( phdr.p_filesz );
+        if( fseek( f, phdr.p_offset, SEEK_SET ) != 0 || fread( notes.data(), 1, notes.size(), f ) != notes.size() ) return false;
+        const size_t align = phdr.p_align == 8 ? 8 : 4;
+        size_t pos = 0;
+        while( pos + sizeof( Nhdr ) <= notes.size() )
+        {
+            Nhdr nhdr;
+            memcpy( &nhdr, notes.data() + pos, sizeof( nhdr ) );
+            const auto name = pos + sizeof( Nhdr );
+            const auto desc = name + ( ( nhdr.n_namesz + align - 1 ) & ~( align - 1 ) );
+            const auto next = desc + ( ( nhdr.n_descsz + align - 1 ) & ~( align - 1 ) );
+            if( next > notes.size() ) break;
+            if( nhdr.n_type == NT_GNU_BUILD_ID && nhdr.n_namesz == 4 && memcmp( notes.data() + name, "GNU", 4 ) == 0 )
+            {
+                char buf[3];
+                for( size_t j=0; j<nhdr.n_descsz; j++ )
+                {
+                    sprintf( buf, "%02x", (uint8_t)notes[desc + j] );
+                    buildId += buf;
+                }
+                return true;
+            }
+            pos = next;
+        }
+    }
+    return true;
+}
+
+// Returns false if the file is not a readable ELF file. Images without a build id note have an empty id.
+static bool GetImageBuildId( const char* path, std::string& buildId )
+{
+    FILE* f = fopen( path, "rb" );
+    if( !f ) return false;
+    unsigned char ident[EI_NIDENT];
+    bool ok = fread( ident, 1, EI_NIDENT, f ) == EI_NIDENT && memcmp( ident, ELFMAG, SELFMAG ) == 0;
+    if( ok )
+    {
+        if( ident[EI_CLASS] == ELFCLASS64 ) ok = ReadBuildId<Elf64_Ehdr, Elf64_Phdr, Elf64_Nhdr>( f, buildId );
+        else ok = ReadBuildId<Elf32_Ehdr, Elf32_Phdr, Elf32_Nhdr>( f, buildId );
+    }
+    fclose( f );
+    return ok;
+}
+
+static void ImageErrorCallback( void* data, const char* msg, int /*errnum*/ )
+{
+    fprintf( stderr, "%s: %s\n", (const char*)data, msg );
+}
+
+static void IgnoreErrorCallback( void* /*data*/, const char* /*msg*/, int /*errnum*/ )
+{
+}
+
+static std::string Demangle( const char* name )
+{
+    if( name[0] == '_' )
+    {
+        int status;
+        auto demangled = abi::__cxa_demangle( name, nullptr, nullptr, &status );
+        if( demangled )
+        {
+            std::string ret = demangled;
+            free( demangled );
+            return ret;
+        }
+    }
+    return name;
+}
+
+static int FrameCallback( void* data, uintptr_t /*pc*/, uintptr_t lowaddr, const char* fn, int lineno, const char* function )
+{
+    auto& frames = *(std::vector<tracy::Worker::ResolvedFrame>*)data;
+    frames.emplace_back( tracy::Worker::ResolvedFrame { function ? Demangle( function ) : "[unknown]", fn ? fn : "[unknown]", uint32_t( lineno ), lowaddr, 0 } );
+    return frames.size() >= MaxFrames ? 1 : 0;
+}
+
+static void SymInfoCallback( void* data, uintptr_t /*pc*/, const char* /*symname*/, uintptr_t symval, uintptr_t symsize )
+{
+    auto& frames = *(std::vector<tracy::Worker::ResolvedFrame>*)data;
+    frames.back().symAddr = symval;
+    frames.back().symLen = uint32_t( symsize );
+}
+
+// Used when the image has no debug info. The symbol table still gives the function name.
+static void SymInfoFallbackCallback( void* data, uintptr_t /*pc*/, const char* symname, uintptr_t symval, uintptr_t symsize )
+{
+    if( !symname ) return;
+    auto& frames = *(std::vector<tracy::Worker::ResolvedFrame>*)data;
+    frames.emplace_back( tracy::Worker::ResolvedFrame { Demangle( symname ), "[unknown]", 0, symval, uint32_t( symsize ) } );
+}
+
+bool OfflineSymbolResolver::IsSupported()
+{
+    return true;
+}
+
+OfflineSymbolResolver::Image& OfflineSymbolResolver::GetImage( const char* image, const char* buildId )
+{
+    std::string key = image;
+    key += '@';
+    key += buildId;
+    auto it = m_images.find( key );
+    if( it != m_images.end() ) return it->second;
+
+    auto& ret = m_images.emplace( std::move( key ), Image { nullptr } ).first->second;
+    const auto path = GetLocalPath( image );
+    std::string localBuildId;
+    if( !GetImageBuildId( path.c_str(), localBuildId ) )
+    {
+        fprintf( stderr, "Cannot read image %s\n", path.c_str() );
+        return ret;
+    }
+    if( *buildId != '\0' && localBuildId != buildId )
+    {
+        fprintf( stderr, "Build id of image %s doesn't match (%s, expected %s)\n", path.c_str(), localBuildId.c_str(), buildId );
+        return ret;
+    }
+
+    // Messages of the library refer to the image for which the state was created.
+    auto name = strdup( path.c_str() );
+    auto state = tracy::backtrace_create_state( name, 0, ImageErrorCallback, name );
+    if( state && tracy::backtrace_initialize_file( state, name, ImageErrorCallback, name ) ) ret.state = state;
+    return ret;
+}
+
+const std::vector<tracy::Worker::ResolvedFrame>* OfflineSymbolResolver::Resolve( const char* image, const char* buildId, uint64_t offset )
+{
+    auto& img = GetImage( image, buildId );
+    if( !img.state ) return nullptr;
+
+    auto it = img.frames.find( offset );
+    if( it == img.frames.end() )
+    {
+        it = img.frames.emplace( offset, std::vector<tracy::Worker::ResolvedFrame>() ).first;
+        auto& frames = it->second;
+        tracy::backtrace_pcinfo( img.state, offset, FrameCallback, IgnoreErrorCallback, &frames );
+        if( !frames.empty() ) tracy::backtrace_syminfo( img.state, offset, SymInfoCallback, IgnoreErrorCallback, &frames );
+        else tracy::backtrace_syminfo( img.state, offset, SymInfoFallbackCallback, IgnoreErrorCallback, &frames );
+    }
+    return it->second.empty() ? nullptr : &it->second;
+}
+
+#else
+
+bool OfflineSymbolResolver::IsSupported()
+{
+    return false;
+}
+
+const std::vector<tracy::Worker::ResolvedFrame>* OfflineSymbolResolver::Resolve( const char* /*image*/, const char* /*buildId*/, uint64_t /*offset*/ )
+{
+    return nullptr;
+}
+
+#endif
+
+void OfflineSymbolResolver::AddPathSubstitution( const char* from, const char* to )
+{
+    m_substitutions.emplace_back( from, to );
+}
+
+std::string OfflineSymbolResolver::GetLocalPath( const char* image ) const
+{
+    for( auto& v : m_substitutions )
+    {
+        if( strncmp( image, v.first.c_str(), v.first.size() ) == 0 )
+        {
+            return v.second + ( image + v.first.size() );
+        }
+    }
+    return image;
+}
@@ -0,0 +1,44 @@
+#ifndef __OFFLINESYMBOLRESOLVER_HPP__
+#define __OFFLINESYMBOLRESOLVER_HPP__
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../../server/TracyWorker.hpp"
+
+namespace tracy
+{
+struct backtrace_state;
+}
+
+// Resolves callstack frames of clients built with TRACY_SYMBOL_OFFLINE_RESOLVE, using local copies of
+// the images which were loaded in the profiled program. An image is only used if its build id matches.
+// Each image is loaded once, and each address is resolved once.
+class OfflineSymbolResolver
+{
+public:
+    static bool IsSupported();
+
+    // Images with paths starting with from are looked up with the prefix replaced by to.
+    void AddPathSubstitution( const char* from, const char* to );
+
+    const std::vector<tracy::Worker::ResolvedFrame>* Resolve( const char* image, const char* buildId, uint64_t offset );
+
+private:
+    struct Image
+    {
+        tracy::backtrace_state* state;
+        std::unordered_map<uint64_t, std::vector<tracy::Worker::ResolvedFrame>> frames;
+    };
+
+    Image& GetImage( const char* image, const char* buildId );
+    std::string GetLocalPath( const char* image ) const;
+
+    std::vector<std::pair<std::string, std::string>> m_substitutions;
+    std::unordered_map<std::string, Image> m_images;
+};
+
+#endif
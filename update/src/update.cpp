@@ -6,6 +6,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "../../server/TracyFileRead.hpp"
 #include "../../server/TracyFileWrite.hpp"
@@ -15,6 +16,8 @@
 #include "../../zstd/zstd.h"
 #include "../../getopt/getopt.h"
 
+#include "OfflineSymbolResolver.hpp"
+
 #ifdef __APPLE__
 #  define ftello64(x) ftello(x)
 #elif defined _WIN32
@@ -27,11 +30,15 @@ void Usage()
     printf( "  -h: enable LZ4HC compression\n" );
     printf( "  -e: enable extreme LZ4HC compression (very slow)\n" );
     printf( "  -z level: use Zstd compression with given compression level\n" );
+    printf( "  -u: store uncompressed data, for fastest load times\n" );
     printf( "  -d: build dictionary for frame images\n" );
     printf( "  -s flags: strip selected data from capture:\n" );
     printf( "      l: locks, m: messages, p: plots, M: memory, i: frame images\n" );
     printf( "      c: context switches, s: sampling data, C: symbol code, S: source cache\n" );
     printf( "  -c: scan for source files missing in cache and add if found\n" );
+    printf( "  -j threads: number of threads used for compression (default: all cores)\n" );
+    printf( "  -r: resolve symbols of clients built with TRACY_SYMBOL_OFFLINE_RESOLVE\n" );
+    printf( "  -p from=to: look up images with path prefix 'from' in 'to' instead (may be repeated)\n" );
     exit( 1 );
 }
 
@@ -50,8 +57,11 @@ int main( int argc, char** argv )
     int zstdLevel = 1;
     bool buildDict = false;
     bool cacheSource = false;
+    bool resolveSymbols = false;
+    OfflineSymbolResolver resolver;
+    int threads = std::max<int>( std::thread::hardware_concurrency(), 1 );
     int c;
-    while( ( c = getopt( argc, argv, "hez:ds:c" ) ) != -1 )
+    while( ( c = getopt( argc, argv, "hez:uds:cj:rp:" ) ) != -1 )
     {
         switch( c )
         {
@@ -70,6 +80,9 @@ int main( int argc, char** argv )
                 exit( 1 );
             }
             break;
+        case 'u':
+            clev = tracy::FileWrite::Compression::None;
+            break;
         case 'd':
             buildDict = true;
             break;
@@ -118,12 +131,36 @@ int main( int argc, char** argv )
         case 'c':
             cacheSource = true;
             break;
+        case 'j':
+            threads = atoi( optarg );
+            if( threads < 1 )
+            {
+                printf( "Number of compression threads must be at least 1\n" );
+                exit( 1 );
+            }
+            break;
+        case 'r':
+            resolveSymbols = true;
+            break;
+        case 'p':
+        {
+            auto sep = strchr( optarg, '=' );
+            if( !sep ) Usage();
+            *sep = '\0';
+            resolver.AddPathSubstitution( optarg, sep+1 );
+            break;
+        }
         default:
             Usage();
             break;
         }
     }
     if( argc - optind != 2 ) Usage();
+    if( resolveSymbols && !OfflineSymbolResolver::IsSupported() )
+    {
+        fprintf( stderr, "Symbol resolution is not supported on this platform.\n" );
+        exit( 1 );
+    }
 
     const char* input = argv[optind];
     const char* output = argv[optind+1];
@@ -150,9 +187,18 @@ int main( int argc, char** argv )
             while( !worker.AreSourceLocationZonesReady() ) std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
 #endif
 
+            if( resolveSymbols && !worker.GetImages().empty() )
+            {
+                printf( "Resolving symbols...\r" );
+                fflush( stdout );
+                const auto cnt = worker.ResolveImageFrames( [&resolver]( const char* image, const char* buildId, uint64_t offset ) {
+                    return resolver.Resolve( image, buildId, offset );
+                } );
+                printf( "Resolved %zu callstack frames\n", cnt );
+            }
             if( cacheSource ) worker.CacheSourceFiles();
 
-            auto w = std::unique_ptr<tracy::FileWrite>( tracy::FileWrite::Open( output, clev, zstdLevel ) );
+            auto w = std::unique_ptr<tracy::FileWrite>( tracy::FileWrite::Open( output, clev, zstdLevel, threads ) );
             if( !w )
             {
                 fprintf( stderr, "Cannot open output file!\n" );
@@ -161,7 +207,11 @@ int main( int argc, char** argv )
             printf( "Saving... \r" );
             fflush( stdout );
             worker.Write( *w, buildDict );
-            w->Finish();
+            if( !w->Finish() )
+            {
+                fprintf( stderr, "Cannot compress output file!\n" );
+                exit( 1 );
+            }
             const auto t1 = std::chrono::high_resolution_clock::now();
             const auto stats = w->GetCompressionStatistics();
             ratio = 100.f * stats.second / stats.first;